@@ -0,0 +1,323 @@
+// Micro-benchmarks for AutoQuantum's own hot paths (make bench).
+// Each benchmark is calibrated to run for a fixed time per sample; the median of
+// several samples is reported as one JSON object per line, and compared against a
+// stored baseline when one is given.
+#include "utilities.h"
+#include "tcinterface.h"
+#include <chrono>
+#include <functional>
+#include <unistd.h>
+
+struct BenchResult
+{
+    std::string benchmark = "";
+    std::string label = "";
+    size_t iterations = 0;
+    double ns_per_op = 0.0;             // median over samples
+    double min_ns_per_op = 0.0;
+    double bytes_per_op = 0.0;
+};
+
+double BENCH_MIN_TIME = 0.2;            // seconds per sample
+size_t BENCH_SAMPLES = 5;
+std::string BENCH_FILTER = "";
+std::vector<BenchResult> RESULTS = {};
+
+double time_batch(const std::function<void()> &op, size_t n)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+    {
+        op();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void measure(std::string benchmark, std::string label, double bytes_per_op, const std::function<void()> &op)
+{
+    if (!BENCH_FILTER.empty() && (benchmark + " " + label).find(BENCH_FILTER) == std::string::npos)
+    {
+        return;
+    }
+    // Double the batch until one batch fills a sample; slow operations run once per sample.
+    size_t batch = 1;
+    double seconds = time_batch(op, batch);
+    while (seconds < BENCH_MIN_TIME && batch < ((size_t)1 << 30))
+    {
+        batch = (seconds > 0.0) ? std::max(batch * 2, (size_t)(batch * BENCH_MIN_TIME / seconds)) : batch * 2;
+        seconds = time_batch(op, batch);
+    }
+    std::vector<double> samples = {seconds * 1e9 / batch};
+    size_t n_samples = (seconds > 2.0) ? std::min<size_t>(3, BENCH_SAMPLES) : BENCH_SAMPLES;
+    while (samples.size() < n_samples)
+    {
+        samples.push_back(time_batch(op, batch) * 1e9 / batch);
+    }
+    std::sort(samples.begin(), samples.end());
+    BenchResult result;
+    result.benchmark = benchmark;
+    result.label = label;
+    result.iterations = batch * samples.size();
+    result.ns_per_op = samples[samples.size() / 2];
+    result.min_ns_per_op = samples.front();
+    result.bytes_per_op = bytes_per_op;
+    RESULTS.push_back(result);
+
+    std::stringstream line;
+    line << std::left << std::setw(28) << benchmark << std::setw(26) << label << std::right << std::fixed << std::setprecision(1) << std::setw(16) << result.ns_per_op << " ns/op";
+    if (bytes_per_op > 0.0)
+    {
+        line << std::setw(12) << bytes_per_op / result.ns_per_op * 1e3 << " MB/s";
+    }
+    normal_log(line.str());
+}
+
+std::string result_json(const BenchResult &result)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::setprecision(10) << "{\"benchmark\": \"" << json_escape(result.benchmark) << "\", \"case\": \"" << json_escape(result.label) << "\", \"iterations\": " << result.iterations
+           << ", \"ns_per_op\": " << result.ns_per_op << ", \"min_ns_per_op\": " << result.min_ns_per_op << ", \"bytes_per_op\": " << result.bytes_per_op << "}";
+    return buffer.str();
+}
+
+std::string json_field(const std::string &line, std::string key)
+{
+    // Enough JSON for the lines written above: "key": "text" or "key": number.
+    size_t pos = line.find("\"" + key + "\": ");
+    if (pos == std::string::npos)
+    {
+        return "";
+    }
+    pos += key.size() + 4;
+    if (line[pos] == '"')
+    {
+        return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+    }
+    return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+std::string human_size(double bytes)
+{
+    const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+    int u = 0;
+    while (bytes >= 1024.0 && u < 4)
+    {
+        bytes /= 1024.0;
+        u++;
+    }
+    std::stringstream buffer;
+    buffer << (size_t)bytes << " " << units[u];
+    return buffer.str();
+}
+
+size_t parse_size(std::string text)
+{
+    // 10G, 256M, 4096 ...
+    double value = atof(text.c_str());
+    switch (text.empty() ? ' ' : toupper(text.back()))
+    {
+        case 'K': return value * 1024.0;
+        case 'M': return value * 1024.0 * 1024.0;
+        case 'G': return value * 1024.0 * 1024.0 * 1024.0;
+        default: return value;
+    }
+}
+
+// Benchmarks
+void bench_strings()
+{
+    for (size_t n_fields : {10, 1000, 100000})
+    {
+        std::string text = "";
+        for (size_t i = 0; i < n_fields; i++)
+        {
+            text += "field" + std::to_string(i) + ",";
+        }
+        size_t count = 0;
+        measure("split_string", std::to_string(n_fields) + " fields", text.size(), [&]() { count += split_string(text, ",").size(); });
+        std::string line = "FINAL ENERGY: " + text + " a.u.";
+        measure("string_between", std::to_string(line.size()) + " chars", line.size(), [&]() { count += string_between(line, ":", "a").size(); });
+    }
+}
+
+void bench_command_line()
+{
+    std::vector<std::string> typical = {"autoquantum", "--opt", "--coordinates", "molecule.xyz", "--method", "wb97xd3", "--basis", "def2-svp", "--charge", "0",
+                                        "--spinmult", "1", "--gpus", "2", "--campaign", "structures/", "--pack", "4", "--array_throttle", "50"};
+    std::vector<std::string> large = {"autoquantum", "--spe"};
+    for (size_t i = 0; i < 1000; i++)
+    {
+        large.push_back("--keyword" + std::to_string(i));
+        large.push_back(std::to_string(i));
+    }
+    for (std::vector<std::string> *args : {&typical, &large})
+    {
+        std::vector<char*> argv = {};
+        for (std::string &arg : *args)
+        {
+            argv.push_back(&arg[0]);
+        }
+        size_t count = 0;
+        measure("parse_command_line", std::to_string(argv.size()) + " arguments", 0.0, [&]()
+        {
+            std::map<std::string,std::vector<std::string>> flags = {};
+            parse_command_line_arguments(flags, argv.size(), argv.data());
+            count += flags.size();
+        });
+    }
+}
+
+void bench_input_rendering(std::string scratch)
+{
+    CALC_TYPE = "OPT";
+    std::map<std::string,std::vector<std::string>> flags = {{"coordinates", {"molecule.xyz"}}, {"method", {"wb97xd3"}}, {"basis", {"def2-svp"}}, {"charge", {"0"}}, {"gpus", {"2"}}};
+    std::map<std::string,std::string> keywords = {};
+    size_t count = 0;
+    measure("generate_full_keyword_set", "opt", 0.0, [&]()
+    {
+        std::map<std::string,std::vector<std::string>> copy = flags;
+        std::map<std::string,std::string> result = {};
+        generate_full_keyword_set(copy, result);
+        count += result.size();
+    });
+    generate_full_keyword_set(flags, keywords);
+    std::string input = scratch + "/tc_opt.in";
+    measure("Write_TC_Input_File", "opt", 0.0, [&]() { count += Write_TC_Input_File(keywords, input); });
+}
+
+void bench_output_files(std::string scratch, size_t max_bytes)
+{
+    // Synthetic TeraChem-like output, read warm from the page cache.
+    std::string block = "";
+    while (block.size() < (1 << 20))
+    {
+        block += "     12    -76.0123456789012     -0.0000123456      0.0004567890       4.56 \n";
+    }
+    for (size_t size : {(size_t)1 << 20, (size_t)16 << 20, (size_t)256 << 20, (size_t)1 << 30, (size_t)10 << 30})
+    {
+        if (size > max_bytes)
+        {
+            continue;
+        }
+        std::string file = scratch + "/output." + std::to_string(size);
+        std::ofstream fout(file, std::ios::binary);
+        for (size_t written = 0; written < size; written += block.size())
+        {
+            fout.write(block.data(), std::min(block.size(), size - written));
+        }
+        fout << "| Job finished: now |" << std::endl;
+        fout.close();
+        size_t count = 0;
+        measure("LastLineOfFile", human_size(size), 0.0, [&]() { count += LastLineOfFile(file).size(); });
+        measure("count_lines_in_file", human_size(size), size, [&]() { count += count_lines_in_file(file); });
+        fs::remove(file);
+    }
+}
+
+void bench_directory_names(std::string scratch)
+{
+    // Each operation claims a directory and gives it back, so the number of existing directories stays fixed.
+    fs::path previous = fs::current_path();
+    for (size_t n_existing : {100, 1000, 10000})
+    {
+        std::string dir = scratch + "/dirs." + std::to_string(n_existing);
+        fs::create_directories(dir);
+        fs::current_path(dir);
+        for (size_t i = 1; i <= n_existing; i++)
+        {
+            std::stringstream name;
+            name << "AutoQuantum." << std::setw(4) << std::setfill('0') << i;
+            fs::create_directory(name.str());
+        }
+        measure("MakeIterativeDirectoryName", std::to_string(n_existing) + " dirs, counter", 0.0, [&]()
+        {
+            rmdir(MakeIterativeDirectoryName("AutoQuantum", 4).c_str());
+        });
+        measure("MakeIterativeDirectoryName", std::to_string(n_existing) + " dirs, no counter", 0.0, [&]()
+        {
+            unlink(".AutoQuantum.next");
+            rmdir(MakeIterativeDirectoryName("AutoQuantum", 4).c_str());
+        });
+        fs::current_path(previous);
+        fs::remove_all(dir);
+    }
+}
+
+int compare_with_baseline(std::string baseline, double tolerance)
+{
+    // Returns the number of benchmarks slower than the baseline by more than the tolerance.
+    std::ifstream fin(baseline);
+    if (!fin.is_open())
+    {
+        normal_log("No baseline at " + baseline + "; run 'make bench-baseline' to record one.");
+        return 0;
+    }
+    std::map<std::string,double> reference = {};
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (!json_field(line, "benchmark").empty())
+        {
+            reference[json_field(line, "benchmark") + " | " + json_field(line, "case")] = atof(json_field(line, "ns_per_op").c_str());
+        }
+    }
+    int n_regressions = 0;
+    normal_log("Compared with " + baseline + " (tolerance " + std::to_string((int)(tolerance * 100)) + "%):");
+    for (const BenchResult &result : RESULTS)
+    {
+        std::string key = result.benchmark + " | " + result.label;
+        if (reference.count(key) == 0 || reference[key] <= 0.0)
+        {
+            continue;
+        }
+        double ratio = result.ns_per_op / reference[key];
+        bool regressed = ratio > 1.0 + tolerance;
+        n_regressions += regressed;
+        std::stringstream buffer;
+        buffer << std::left << std::setw(56) << key << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ratio << "x" << (regressed ? "  REGRESSION" : "");
+        normal_log(buffer.str());
+    }
+    return n_regressions;
+}
+
+int main(int argc, char** argv)
+{
+    std::map<std::string,std::vector<std::string>> flags = {};
+    parse_command_line_arguments(flags, argc, argv);
+    std::string output = (flags.count("output") > 0 && !flags["output"].empty()) ? flags["output"][0] : "bench/results.jsonl";
+    std::string baseline = (flags.count("baseline") > 0 && !flags["baseline"].empty()) ? flags["baseline"][0] : "";
+    double tolerance = (flags.count("tolerance") > 0 && !flags["tolerance"].empty()) ? std::stod(flags["tolerance"][0]) : 0.25;
+    size_t max_bytes = (flags.count("max_size") > 0 && !flags["max_size"].empty()) ? parse_size(flags["max_size"][0]) : ((size_t)256 << 20);
+    if (flags.count("min_time") > 0 && !flags["min_time"].empty())
+    {
+        BENCH_MIN_TIME = std::stod(flags["min_time"][0]);
+    }
+    if (flags.count("filter") > 0 && !flags["filter"].empty())
+    {
+        BENCH_FILTER = flags["filter"][0];
+    }
+
+    std::string scratch = (fs::temp_directory_path() / ("autoquantum_bench." + std::to_string(getpid()))).string();
+    fs::create_directories(scratch);
+    bench_strings();
+    bench_command_line();
+    bench_input_rendering(scratch);
+    bench_output_files(scratch, max_bytes);
+    bench_directory_names(scratch);
+    fs::remove_all(scratch);
+
+    std::stringstream buffer;
+    buffer.str("");
+    for (const BenchResult &result : RESULTS)
+    {
+        buffer << result_json(result) << std::endl;
+    }
+    write_to_file(output, buffer.str());
+    normal_log("Results written to " + output);
+    if (!baseline.empty() && compare_with_baseline(baseline, tolerance) > 0)
+    {
+        return 1;
+    }
+    return 0;
+}
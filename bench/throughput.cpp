@@ -0,0 +1,298 @@
+// End-to-end throughput harness (make throughput).
+// Runs the real autoquantum binary against the simulated cluster in bench/sim:
+// every job is generated and submitted by its own 'autoquantum --spe' process,
+// watched with the same squeue/sacct queries as --watch, and parsed with
+// ParseTCOutput once it has finished. Reports jobs per second and latency
+// percentiles for each stage.
+#include "utilities.h"
+#include "tcoutput.h"
+#include "monitor.h"
+#include "process.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+struct SimulatedJob
+{
+    std::string work_dir = "";          // where autoquantum was started
+    std::string job_dir = "";           // the AutoQuantum.NNNN it made
+    TrackedJob tracked;
+    bool submitted = false;
+    bool finished = false;
+    bool succeeded = false;
+    double started = 0.0;               // epoch seconds: autoquantum started,
+    double sbatch_called = 0.0;         // sbatch called,
+    double returned = 0.0;              // autoquantum returned,
+    double run_start = 0.0;             // job started and ended on the cluster,
+    double run_end = 0.0;
+    double seen = 0.0;                  // and terminal state noticed
+    double parse_seconds = 0.0;
+};
+
+double epoch_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string flag_value(std::map<std::string,std::vector<std::string>> &flags, std::string key, std::string fallback)
+{
+    return (flags.count(key) > 0 && !flags[key].empty()) ? flags[key][0] : fallback;
+}
+
+bool read_job_record(std::string sim_dir, std::string job_id, SimulatedJob &job)
+{
+    // "STATE submit_time start_time end_time directory", written by bench/sim/sbatch and aqsim-job.
+    std::ifstream fin(sim_dir + "/jobs/" + job_id);
+    std::string state, submitted, started, ended;
+    if (!(fin >> state >> submitted >> started >> ended))
+    {
+        return false;
+    }
+    job.sbatch_called = atof(submitted.c_str());
+    job.run_start = atof(started.c_str());
+    job.run_end = atof(ended.c_str());
+    return true;
+}
+
+std::string find_tc_output(std::string job_dir)
+{
+    for (auto &entry : fs::directory_iterator(job_dir))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("tc_", 0) == 0 && name.size() > 7 && name.substr(name.size() - 4) == ".out")
+        {
+            return entry.path().string();
+        }
+    }
+    return "";
+}
+
+struct StageStatistics
+{
+    std::string stage = "";
+    std::vector<double> samples = {};
+};
+
+double percentile(std::vector<double> sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    return sorted[(size_t)std::lround(p * (sorted.size() - 1))];
+}
+
+std::string stage_json(StageStatistics &stats)
+{
+    std::sort(stats.samples.begin(), stats.samples.end());
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::setprecision(6) << "{\"stage\": \"" << stats.stage << "\", \"count\": " << stats.samples.size() << ", \"p50\": " << percentile(stats.samples, 0.5)
+           << ", \"p90\": " << percentile(stats.samples, 0.9) << ", \"p99\": " << percentile(stats.samples, 0.99) << ", \"max\": " << percentile(stats.samples, 1.0) << "}";
+    return buffer.str();
+}
+
+int main(int argc, char** argv)
+{
+    std::map<std::string,std::vector<std::string>> flags = {};
+    parse_command_line_arguments(flags, argc, argv);
+    size_t n_jobs = std::stoul(flag_value(flags, "jobs", "10000"));
+    unsigned int clients = std::stoul(flag_value(flags, "clients", std::to_string(default_thread_count())));
+    double poll_interval = std::stod(flag_value(flags, "poll_interval", "1"));
+    std::string autoquantum = fs::absolute(flag_value(flags, "autoquantum", "bin/autoquantum")).string();
+    std::string sim_bin = fs::absolute(flag_value(flags, "sim_bin", "bench/sim")).string();
+    std::string output = flag_value(flags, "output", "bench/throughput.json");
+    std::string work = fs::absolute(flag_value(flags, "work_dir", (fs::temp_directory_path() / ("autoquantum_throughput." + std::to_string(getpid()))).string())).string();
+    if (!fs::exists(autoquantum) || !fs::exists(sim_bin + "/sbatch"))
+    {
+        error_log("Need the autoquantum binary (--autoquantum) and the simulated cluster in bench/sim (--sim_bin).", 1);
+    }
+
+    // The children see the stubs first in PATH, and keep their caches and job registry in the work directory.
+    std::string sim_dir = work + "/sim";
+    fs::create_directories(sim_dir);
+    fs::create_directories(work + "/cache");
+    setenv("PATH", (sim_bin + ":" + (getenv("PATH") != nullptr ? getenv("PATH") : "/usr/bin:/bin")).c_str(), 1);
+    setenv("AQSIM_DIR", sim_dir.c_str(), 1);
+    setenv("XDG_CACHE_HOME", (work + "/cache").c_str(), 1);
+    setenv("AUTOQUANTUM_SCHEDULER", "slurm", 1);
+    unsetenv("AUTOQUANTUM_TERACHEM");
+    unsetenv("MODULEPATH");
+    for (std::string setting : {"submit_latency", "queue_latency", "query_latency", "run_time", "output_kb", "failure_rate", "slots"})
+    {
+        if (flags.count(setting) > 0 && !flags[setting].empty())
+        {
+            std::string variable = "AQSIM_" + setting;
+            std::transform(variable.begin(), variable.end(), variable.begin(), ::toupper);
+            setenv(variable.c_str(), flags[setting][0].c_str(), 1);
+        }
+    }
+
+    std::string molecule = "3\nwater\nO 0.000000 0.000000 0.117300\nH 0.000000 0.757200 -0.469200\nH 0.000000 -0.757200 -0.469200\n";
+    std::vector<SimulatedJob> jobs(n_jobs);
+    for (size_t i = 0; i < n_jobs; i++)
+    {
+        std::stringstream name;
+        name << work << "/jobs/j" << std::setw(6) << std::setfill('0') << i;
+        jobs[i].work_dir = name.str();
+        fs::create_directories(jobs[i].work_dir);
+        write_to_file(jobs[i].work_dir + "/molecule.xyz", molecule);
+    }
+    normal_log("Pushing " + std::to_string(n_jobs) + " jobs through " + autoquantum + " with " + std::to_string(clients) + " concurrent clients; work directory " + work);
+
+    // Monitoring runs alongside submission, the way --watch would, and parses each job as it finishes.
+    std::mutex lock;
+    std::vector<size_t> active = {};
+    std::vector<double> poll_seconds = {};
+    bool submitting = true;
+    size_t n_finished = 0;
+    double begin = epoch_seconds();
+    std::thread monitor([&]()
+    {
+        while (true)
+        {
+            std::vector<size_t> batch;
+            bool done_submitting;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                batch = active;
+                done_submitting = !submitting;
+            }
+            if (batch.empty() && done_submitting)
+            {
+                break;
+            }
+            std::vector<TrackedJob> query = {};
+            for (size_t i : batch)
+            {
+                query.push_back(jobs[i].tracked);
+            }
+            double poll_begin = epoch_seconds();
+            QuerySlurmStates(query);
+            double now = epoch_seconds();
+            std::vector<size_t> remaining = {};
+            for (size_t k = 0; k < batch.size(); k++)
+            {
+                SimulatedJob &job = jobs[batch[k]];
+                job.tracked.state = query[k].state;
+                if (!IsTerminalState(job.tracked.state))
+                {
+                    remaining.push_back(batch[k]);
+                    continue;
+                }
+                job.seen = now;
+                read_job_record(sim_dir, job.tracked.job_id, job);
+                auto parse_begin = std::chrono::steady_clock::now();
+                std::string tc_output = find_tc_output(job.job_dir);
+                TCOutputResults results = tc_output.empty() ? TCOutputResults() : ParseTCOutput(tc_output);
+                job.parse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parse_begin).count();
+                job.finished = true;
+                job.succeeded = (job.tracked.state == "COMPLETED" && results.finished && results.errors.empty() && !results.gradient.empty());
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                poll_seconds.push_back(epoch_seconds() - poll_begin);
+                n_finished += batch.size() - remaining.size();
+                std::vector<size_t> added(active.begin() + batch.size(), active.end());
+                active = remaining;
+                active.insert(active.end(), added.begin(), added.end());
+            }
+            double wait = poll_interval - (epoch_seconds() - poll_begin);
+            if (wait > 0.0)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            }
+        }
+    });
+
+    // Generation and submission: one autoquantum process per job, several at a time.
+    parallel_for(n_jobs, clients, [&](size_t i)
+    {
+        SimulatedJob &job = jobs[i];
+        ProcessOptions options;
+        options.working_dir = job.work_dir;
+        options.capture = true;
+        options.merge_stderr = true;
+        job.started = epoch_seconds();
+        Process process = RunProcess({autoquantum, "--spe", "--coordinates", "molecule.xyz", "--no_cache"}, options);
+        job.returned = epoch_seconds();
+        job.job_dir = job.work_dir + "/AutoQuantum.0001";
+        std::vector<TrackedJob> tracked = fs::exists(job.job_dir + "/" + JOB_ID_FILE) ? ReadTrackedJobs({job.job_dir}) : std::vector<TrackedJob>();
+        if (process.exit_code != 0 || tracked.empty())
+        {
+            normal_log("Job " + std::to_string(i) + " was not submitted: " + process.output.substr(process.output.size() > 400 ? process.output.size() - 400 : 0));
+            std::lock_guard<std::mutex> guard(lock);
+            n_finished++;
+            return;
+        }
+        job.tracked = tracked[0];
+        job.submitted = true;
+        read_job_record(sim_dir, job.tracked.job_id, job);
+        std::lock_guard<std::mutex> guard(lock);
+        active.push_back(i);
+    });
+    double submitted_at = epoch_seconds();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        submitting = false;
+    }
+    monitor.join();
+    double end = epoch_seconds();
+
+    // Per-stage latencies, in seconds.
+    std::vector<StageStatistics> stages = {{"generation", {}}, {"submission", {}}, {"queue_wait", {}}, {"run", {}}, {"detection", {}}, {"parse", {}}, {"end_to_end", {}}, {"poll_cycle", poll_seconds}};
+    size_t n_submitted = 0, n_succeeded = 0;
+    for (SimulatedJob &job : jobs)
+    {
+        if (!job.submitted)
+        {
+            continue;
+        }
+        n_submitted++;
+        n_succeeded += job.succeeded;
+        stages[0].samples.push_back(job.sbatch_called - job.started);
+        stages[1].samples.push_back(job.returned - job.sbatch_called);
+        if (job.finished && job.run_end > 0.0)
+        {
+            stages[2].samples.push_back(job.run_start - job.sbatch_called);
+            stages[3].samples.push_back(job.run_end - job.run_start);
+            stages[4].samples.push_back(job.seen - job.run_end);
+            stages[5].samples.push_back(job.parse_seconds);
+            stages[6].samples.push_back(job.seen + job.parse_seconds - job.started);
+        }
+    }
+
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::setprecision(6) << "{\"jobs\": " << n_jobs << ", \"clients\": " << clients << ", \"submitted\": " << n_submitted << ", \"succeeded\": " << n_succeeded
+           << ", \"failed\": " << n_jobs - n_succeeded << ", \"wall_seconds\": " << end - begin << ", \"submissions_per_second\": " << n_submitted / (submitted_at - begin)
+           << ", \"jobs_per_second\": " << n_jobs / (end - begin) << ", \"stages\": [";
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        buffer << (s > 0 ? ", " : "") << stage_json(stages[s]);
+    }
+    buffer << "]}" << std::endl;
+    write_to_file(output, buffer.str());
+
+    std::stringstream table;
+    table.str("");
+    table << std::fixed << std::setprecision(1) << n_jobs << " jobs in " << end - begin << " s: " << n_jobs / (end - begin) << " jobs/s end to end, "
+          << n_submitted / (submitted_at - begin) << " submissions/s; " << n_succeeded << " succeeded, " << n_jobs - n_succeeded << " failed." << std::endl;
+    table << std::left << std::setw(14) << "stage (ms)" << std::right << std::setw(12) << "p50" << std::setw(12) << "p90" << std::setw(12) << "p99" << std::setw(12) << "max" << std::endl;
+    for (StageStatistics &stats : stages)
+    {
+        table << std::left << std::setw(14) << stats.stage << std::right << std::setprecision(2);
+        for (double p : {0.5, 0.9, 0.99, 1.0})
+        {
+            table << std::setw(12) << percentile(stats.samples, p) * 1e3;
+        }
+        table << std::endl;
+    }
+    normal_log(table.str() + "Results written to " + output);
+    if (flags.count("keep") == 0)
+    {
+        fs::remove_all(work);
+    }
+    return 0;
+}
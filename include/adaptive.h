@@ -0,0 +1,44 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "modules.h"
+#include "staging.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "resources.h"
+
+// Adaptive Restraints optimization (--opt --adaptive <core_indices>).
+// Atoms far from the core region start frozen; after each restrained cycle,
+// frozen atoms with large gradients or next to atoms that moved are released,
+// until a final unrestrained cycle converges.
+struct AdaptiveState
+{
+    int cycle = 1;
+    int max_cycles = 20;
+    double radius = 8.0;            // Angstrom; atoms beyond this from the core start frozen
+    double gradient = 4.5e-3;       // Hartree/Bohr; frozen atoms above this are released
+    double displacement = 0.1;      // Angstrom; free atoms moving more than this release their neighbors
+    double shell = 3.0;             // Angstrom; neighbor distance used when releasing
+    bool done = false;
+    std::vector<int> core = {};     // 0-based atom indices
+    std::vector<int> frozen = {};   // 0-based atom indices
+    std::map<std::string,std::string> keywords = {};
+};
+
+#define ADAPTIVE_STATE_FILE "AutoQuantum_Adaptive.state"
+
+extern bool ADAPTIVE;
+extern std::string ADAPTIVE_RESUME_DIR;
+void check_adaptive_mode(std::map<std::string,std::vector<std::string>> &flags);
+
+std::string format_index_ranges(std::vector<int> indices);
+bool ReadAdaptiveState(AdaptiveState &state, std::string filename);
+void WriteAdaptiveState(const AdaptiveState &state, std::string filename);
+void SetAdaptiveCycleFiles(int cycle);
+bool Write_Adaptive_Cycle_Input(AdaptiveState &state);
+void RunAdaptiveRestraints(std::map<std::string,std::vector<std::string>> &flags);
+void RunAdaptiveCycles();
+
+#endif
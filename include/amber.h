@@ -0,0 +1,52 @@
+#ifndef AMBER_H
+#define AMBER_H
+
+#include "utilities.h"
+#include "trajectory.h"
+
+// Amber topology (parm7/prmtop) and coordinates (rst7/inpcrd), read through a memory map.
+// Only the sections needed to pick a QM region are decoded: atom and residue names,
+// residue boundaries, atomic numbers, charges and bonds.
+struct AmberTopology
+{
+    size_t n_atoms = 0;
+    size_t n_residues = 0;
+    std::vector<std::string> atom_names = {};
+    std::vector<std::string> residue_labels = {};
+    std::vector<size_t> residue_first = {};     // first atom of each residue, plus n_atoms at the end
+    std::vector<int> atomic_numbers = {};       // guessed from atom names when the prmtop has none
+    std::vector<double> charges = {};           // elementary charges
+    std::vector<size_t> bond_first = {};        // bonded neighbors of atom a are bond_atoms[bond_first[a] .. bond_first[a+1])
+    std::vector<int> bond_atoms = {};
+};
+
+// Uniform grid over the bounding box; atoms of cell c are atoms[cell_first[c] .. cell_first[c+1]).
+struct CellList
+{
+    double origin[3] = {0.0, 0.0, 0.0};
+    double cell_size = 1.0;
+    size_t dims[3] = {1, 1, 1};
+    std::vector<size_t> cell_first = {};
+    std::vector<int> atoms = {};
+};
+
+bool ReadAmberTopology(AmberTopology &topology, std::string filename);
+bool ReadAmberCoordinates(XYZFrames &coordinates, std::string filename, size_t n_atoms);
+CellList BuildCellList(const XYZFrames &coordinates, double cell_size);
+std::vector<bool> AtomsWithinCutoff(const CellList &cells, const XYZFrames &coordinates, const std::vector<bool> &selected, double cutoff);
+std::vector<bool> SelectAmberAtoms(const AmberTopology &topology, std::string selection);
+void ExtendToBondBoundaries(const AmberTopology &topology, std::vector<bool> &qm);
+
+// QM region selection (--qm_region <selection> [--qm_cutoff A] [--mm_cutoff A]).
+// Selections are residue names, 1-based residue numbers or ranges, and @-prefixed
+// 1-based atom numbers, e.g. "LIG", "45-47,LIG" or "@1-20". Whole residues within
+// qm_cutoff of the selection join it, and the region then grows until every bond
+// it cuts is a C-C bond. Atoms beyond mm_cutoff of the QM region are frozen.
+extern std::string QM_REGION;
+extern double QM_CUTOFF;
+extern double MM_CUTOFF;
+extern std::vector<int> MM_FROZEN_ATOMS;        // 0-based, for the $constraint_freeze block
+void check_qm_region_flags(std::map<std::string,std::vector<std::string>> &flags);
+void SelectQMRegion(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "utilities.h"
+#include <cstdint>
+
+// In-process, chunk-parallel .tar.gz archiver.
+// The tar stream is cut into fixed-size chunks that are each compressed as an
+// independent gzip member on the thread pool, so the result is an ordinary
+// multi-member .tar.gz that gunzip and tar read as usual. A '<archive>.idx'
+// sidecar records where every chunk and every member file sits, so a single
+// file can be extracted by inflating only the chunks that cover it.
+struct ArchiveChunk
+{
+    uint64_t offset = 0;            // offset in the uncompressed tar stream
+    uint64_t length = 0;            // uncompressed length
+    uint64_t compressed_offset = 0; // offset in the .tar.gz
+    uint64_t compressed_size = 0;
+    uint32_t crc = 0;               // crc32 of the uncompressed chunk
+};
+
+struct ArchiveEntry
+{
+    std::string name = "";          // name stored in the archive
+    std::string path = "";          // path on disk
+    char type = '0';                // '0' regular file, '2' symlink, '5' directory
+    uint64_t size = 0;
+    uint64_t header_offset = 0;
+    uint64_t data_offset = 0;
+    uint64_t end_offset = 0;        // end of data including padding
+    std::string header = "";        // tar header block(s)
+};
+
+struct ArchiveIndex
+{
+    uint64_t chunk_size = 0;
+    uint64_t total_size = 0;        // uncompressed tar size
+    std::vector<ArchiveChunk> chunks = {};
+    std::vector<ArchiveEntry> entries = {};
+    std::vector<std::string> skipped = {};  // paths that could not be archived
+};
+
+#define ARCHIVE_CHUNK_SIZE (4 << 20)
+#define ARCHIVE_COMPRESSION_LEVEL 6
+
+// Archive Modes (--archive <directory>, --extract <archive> <member> [output])
+extern std::string ARCHIVE_TARGET;
+extern std::vector<std::string> EXTRACT_REQUEST;
+void check_archive_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunArchiveMode();
+
+bool ArchiveDirectory(std::string directory, std::string archive, unsigned int n_threads);    // false if any entry was skipped
+bool VerifyArchive(std::string archive, unsigned int n_threads);
+bool ReadArchiveIndex(ArchiveIndex &index, std::string filename);
+bool ExtractArchivedFile(std::string archive, std::string member, std::string output);
+
+#endif
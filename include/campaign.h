@@ -0,0 +1,28 @@
+#ifndef CAMPAIGN_H
+#define CAMPAIGN_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "modules.h"
+#include "staging.h"
+#include "resultcache.h"
+#include "resources.h"
+#include "executor.h"
+#include "localqueue.h"
+
+// Campaign mode settings, pulled out of the command line flags by check_campaign_mode().
+extern bool CAMPAIGN;
+extern std::string CAMPAIGN_SOURCE;       // manifest file (one .xyz per line) or directory of .xyz files
+extern unsigned int CAMPAIGN_THREADS;     // threads used to build job directories
+extern unsigned int CAMPAIGN_THROTTLE;    // %N concurrency limit on the job array, 0 for none
+extern unsigned int CAMPAIGN_PACK;        // jobs packed into one GPU-slice allocation, 0 for one job per array task
+
+void check_campaign_mode(std::map<std::string,std::vector<std::string>> &flags);
+std::vector<std::string> read_campaign_structures(std::string source);
+std::vector<std::string> Build_Campaign_Directories(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords, std::vector<std::string> structures, std::string campaign_dir);
+// after_stage_out: shell lines each task runs in its job directory once its outputs are back.
+void SubmitSlurmArrayJob(std::map<std::string,std::string> &keywords, std::string campaign_dir, size_t n_jobs, std::string after_stage_out = "");
+void SubmitSlurmPackedJob(std::string campaign_dir, size_t n_jobs, std::string after_stage_out = "");
+void RunCampaign(std::map<std::string,std::vector<std::string>> &flags);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef CHAIN_H
+#define CHAIN_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "modules.h"
+#include "staging.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "resources.h"
+
+// Chained runs (--chain opt freq spe): several calculation types run in sequence
+// in one job directory and one allocation, each step starting from the previous
+// step's final geometry and converged orbitals.
+struct ChainStep
+{
+    std::string calc_type = "";
+    std::string input = "";
+    std::string output = "";
+    std::string error = "";
+    std::string scrdir = "";
+};
+
+#define CHAIN_STEPS_FILE "AutoQuantum_Chain.steps"
+
+extern std::vector<std::string> CHAIN;
+extern std::string CHAIN_RESUME_DIR;
+void check_chain_mode(std::map<std::string,std::vector<std::string>> &flags);
+
+std::string carry_forward_geometry(const ChainStep &previous);
+std::string carry_forward_guess(std::string scrdir);
+bool ReadChainSteps(std::vector<ChainStep> &steps, std::string filename);
+void RunChain(std::map<std::string,std::vector<std::string>> &flags);
+void RunChainSteps();
+
+#endif
@@ -11,8 +11,39 @@
 #define DEFAULT_SLURM_GPU_JOB_PARTITION "earwp"
 #define DEFAULT_SLURM_GPU_JOB_INCLUDE_NODES = "arw4,arw5"
 #define DEFAULT_SLURM_GPU_JOB_EXCLUDE_NODES = "arw1,arw2,arw3"
-#define DEFAULT_SLURM_GPU_JOB_GPUNAME = "gpu:nvidia_a30_1g.12gb:2"
+#define DEFAULT_SLURM_GPU_JOB_GPUNAME "gpu:nvidia_a30_1g.12gb:2"
 #define DEFAULT_SLURM_GPU_JOB_MAX_MEMORY = "20GB"
+#define DEFAULT_SLURM_MAX_ARRAY_SIZE 1000
+#define DEFAULT_SLURM_SIGNAL_LEAD_SECONDS 300
+
+// Resource Autotuning Settings
+#define DEFAULT_SLURM_MAX_WALLTIME_MINUTES 7200
+#define DEFAULT_SLURM_MIN_WALLTIME_MINUTES 30
+#define DEFAULT_SLURM_MAX_GPUS 4
+#define DEFAULT_SLURM_MAX_MEMORY_GB 120
+#define DEFAULT_SLURM_MIN_MEMORY_GB 20
+#define DEFAULT_WALLTIME_SAFETY_FACTOR 2.0
+#define DEFAULT_PRIOR_ENERGY_SECONDS 40.0
+#define DEFAULT_PRIOR_SCALING_EXPONENT 2.5
+
+// Node Scratch Staging Settings
+#define DEFAULT_STAGE_COPY_THREADS 3
+#define DEFAULT_STAGE_MIRROR_SECONDS 30
+
+// Automatic Restart Settings
+#define DEFAULT_MAX_RESTARTS 3
+
+// Finite-Difference Hessian Settings
+#define DEFAULT_FD_STEP_BOHR 0.005
+
+// Nudged Elastic Band Settings
+#define DEFAULT_NEB_SPRING 0.01
+#define DEFAULT_NEB_FORCE_TOL 1e-3
+#define DEFAULT_NEB_MAX_ITERATIONS 300
+
+// Logging Settings
+#define DEFAULT_LOG_ROTATE_MB 64
+#define DEFAULT_LOG_KEEP_FILES 3
 
 // SLURM CPU Job Settings
 #define DEFAULT_SLURM_CPU_JOB_QUEUE "primary"
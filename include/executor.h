@@ -0,0 +1,58 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "tcoutput.h"
+#include "process.h"
+
+// Work queue that runs TeraChem inputs side by side, one process per slot.
+// A slot is a GPU or MIG instance named the way CUDA_VISIBLE_DEVICES names it,
+// optionally with a set of CPUs; each process only sees its own slot, and a
+// freed slot takes the next task.
+struct ExecutorSlot
+{
+    std::string device = "";            // CUDA_VISIBLE_DEVICES value, empty to leave it alone
+    std::vector<int> cpus = {};         // CPU affinity, empty for no restriction
+};
+
+struct ExecutorTask
+{
+    std::string job_dir = "";
+    std::string input = "";
+    std::string output = "";
+    std::string error = "";
+};
+
+struct ExecutorResult
+{
+    std::string job_dir = "";
+    std::string slot = "";
+    int exit_code = -1;
+    bool finished = false;
+    bool has_energy = false;
+    double final_energy = 0.0;
+    double seconds = -1.0;              // wall time of the process
+    size_t n_errors = 0;
+};
+
+std::vector<std::string> VisibleGPUDevices();
+bool ExecutorTaskFromJobDir(ExecutorTask &task, std::string job_dir);
+std::string ExecutorResultLine(const ExecutorResult &result);
+std::string ExecutorSlotName(const ExecutorSlot &slot);
+std::vector<ExecutorSlot> ExecutorSlots(std::vector<std::string> devices, std::vector<std::vector<int>> cpu_sets, unsigned int n_workers);
+
+// next_task hands out tasks until it returns false; it is asked again whenever a slot frees up.
+typedef std::function<bool(ExecutorTask&)> ExecutorTaskSource;
+typedef std::function<void(const ExecutorTask&, const ExecutorResult&)> ExecutorResultSink;
+void RunTaskQueue(ExecutorTaskSource next_task, std::vector<ExecutorSlot> slots, ExecutorResultSink finished);
+std::vector<ExecutorResult> RunTaskQueue(const std::vector<ExecutorTask> &tasks, std::vector<ExecutorSlot> slots, std::string report_file);
+
+// Pack Worker Mode (--pack_worker <campaign_dir> <first> <count>), run inside a packed allocation.
+extern std::string PACK_WORKER_DIR;
+extern size_t PACK_WORKER_FIRST;       // 1-based line of the campaign job list
+extern size_t PACK_WORKER_COUNT;
+void check_pack_worker_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunPackWorkerMode();
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "executor.h"
+#include <cstdint>
+
+// Columnar results file (.aqcol) handed to AutoAnalytics.
+// A one-page header holds the schema: a directory of named columns, each with its
+// element type, values per row, row count and the page-aligned offset of its own
+// reserved region. A reader maps the file and uses any column in place without
+// touching the others. Appends write rows into the reserved space first and then
+// publish the new row counts, so a reader never sees half a row; a column that
+// outgrows its space makes the writer rebuild the file with room to spare.
+//
+//   bytes 0-3     "AQCL"
+//   4-7           version (uint32)
+//   8-11          number of columns (uint32)
+//   12-15         header size in bytes (uint32, 4096)
+//   16-271        source of the last appended segment (NUL-padded text)
+//   512 + 64*k    column k: name[24], type (uint32), width (uint32),
+//                 rows, capacity (rows), offset (bytes), consumed (uint64 each)
+//
+// All numbers are little-endian; values are float64 (type 1), int32 (type 2) or
+// bytes (type 3), row-major, 'width' values per row. 'consumed' counts what was
+// taken from the source written last.
+//
+// Every appended source is a segment. Row s of 'segment_source' (bytes, 256 per
+// row) holds the source of segment s, and every other column X has a companion
+// int32 column 'X_seg' giving the segment of each of its rows. A source exported
+// again keeps its segment: the rows already tagged with it are what has been
+// taken from it, so re-exporting only appends what is new, in any order.
+#define COLUMN_FILE_MAGIC "AQCL"
+#define COLUMN_FILE_VERSION 2
+#define COLUMN_FILE_HEADER_BYTES 4096
+#define COLUMN_FILE_SOURCE_BYTES 256
+#define COLUMN_FILE_MAX_COLUMNS 56
+#define COLUMN_FILE_DEFAULT_NAME "AutoQuantum_Results.aqcol"
+
+enum ColumnType { COLUMN_FLOAT64 = 1, COLUMN_INT32 = 2, COLUMN_BYTES = 3 };
+#define COLUMN_SEGMENT_SOURCE "segment_source"
+#define COLUMN_SEGMENT_SUFFIX "_seg"
+
+struct ColumnInfo
+{
+    std::string name = "";
+    uint32_t type = COLUMN_FLOAT64;
+    uint32_t width = 1;             // values per row
+    uint64_t rows = 0;
+    uint64_t capacity = 0;          // rows that fit before the file is rebuilt
+    uint64_t offset = 0;            // byte offset of row 0
+    uint64_t consumed = 0;          // source rows already exported
+};
+
+struct ColumnFile
+{
+    std::string filename = "";
+    std::string source = "";
+    std::vector<ColumnInfo> columns = {};
+    MappedFile mapped;              // only set by OpenColumnFile
+};
+
+// Rows to add to one column; 'replace_row' overwrites that row instead of appending.
+struct ColumnAppend
+{
+    std::string name = "";
+    uint32_t type = COLUMN_FLOAT64;
+    uint32_t width = 1;
+    uint64_t consumed = 0;          // source rows accounted for after this append
+    int64_t replace_row = -1;
+    std::vector<double> values = {};
+    std::vector<int32_t> ints = {};
+    std::vector<uint8_t> bytes = {};
+};
+
+// Zero-copy reading.
+bool OpenColumnFile(ColumnFile &file, std::string filename);
+void CloseColumnFile(ColumnFile &file);
+const ColumnInfo *FindColumn(const ColumnFile &file, std::string name);
+const void *ColumnData(const ColumnFile &file, const ColumnInfo &column);
+long FindSegment(const ColumnFile &file, std::string source);           // -1 if the source has no segment yet
+std::vector<uint64_t> SegmentRows(const ColumnFile &file, std::string name, long segment);
+
+// Writing.
+bool ReadColumnFileHeader(ColumnFile &file, std::string filename);
+bool AppendColumns(std::string filename, std::string source, std::vector<ColumnAppend> appends);
+std::vector<ColumnAppend> ExportJobColumns(std::string job_dir, const ColumnFile &existing);    // existing from OpenColumnFile
+
+// Export Mode (--export <job_dir> [job_dir...] [--export_file <file.aqcol>])
+extern std::vector<std::string> EXPORT_DIRS;
+extern std::string EXPORT_FILE;
+void check_export_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunExportMode();
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef FDHESSIAN_H
+#define FDHESSIAN_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "staging.h"
+#include "modules.h"
+#include "resources.h"
+#include "executor.h"
+#include "localqueue.h"
+#include "campaign.h"
+#include "chain.h"
+#include "thermo.h"
+
+// Distributed finite-difference Hessians (--freq --fd_hessian).
+// The job directory holds a reference gradient at the input geometry. Once it has
+// finished, every Cartesian coordinate is displaced by +/- the step into its own
+// disp.<atom>.<x|y|z><+|-> directory, starting from the reference orbitals, and the
+// 6N gradient jobs run as a job array (or packed, or through the local queue).
+// When the last of them is done, central differences of the gradients give the
+// Hessian, written to AutoQuantum_Hessian.txt for --thermo.
+#define FD_STATE_FILE "AutoQuantum_FD.state"
+#define FD_LOCK_FILE "AutoQuantum_FD.lock"
+
+extern bool FD_HESSIAN;
+extern double FD_STEP;                  // Bohr
+extern std::string FD_RESUME_DIR;
+void check_fd_hessian_mode(std::map<std::string,std::vector<std::string>> &flags);
+
+std::string fd_displacement_name(size_t coordinate, int sign);
+bool AssembleFDHessian(std::string job_dir, std::vector<double> &hessian, size_t &n_finished);
+void RunFDHessian(std::map<std::string,std::vector<std::string>> &flags);
+void ResumeFDHessian(std::string job_dir);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef LOCALQUEUE_H
+#define LOCALQUEUE_H
+
+#include "utilities.h"
+#include "executor.h"
+
+// Persistent local job queue for hosts without SLURM.
+// Job directories are appended to an on-disk journal of 'add', 'start' and
+// 'done' lines. A drainer replays the journal when it starts, so jobs that
+// were running when an earlier drainer died are run again and finished ones
+// are never repeated; jobs added while it runs are picked up as slots free.
+#define LOCAL_QUEUE_JOURNAL "AutoQuantum_Queue.journal"
+#define LOCAL_QUEUE_LOCK "AutoQuantum_Queue.lock"
+#define LOCAL_QUEUE_REPORT "AutoQuantum_Queue.report"
+
+extern std::string LOCAL_QUEUE_DIR;                 // --queue <dir>: add prepared jobs here instead of running them
+extern std::string RUN_QUEUE_DIR;                   // --run_queue <dir>: drain this queue
+extern unsigned int LOCAL_WORKERS;                  // --workers N, 0 for one per device or CPU set
+extern std::vector<std::string> LOCAL_DEVICES;      // --devices 0,1,...; CUDA_VISIBLE_DEVICES by default
+extern std::vector<std::vector<int>> LOCAL_CPU_SETS;    // --cpu_sets 0-7 8-15 ...
+void check_local_queue_flags(std::map<std::string,std::vector<std::string>> &flags);
+
+std::vector<int> parse_cpu_list(std::string list);
+void EnqueueLocalJobs(std::string queue_dir, std::vector<std::string> job_dirs);
+void RunLocalQueue(std::string queue_dir);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "utilities.h"
+#include <cstdint>
+
+// Buffered logging behind normal_log(), debug_log() and error_log().
+// Callers put records into a lock-free ring buffer and return; a background
+// thread writes them out in batches: the usual text to stdout/stderr, and with
+// --log_file (or AUTOQUANTUM_LOG_FILE) one JSON object per line, tagged with the
+// job directory and the phase being timed, rotated by size. Records are flushed
+// at exit. error_log() runs the cleanup hooks and flushes before it exits.
+enum LogLevel { LOG_DEBUG, LOG_INFO, LOG_ERROR };
+
+struct LogRecord
+{
+    LogLevel level = LOG_INFO;
+    int64_t time_us = 0;                // microseconds since the epoch
+    const char *phase = nullptr;        // phase current when the record was made, if any
+    std::string message = "";
+};
+
+#define LOG_RING_CAPACITY 4096          // records; a full ring makes callers wait for the writer
+#define LOG_WRITER_WAIT_MS 5            // longest an idle writer sleeps before looking again
+
+extern std::string LOG_FILE;            // --log_file <path>
+extern size_t LOG_MAX_BYTES;            // --log_max_mb N, rotation threshold
+extern int LOG_KEEP_FILES;              // --log_keep N, rotated files kept as <path>.1 ... <path>.N
+extern thread_local const char *LOG_PHASE;
+void check_log_flags(std::map<std::string,std::vector<std::string>> &flags);
+
+void LogMessage(LogLevel level, std::string message);
+void SetLogJobDirectory(std::string job_dir);
+void ShutdownLogging();
+
+void AddCleanupHook(std::function<void()> hook);
+void RunCleanupHooks();
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+#include "utilities.h"
+
+// Environment modules resolved once with 'module load' and cached as a snapshot of
+// the variables they change, keyed by module name and modulefile mtime. Modules
+// with no modulefile on MODULEPATH are resolved once per process and not cached.
+// Snapshots live in $XDG_CACHE_HOME/autoquantum/modules (or ~/.cache/...).
+struct ModuleEnvironment
+{
+    std::string module = "";
+    long long mtime = 0;
+    bool resolved = false;
+    std::map<std::string,std::string> prepend = {};    // value placed in front of the existing variable
+    std::map<std::string,std::string> set = {};        // value that replaces the variable outright
+};
+
+std::string module_cache_directory();
+std::string find_modulefile(std::string module);
+ModuleEnvironment ResolveModuleEnvironment(std::string module);
+std::map<std::string,std::string> ModuleProcessEnvironment(const ModuleEnvironment &environment);
+std::string ModuleScriptLines(std::string module);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "utilities.h"
+#include "tcoutput.h"
+#include "process.h"
+
+// SLURM job tracking.
+// Every sbatch submission leaves its job ID in the submitting directory and in
+// $XDG_CACHE_HOME/autoquantum/jobs.txt. Status and watch modes ask SLURM about
+// all tracked jobs with one squeue call (and one sacct call for those that have
+// left the queue) per interval, and follow tc_*.out progress by checking its
+// modification time and size each interval. Compute nodes writing to NFS or
+// Lustre raise no inotify events, so inotify only wakes the watch loop early.
+struct TrackedJob
+{
+    std::string job_id = "";
+    std::string job_dir = "";
+    std::string state = "SUBMITTED";       // SLURM state, summarized over array tasks
+    std::string tasks = "";                // per-state task counts for job arrays
+    std::string output = "";               // tc_*.out followed for progress, if any
+    fs::file_time_type output_time;        // modification time and size when last parsed
+    uintmax_t output_size = 0;
+    TCOutputResults progress;
+};
+
+#define JOB_ID_FILE "AutoQuantum_Job.id"
+#define MONITOR_DEFAULT_INTERVAL 60
+
+std::string ParseSbatchJobId(std::string response);
+void RecordSubmittedJob(std::string job_id, std::string job_dir);
+std::vector<TrackedJob> ReadTrackedJobs(std::vector<std::string> job_dirs);
+void QuerySlurmStates(std::vector<TrackedJob> &jobs);
+bool IsTerminalState(std::string state);
+std::string JobStatusTable(const std::vector<TrackedJob> &jobs);
+
+// Status / Watch Modes (--status [dirs...], --watch [dirs...] [--watch_interval S] [--notify <program>])
+extern bool STATUS_MODE;
+extern bool WATCH_MODE;
+extern int WATCH_INTERVAL;
+extern std::vector<std::string> MONITOR_DIRS;
+extern std::string MONITOR_NOTIFY;
+void check_monitor_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunMonitorMode();
+
+#endif
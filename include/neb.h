@@ -0,0 +1,60 @@
+#ifndef NEB_H
+#define NEB_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "modules.h"
+#include "resources.h"
+#include "executor.h"
+#include "localqueue.h"
+#include "chain.h"
+
+// AutoQuantum-driven nudged elastic band (--ts --neb).
+// Instead of one TeraChem process walking through the images in turn, every
+// iteration runs the image gradients as separate TeraChem jobs side by side, one
+// per GPU or MIG slice, each starting from the orbitals of the same image in the
+// previous iteration. The band forces (improved tangent, springs, climbing image)
+// and the FIRE update of all images are done here. Everything needed to continue
+// is kept in AutoQuantum_NEB.state, so an interrupted band picks up from its last
+// complete iteration.
+#define NEB_STATE_FILE "AutoQuantum_NEB.state"
+#define NEB_TEMPLATE_FILE "AutoQuantum_NEB.in"
+#define NEB_PATH_FILE "neb.xyz"
+#define NEB_LOG_FILE "neb_iterations.txt"
+
+struct NEBState
+{
+    size_t iteration = 0;
+    size_t n_images = 0;                    // including both fixed endpoints
+    size_t n_coordinates = 0;               // 3 * atoms
+    bool climbing = false;
+    bool converged = false;
+    double spring = DEFAULT_NEB_SPRING;     // Hartree/Bohr^2
+    double force_tolerance = DEFAULT_NEB_FORCE_TOL;
+    size_t max_iterations = DEFAULT_NEB_MAX_ITERATIONS;
+    double dt = 0.0;                        // FIRE time step, velocity and mixing
+    double alpha = 0.0;
+    size_t n_downhill = 0;
+    std::vector<std::string> elements = {};
+    std::vector<double> positions = {};     // Bohr, image-major
+    std::vector<double> velocities = {};
+    std::vector<double> energies = {};      // Hartree
+};
+
+extern bool NEB;
+extern std::string NEB_RESUME_DIR;
+extern double NEB_SPRING;
+extern double NEB_FORCE_TOL;
+extern size_t NEB_MAX_ITERATIONS;     // 0 for the default, or what the band was started with
+void check_neb_mode(std::map<std::string,std::vector<std::string>> &flags);
+
+bool ReadNEBState(NEBState &state, std::string filename);
+void WriteNEBState(const NEBState &state, std::string filename);
+std::vector<double> InterpolatePath(const XYZFrames &frames, size_t n_images);
+double NEBForces(const NEBState &state, const std::vector<double> &gradients, std::vector<double> &forces);
+void RunNEB(std::map<std::string,std::vector<std::string>> &flags);
+void RunNEBIterations(std::string job_dir);
+
+#endif
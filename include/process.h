@@ -0,0 +1,41 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "utilities.h"
+#include <sys/types.h>
+
+// Child processes started with posix_spawn from an argument vector, no shell involved.
+// Each child is tracked through a pidfd where the kernel supports it, so many
+// children can be waited on at once with poll().
+struct Process
+{
+    pid_t pid = -1;
+    int pidfd = -1;
+    int output_fd = -1;         // read end of the stdout pipe when capturing
+    std::string output = "";    // captured stdout (and stderr when merged)
+    int exit_code = -1;         // exit status, or 128+signal when killed by a signal
+    bool running = false;
+};
+
+struct ProcessOptions
+{
+    std::string working_dir = "";
+    std::string stdout_file = "";           // redirect stdout to this file
+    std::string stderr_file = "";           // redirect stderr to this file
+    bool capture = false;                   // capture stdout into Process::output
+    bool merge_stderr = false;              // send stderr wherever stdout goes
+    std::map<std::string,std::string> environment = {};     // added to (or replacing in) the current environment
+    std::vector<int> cpu_affinity = {};     // CPUs the child may run on, empty for no restriction
+};
+
+#define PROCESS_READ_BUFFER_SIZE (1 << 16)
+
+bool SpawnProcess(Process &process, std::vector<std::string> args, ProcessOptions options = ProcessOptions());
+bool PollProcess(Process &process);
+int WaitProcess(Process &process);
+int WaitAnyProcess(std::vector<Process*> &processes, int timeout_ms);
+void KillProcess(Process &process, int signal_number);
+std::string FindInPath(std::string program, std::string path = "");
+Process RunProcess(std::vector<std::string> args, ProcessOptions options = ProcessOptions());
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "trajectory.h"
+#include "tcoutput.h"
+
+// Size-aware resource requests.
+// Each job is sized from its QM atom count and an estimate of its basis
+// functions; runtime is predicted from the timings of earlier runs of the same
+// calculation type (fit as time ~ c * nbf^p), falling back to a rough prior.
+struct JobFeatures
+{
+    std::string calc_type = "";
+    std::string method = "";
+    std::string basis = "";
+    size_t n_atoms = 0;                 // QM atoms
+    size_t n_basis = 0;                 // estimated basis functions
+    int steps = 1;                      // MD/TS steps; runtimes are learned per step
+};
+
+struct JobResources
+{
+    int walltime_minutes = DEFAULT_SLURM_MAX_WALLTIME_MINUTES;
+    int cpus = 3;
+    int gpus = 1;
+    int mem_gb = 20;
+    int gpumem = 256;                   // TeraChem 'gpumem' keyword
+    std::string gres = "";              // replaces gpu:<gpus> when set, e.g. a MIG slice request
+};
+
+extern bool AUTOTUNE;
+extern JobResources JOB_RESOURCES;     // what SlurmJobHeader() asks the scheduler for
+void check_resource_flags(std::map<std::string,std::vector<std::string>> &flags);
+
+std::vector<int> read_qm_indices(std::string filename);
+JobFeatures JobFeaturesFromKeywords(std::map<std::string,std::string> keywords);
+double PredictRuntimeSeconds(const JobFeatures &features);
+JobResources EstimateJobResources(const JobFeatures &features);
+JobResources CombineJobResources(const JobResources &a, const JobResources &b, bool sequential);
+JobResources TuneJobKeywords(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
+std::string SlurmWalltime(int minutes);
+
+// Timing history ($XDG_CACHE_HOME/autoquantum/timings.txt): runs are recorded as pending when prepared and picked up once their output shows a finish.
+// Only finished records are capped; pending ones are kept until their run ends or its directory is gone.
+#define TIMING_HISTORY_MAX_RECORDS 2000
+void RecordPendingTiming(const JobFeatures &features, std::string output);
+void RecordPendingTimings(const std::vector<JobFeatures> &features, const std::vector<std::string> &outputs);
+
+#endif
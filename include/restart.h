@@ -0,0 +1,36 @@
+#ifndef RESTART_H
+#define RESTART_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "chain.h"
+#include "monitor.h"
+#include "executor.h"
+
+// Automatic restart of interrupted geometry optimizations.
+// A run that hit walltime, was preempted or lost its GPU leaves a partial output,
+// an optim.xyz trajectory and orbitals in scrdir. Those are set aside as
+// <name>.restartN.*, the input is rewritten to start from the last completed
+// geometry with the last orbitals as guess, and the job is submitted again,
+// until the retry budget is spent. Job directories count their own attempts.
+#define RESTART_STATE_FILE "AutoQuantum_Restart.state"
+
+enum RestartReason { RESTART_NONE, RESTART_INTERRUPTED, RESTART_SCHEDULER, RESTART_GPU_ERROR, RESTART_FAILED };
+
+extern bool AUTO_RESTART;               // --no_restart turns it off
+extern int MAX_RESTARTS;                // --max_restarts N
+extern std::string RESTART_CHECK_DIR;   // --restart_check <job_dir> [job_id]
+extern std::string RESTART_CHECK_JOB;
+void check_restart_flags(std::map<std::string,std::vector<std::string>> &flags);
+
+bool IsRestartableCalculation(std::string run_type);
+RestartReason DiagnoseInterruptedRun(const TCOutputResults &results, std::string slurm_state);
+std::string RestartReasonText(RestartReason reason);
+std::string RestartCheckCommand();
+bool PrepareRestart(std::string job_dir, std::string job_id, std::string slurm_state);
+std::string RestartInterruptedJob(std::string job_dir, std::string job_id, std::string slurm_state);
+void RunRestartCheckMode();
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include "utilities.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+
+// Content-hash result cache.
+// 'exact' hashes the final keyword set with the normalized geometry and the
+// prmtop/qmindices contents; a finished, error-free run under the same key is
+// reused instead of run again. Blocks written after the keywords (such as
+// $constraint_freeze) are part of both keys. 'chemistry' leaves the coordinates out, so runs
+// on the same system at a nearby geometry can lend their orbitals as a guess.
+struct CacheKey
+{
+    std::string exact = "";
+    std::string chemistry = "";
+    bool valid = false;
+};
+
+extern bool RESULT_CACHE;
+extern std::string RESULT_CACHE_DIR;
+extern double RESULT_CACHE_GUESS_RMSD;     // Angstrom
+void check_result_cache_flags(std::map<std::string,std::vector<std::string>> &flags);
+
+std::string content_hash(const std::string &data);
+CacheKey ResultCacheKey(std::map<std::string,std::string> keywords, std::string input_blocks = "");
+std::string LookupCachedResult(const CacheKey &key);
+std::string LookupCachedGuess(const CacheKey &key, std::string coordinates);
+void RegisterCachedResult(const CacheKey &key, std::string job_dir, std::string output, std::map<std::string,std::string> keywords);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef STAGING_H
+#define STAGING_H
+
+#include "utilities.h"
+
+// Node-scratch staging for generated batch scripts.
+// Each job works in its own $TMPDIR/autoquantum.$SLURM_JOB_ID directory.
+// Stage-in copies the listed files and directories plus whatever the TeraChem inputs reference
+// (coordinates, prmtop, qmindices, guess). Stage-out copies back only the
+// declared outputs, uncompressed and in parallel, and runs on normal exit, on
+// error and on scheduler signals, followed by any after_stage_out lines. If any
+// copy fails, the scratch directory is left in place rather than removed.
+// While the job runs, tc_*.out files (also one directory down) are copied back every
+// DEFAULT_STAGE_MIRROR_SECONDS so progress can be followed from the job directory.
+struct StagingPlan
+{
+    std::vector<std::string> inputs = {};       // files or directories copied as-is
+    std::vector<std::string> tc_inputs = {};    // TeraChem inputs, copied along with the files they reference
+    std::vector<std::string> outputs = {};      // files, directories or globs copied back
+    std::string after_stage_out = "";           // shell lines run in the submit directory once outputs are back
+};
+
+std::string StagedScriptBody(const StagingPlan &plan, std::string run_lines);
+
+#endif
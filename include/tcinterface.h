@@ -20,10 +20,28 @@
 // void get_max_keyword_length(std::map<std::string,std::vector<std::string>> flags);
 
 // Write TeraChem Input
-// void generate_full_keyword_set(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
-
-void Write_TC_Input(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
+void generate_full_keyword_set(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
+
+// Calculation type state set by get_calc_type().
+extern bool USE_CASSCF;
+extern std::string CALC_TYPE;
+extern std::string TC_FILENAME;
+extern std::string TC_OUTFILE;
+extern std::string TC_ERRFILE;
+
+void move_to_jobdir(std::map<std::string,std::string> keywords, std::string jobdir);
+void Prepare_TC_Keywords(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
+bool Write_TC_Input_File(std::map<std::string,std::string> keywords, std::string filename);
+bool Read_TC_Input_File(std::map<std::string,std::string> &keywords, std::string filename);
+std::string Read_TC_Input_Blocks(std::string filename);
+std::string MMFrozenBlock();
+bool Write_TC_Input(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords);
+std::string SlurmJobHeader(std::string job_name, std::string outfile, std::string errfile);
+std::string SubmitBatchScript(std::string script, std::string working_dir);
+void SubmitSlurmScript(std::string job_name, std::string outfile, std::string errfile, std::string body);
 void SubmitSlurmJob(std::map<std::string,std::string> keywords);
+std::string TeraChemExecutable();
+std::map<std::string,std::string> TeraChemEnvironment();
 void RunTeraChem();
 
 
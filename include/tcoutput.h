@@ -0,0 +1,50 @@
+#ifndef TCOUTPUT_H
+#define TCOUTPUT_H
+
+#include "utilities.h"
+#include <cstdint>
+
+// Structured results pulled out of a TeraChem tc_*.out file.
+// The parser state is kept alongside the results so that a growing file can be
+// picked up again at 'offset' without re-reading what has already been parsed.
+struct TCOutputResults
+{
+    uint64_t offset = 0;                    // bytes of the output consumed so far (always at a line boundary)
+    uint64_t signature = 0;                 // hash of the parsed head of the file, to detect a replaced output
+    bool has_energy = false;
+    double final_energy = 0.0;              // last "FINAL ENERGY" in a.u.
+    std::vector<double> scf_energies = {};  // every "FINAL ENERGY" in file order
+    std::vector<int> scf_iterations = {};   // SCF iteration count for each converged SCF
+    int opt_steps = 0;                      // number of optimization cycles started
+    std::vector<double> gradient = {};      // last complete gradient, x/y/z per atom in Hartree/Bohr
+    double total_time = -1.0;               // "Total processing time" in seconds, -1 if not yet printed
+    bool finished = false;                  // "Job finished" banner seen
+    std::vector<std::string> errors = {};   // error banners, capped at TC_OUTPUT_MAX_ERRORS
+
+    // Parser state carried between incremental passes.
+    bool in_scf = false;
+    int scf_iter_count = 0;
+    int gradient_state = 0;                 // 0 = outside, 1 = header seen, 2 = reading rows
+    std::vector<double> gradient_buffer = {};
+};
+
+#define TC_OUTPUT_MAX_ERRORS 32
+#define TC_OUTPUT_CHUNK_SIZE (1 << 20)
+
+// Parse Mode (--parse <tc_output>)
+extern std::string PARSE_TARGET;
+void check_parse_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunParseMode();
+
+// Parsing
+void parse_tc_output_line(TCOutputResults &results, const std::string &line);
+bool parse_tc_output_from(TCOutputResults &results, std::string filename);
+TCOutputResults ParseTCOutput(std::string filename);
+bool PeekTCOutput(TCOutputResults &results, std::string filename);     // no checkpoint written, never exits
+
+// Results records
+std::string TCResultsToJSON(const TCOutputResults &results);
+bool WriteTCResultsBinary(const TCOutputResults &results, std::string filename);
+bool ReadTCResultsBinary(TCOutputResults &results, std::string filename);
+
+#endif
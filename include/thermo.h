@@ -0,0 +1,60 @@
+#ifndef THERMO_H
+#define THERMO_H
+
+#include "utilities.h"
+#include "tcinterface.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "executor.h"
+
+// Harmonic analysis and thermochemistry of frequency jobs.
+// The Cartesian Hessian (Hartree/Bohr^2) is read from AutoQuantum_Hessian.txt in the
+// job directory, or from a printed Hessian block in the output, mass-weighted, and
+// diagonalized in the space orthogonal to overall translation and rotation. Without
+// a Hessian, the frequency table printed by TeraChem is used as is.
+struct VibrationalAnalysis
+{
+    size_t n_atoms = 0;
+    std::vector<double> masses = {};        // amu
+    std::vector<double> frequencies = {};   // cm^-1, imaginary modes as negative numbers
+    size_t n_imaginary = 0;
+    double moments[3] = {0.0, 0.0, 0.0};    // principal moments of inertia, amu Bohr^2
+    bool linear = false;
+    bool has_energy = false;
+    double electronic_energy = 0.0;         // Hartree
+    int multiplicity = 1;
+};
+
+// Thermal corrections at one temperature and pressure, in Hartree (entropy in Hartree/K).
+struct ThermoPoint
+{
+    double temperature = 298.15;            // K
+    double pressure = 1.0;                  // atm
+    double zpe = 0.0;
+    double enthalpy_correction = 0.0;       // ZPE + thermal energy + kT
+    double entropy = 0.0;                   // RRHO, or quasi-RRHO below the cutoff
+    double gibbs_correction = 0.0;
+};
+
+#define HESSIAN_FILE "AutoQuantum_Hessian.txt"
+#define THERMO_SUMMARY_FILE "AutoQuantum_Thermo.tsv"
+
+double element_mass(int atomic_number);
+void SymmetricEigen(std::vector<double> &matrix, size_t n, std::vector<double> &eigenvalues);
+bool ParseHessianBlock(std::string output, size_t n, std::vector<double> &hessian);
+bool ReadHessianFile(std::string filename, size_t n, std::vector<double> &hessian);
+void WriteHessianFile(std::string filename, const std::vector<double> &hessian, size_t n);
+std::vector<double> ParseFrequencyTable(std::string output);
+bool HarmonicAnalysis(VibrationalAnalysis &analysis, const XYZFrames &geometry, const std::vector<double> &hessian);
+std::vector<ThermoPoint> Thermochemistry(const VibrationalAnalysis &analysis, const std::vector<double> &temperatures, const std::vector<double> &pressures);
+
+// Thermochemistry Mode (--thermo <job_dir | campaign_dir> ... [--temperatures 298.15,310] [--pressures 1] [--qrrho_cutoff 100] [--symmetry_number 1])
+extern std::vector<std::string> THERMO_DIRS;
+extern std::vector<double> THERMO_TEMPERATURES;
+extern std::vector<double> THERMO_PRESSURES;
+extern double QRRHO_CUTOFF;             // cm^-1; 0 for plain RRHO
+extern int SYMMETRY_NUMBER;
+void check_thermo_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunThermoMode();
+
+#endif
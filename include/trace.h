@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "utilities.h"
+#include "logger.h"
+#include <cstdint>
+
+// Per-phase timing (--trace, or AUTOQUANTUM_TRACE=1).
+// The phase of the innermost timer also tags log records, traced or not.
+// Scoped timers around AutoQuantum's own phases, together with the SCF iteration
+// and gradient times TeraChem reports in its output, are written at exit as
+// Chrome trace events (AutoQuantum_Trace.json, for chrome://tracing or Perfetto)
+// and a per-phase summary (AutoQuantum_Timing.json) in the directory AutoQuantum
+// finishes in, normally the job directory. Later processes in the same directory
+// add their events to the existing trace. With tracing off, a timer costs one
+// test of TRACE.
+#define TRACE_FILE "AutoQuantum_Trace.json"
+#define TRACE_SUMMARY_FILE "AutoQuantum_Timing.json"
+
+struct TraceEvent
+{
+    std::string name = "";
+    std::string category = "";      // "autoquantum" or "terachem"
+    int64_t start_us = 0;           // microseconds since the epoch, so separate processes line up
+    int64_t duration_us = 0;
+    int pid = 0;                    // 0 for TeraChem's own timings
+    int tid = 0;
+    std::string args = "";          // body of a JSON object, may be empty
+};
+
+extern bool TRACE;
+extern std::string TRACE_REPORT_DIR;    // --trace_report <job_dir>
+void check_trace_flags(std::map<std::string,std::vector<std::string>> &flags);
+
+int64_t trace_clock_us();
+void RecordTraceEvent(const char *name, int64_t start_us, int64_t end_us);
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *phase) : name(phase), previous_phase(LOG_PHASE), start_us(TRACE ? trace_clock_us() : 0)
+    {
+        LOG_PHASE = phase;
+    }
+    ~TraceScope()
+    {
+        LOG_PHASE = previous_phase;
+        if (start_us != 0)
+        {
+            RecordTraceEvent(name, start_us, trace_clock_us());
+        }
+    }
+private:
+    const char *name;
+    const char *previous_phase;
+    int64_t start_us;
+};
+
+std::vector<TraceEvent> ReadTraceEvents(std::string filename);
+std::vector<TraceEvent> TeraChemTraceEvents(std::string tc_output, int64_t start_us);
+std::string TraceSummaryJSON(const std::vector<TraceEvent> &events);
+void WriteTraceFiles(std::string dir);
+void RunTraceReportMode();
+
+#endif
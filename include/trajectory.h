@@ -0,0 +1,46 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "utilities.h"
+#include <cstdint>
+
+// Multi-frame XYZ trajectory (optim.xyz, coors.xyz, ...) opened through a memory map.
+// 'offsets' holds the byte offset of every complete frame and is persisted in a
+// '<file>.aqidx' sidecar, so later opens only index frames appended since.
+struct XYZTrajectory
+{
+    std::string filename = "";
+    MappedFile mapped;
+    std::vector<uint64_t> offsets = {};
+    uint64_t indexed_bytes = 0;     // end of the last complete frame
+};
+
+// Trajectories smaller than this are cheap to rescan, so no sidecar is written for them.
+#define TRAJECTORY_INDEX_MIN_BYTES (1 << 20)
+
+// Decoded frames stored as structure-of-arrays: coordinate k of frame f is x[f*n_atoms + k].
+struct XYZFrames
+{
+    size_t n_atoms = 0;
+    std::vector<std::string> elements = {};
+    std::vector<std::string> comments = {};
+    std::vector<size_t> frame_ids = {};
+    std::vector<double> x = {};
+    std::vector<double> y = {};
+    std::vector<double> z = {};
+};
+
+// Frame Extraction Mode (--extract_frame <trajectory> [frame])
+extern std::string EXTRACT_TRAJECTORY;
+extern long EXTRACT_FRAME;
+void check_extract_frame_mode(std::map<std::string,std::vector<std::string>> &flags);
+void RunExtractFrameMode();
+
+bool OpenTrajectory(XYZTrajectory &trajectory, std::string filename);
+void CloseTrajectory(XYZTrajectory &trajectory);
+size_t TrajectoryFrameCount(const XYZTrajectory &trajectory);
+bool ReadTrajectoryFrames(XYZFrames &result, const XYZTrajectory &trajectory, std::vector<size_t> frames, unsigned int n_threads);
+XYZFrames ReadLastFrame(std::string filename);
+std::string FrameToXYZ(const XYZFrames &frames, size_t k);
+
+#endif
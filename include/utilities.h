@@ -20,12 +20,17 @@
 #include <ctime>
 #include <set>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <atomic>
 #include "globals.h"
 #include "config.h"
 
 namespace fs = std::experimental::filesystem;
 
 // LOGGING FUNCTIONS - Normal, Error, Debug-flagged.
+// Buffered and written by a background thread; see logger.h.
 
 void error_log(std::string message,int exit_code);
 void normal_log(std::string message);
@@ -41,6 +46,10 @@ void silent_shell(std::string cmd); //overload for above.
 std::string GetSysResponse(const char* cmd);
 std::string GetSysResponse(std::string cmd); //overload for above.
 
+bool UseSlurmSubmission();
+std::string AutoQuantumExecutable();
+std::string autoquantum_cache_directory();
+
 bool CheckProgAvailable(const char* program);
 bool CheckProgAvailable(std::string program); //overload for above.
 
@@ -54,12 +63,29 @@ std::string LastLineOfFile(std::string filename);
 int count_lines_in_file(std::string filename);
 void compress_and_delete(std::string directory);
 std::vector<std::string> sort_files_by_timestamp(std::string directory,std::string pattern);
+// Read-only memory maps, for large outputs and trajectories.
+struct MappedFile
+{
+    int fd = -1;
+    const char *data = nullptr;
+    size_t size = 0;
+};
+bool map_file(MappedFile &mapped, std::string filename);
+void unmap_file(MappedFile &mapped);
 std::string MakeIterativeDirectoryName(std::string dir_base, int num_zeros);
 
+// Threading
+unsigned int default_thread_count();
+void parallel_for(size_t n_items, unsigned int n_threads, std::function<void(size_t)> task);
+
 // String Utilities
 int is_empty(const char *s);
 std::string string_between(std::string incoming, std::string first_delim, std::string second_delim);
 std::vector<std::string> split_string(std::string incoming, std::string delim);
+std::string json_escape(std::string text);
+
+// Chemistry
+int element_atomic_number(std::string element);    // 0 when the symbol is unknown
 
 // Command Line Parser
 void parse_command_line_arguments(std::map<std::string,std::vector<std::string>> &flags, int argc, char** argv);
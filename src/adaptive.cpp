@@ -0,0 +1,382 @@
+#include "adaptive.h"
+#include "logger.h"
+#include "amber.h"
+
+bool ADAPTIVE = false;
+std::string ADAPTIVE_RESUME_DIR = "";
+AdaptiveState ADAPTIVE_SETTINGS;
+
+void check_adaptive_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("adaptive") > 0)
+    {
+        if (flags["adaptive"].empty())
+        {
+            PrintUsage();
+            error_log("The --adaptive flag requires a file of 0-based core atom indices.", 1);
+        }
+        ADAPTIVE = true;
+        std::ifstream fin(flags["adaptive"][0]);
+        if (!fin.is_open())
+        {
+            error_log("Unable to open adaptive core index file " + flags["adaptive"][0], 1);
+        }
+        int index;
+        while (fin >> index)
+        {
+            ADAPTIVE_SETTINGS.core.push_back(index);
+        }
+        fin.close();
+        flags.erase("adaptive");
+    }
+    if (flags.count("adaptive_resume") > 0)
+    {
+        ADAPTIVE_RESUME_DIR = flags["adaptive_resume"].empty() ? "." : flags["adaptive_resume"][0];
+        flags.erase("adaptive_resume");
+    }
+    std::map<std::string,double*> settings = {{"adaptive_radius"      , &ADAPTIVE_SETTINGS.radius},
+                                              {"adaptive_gradient"    , &ADAPTIVE_SETTINGS.gradient},
+                                              {"adaptive_displacement", &ADAPTIVE_SETTINGS.displacement},
+                                              {"adaptive_shell"       , &ADAPTIVE_SETTINGS.shell}};
+    for (auto &setting : settings)
+    {
+        if (flags.count(setting.first) > 0)
+        {
+            if (!flags[setting.first].empty())
+            {
+                *setting.second = std::stod(flags[setting.first][0]);
+            }
+            flags.erase(setting.first);
+        }
+    }
+    if (flags.count("adaptive_max_cycles") > 0)
+    {
+        if (!flags["adaptive_max_cycles"].empty())
+        {
+            ADAPTIVE_SETTINGS.max_cycles = std::stoi(flags["adaptive_max_cycles"][0]);
+        }
+        flags.erase("adaptive_max_cycles");
+    }
+}
+
+std::string format_index_ranges(std::vector<int> indices)
+{
+    // TeraChem constraint blocks use 1-based atom ranges, e.g. "1-4,7,9-12".
+    std::sort(indices.begin(), indices.end());
+    std::stringstream buffer;
+    buffer.str("");
+    size_t i = 0;
+    while (i < indices.size())
+    {
+        size_t j = i;
+        while (j + 1 < indices.size() && indices[j+1] == indices[j] + 1)
+        {
+            j++;
+        }
+        buffer << (i ? "," : "") << indices[i] + 1;
+        if (j > i)
+        {
+            buffer << "-" << indices[j] + 1;
+        }
+        i = j + 1;
+    }
+    return buffer.str();
+}
+
+bool ReadAdaptiveState(AdaptiveState &state, std::string filename)
+{
+    std::ifstream fin(filename);
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    state = AdaptiveState();
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        std::stringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "cycle") fields >> state.cycle;
+        else if (key == "max_cycles") fields >> state.max_cycles;
+        else if (key == "radius") fields >> state.radius;
+        else if (key == "gradient") fields >> state.gradient;
+        else if (key == "displacement") fields >> state.displacement;
+        else if (key == "shell") fields >> state.shell;
+        else if (key == "done") fields >> state.done;
+        else if (key == "casscf") fields >> USE_CASSCF;
+        else if (key == "core" || key == "frozen")
+        {
+            std::vector<int> &target = (key == "core") ? state.core : state.frozen;
+            int index;
+            while (fields >> index)
+            {
+                target.push_back(index);
+            }
+        }
+        else if (key == "keyword")
+        {
+            std::string name, value;
+            fields >> name;
+            std::getline(fields, value);
+            value.erase(0, value.find_first_not_of(" "));
+            state.keywords[name] = value;
+        }
+    }
+    fin.close();
+    return true;
+}
+
+void WriteAdaptiveState(const AdaptiveState &state, std::string filename)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "cycle " << state.cycle << std::endl;
+    buffer << "max_cycles " << state.max_cycles << std::endl;
+    buffer << "radius " << state.radius << std::endl;
+    buffer << "gradient " << state.gradient << std::endl;
+    buffer << "displacement " << state.displacement << std::endl;
+    buffer << "shell " << state.shell << std::endl;
+    buffer << "done " << state.done << std::endl;
+    buffer << "casscf " << USE_CASSCF << std::endl;
+    buffer << "core";
+    for (int index : state.core) buffer << " " << index;
+    buffer << std::endl << "frozen";
+    for (int index : state.frozen) buffer << " " << index;
+    buffer << std::endl;
+    for (auto &keyword : state.keywords)
+    {
+        buffer << "keyword " << keyword.first << " " << keyword.second << std::endl;
+    }
+    write_to_file(filename, buffer.str());
+}
+
+void SetAdaptiveCycleFiles(int cycle)
+{
+    std::stringstream tag;
+    tag << "c" << std::setw(3) << std::setfill('0') << cycle;
+    CALC_TYPE = "OPT";
+    TC_FILENAME = "tc_opt." + tag.str() + ".in";
+    TC_OUTFILE = "tc_opt." + tag.str() + ".out";
+    TC_ERRFILE = "tc_opt." + tag.str() + ".err";
+}
+
+std::string adaptive_scrdir(int cycle)
+{
+    std::stringstream tag;
+    tag << "scr.c" << std::setw(3) << std::setfill('0') << cycle << "/";
+    return tag.str();
+}
+
+bool Write_Adaptive_Cycle_Input(AdaptiveState &state)
+{
+    SetAdaptiveCycleFiles(state.cycle);
+    state.keywords["scrdir"] = adaptive_scrdir(state.cycle);
+    if (!Write_TC_Input_File(state.keywords, TC_FILENAME))
+    {
+        return false;
+    }
+    if (!state.frozen.empty())
+    {
+        append_to_file(TC_FILENAME, "$constraint_freeze\nxyz " + format_index_ranges(state.frozen) + "\n$end\n");
+    }
+    return true;
+}
+
+double atom_distance(const XYZFrames &a, size_t i, const XYZFrames &b, size_t j)
+{
+    double dx = a.x[i] - b.x[j];
+    double dy = a.y[i] - b.y[j];
+    double dz = a.z[i] - b.z[j];
+    return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+void SubmitAdaptiveSlurmJob()
+{
+    // All cycles run back to back inside one allocation by resuming the driver on the compute node.
+    StagingPlan plan;
+    plan.inputs = {ADAPTIVE_STATE_FILE};
+    plan.tc_inputs = {TC_FILENAME};
+    plan.outputs = {"tc_opt.c*", "scr.c*", "adaptive.c*.xyz", ADAPTIVE_STATE_FILE};
+    std::string body = "\n" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + StagedScriptBody(plan, AutoQuantumExecutable() + " --adaptive_resume . " + (DEBUG ? "--debug" : "") + "\n");
+    SubmitSlurmScript("AutoQuantum_TC_ADAPTIVE", "slurm_tc_adaptive.out", "slurm_tc_adaptive.err", body);
+}
+
+void RunAdaptiveRestraints(std::map<std::string,std::vector<std::string>> &flags)
+{
+    AdaptiveState state = ADAPTIVE_SETTINGS;
+    Prepare_TC_Keywords(flags, state.keywords);
+    if (CALC_TYPE != "OPT")
+    {
+        error_log("Adaptive Restraints is only available for geometry optimizations (--opt).", 1);
+    }
+    // Every cycle is an optimization of the full QM region, all inside one allocation.
+    JOB_RESOURCES.walltime_minutes = std::min(DEFAULT_SLURM_MAX_WALLTIME_MINUTES, JOB_RESOURCES.walltime_minutes * state.max_cycles);
+    if (state.core.empty())
+    {
+        error_log("No core atoms were given for Adaptive Restraints.", 1);
+    }
+    if (MM_CUTOFF > 0.0 || state.keywords.count("prmtop") > 0 || state.keywords.count("qmindices") > 0 || fs::path(state.keywords["coordinates"]).extension() != ".xyz")
+    {
+        error_log("Adaptive Restraints needs XYZ coordinates without MM atoms.", 1);
+    }
+
+    // Prepare working directory, with the inputs referenced by their copied names.
+    std::string job_dir = MakeIterativeDirectoryName("AutoQuantum", 4);
+    move_to_jobdir(state.keywords, job_dir);
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    state.keywords["coordinates"] = fs::path(state.keywords["coordinates"]).filename().string();
+    normal_log("Copied relevant input files to " + job_dir);
+
+    // Freeze everything farther than the radius from every core atom.
+    XYZFrames geometry = ReadLastFrame(state.keywords["coordinates"]);
+    if (geometry.n_atoms == 0)
+    {
+        error_log("Unable to read coordinates from " + state.keywords["coordinates"], 1);
+    }
+    for (size_t i = 0; i < geometry.n_atoms; i++)
+    {
+        bool near_core = false;
+        for (int c : state.core)
+        {
+            if (c >= 0 && (size_t)c < geometry.n_atoms && atom_distance(geometry, i, geometry, c) <= state.radius)
+            {
+                near_core = true;
+                break;
+            }
+        }
+        if (!near_core)
+        {
+            state.frozen.push_back(i);
+        }
+    }
+    normal_log("Adaptive Restraints: " + std::to_string(state.frozen.size()) + " of " + std::to_string(geometry.n_atoms) + " atoms frozen for cycle 1.");
+
+    if (!Write_Adaptive_Cycle_Input(state))
+    {
+        error_log("Unable to open " + TC_FILENAME + " for writing.  Check permissions", 1);
+    }
+    WriteAdaptiveState(state, ADAPTIVE_STATE_FILE);
+
+    if (DRYRUN)
+    {
+        normal_log("DRYRUN flag was invoked.  Input files have been generated, but TeraChem will not be run at this time.");
+        return;
+    }
+    if (UseSlurmSubmission())
+    {
+        SubmitAdaptiveSlurmJob();
+        return;
+    }
+    RunAdaptiveCycles();
+}
+
+void RunAdaptiveCycles()
+{
+    AdaptiveState state;
+    if (!ReadAdaptiveState(state, ADAPTIVE_STATE_FILE))
+    {
+        error_log("Unable to read " + (std::string)ADAPTIVE_STATE_FILE, 1);
+    }
+
+    while (!state.done)
+    {
+        SetAdaptiveCycleFiles(state.cycle);
+        TCOutputResults results;
+        if (fs::exists(TC_OUTFILE))
+        {
+            results = ParseTCOutput(TC_OUTFILE);
+        }
+        if (!results.finished)
+        {
+            debug_log("Running Adaptive Restraints cycle " + std::to_string(state.cycle));
+            RunTeraChem();
+            results = ParseTCOutput(TC_OUTFILE);
+        }
+        if (!results.finished || !results.errors.empty())
+        {
+            error_log("Adaptive Restraints cycle " + std::to_string(state.cycle) + " did not finish cleanly, see " + TC_OUTFILE, 1);
+        }
+
+        XYZFrames start = ReadLastFrame(state.keywords["coordinates"]);
+        XYZFrames end = ReadLastFrame(adaptive_scrdir(state.cycle) + "optim.xyz");
+        if (end.n_atoms == 0 || end.n_atoms != start.n_atoms)
+        {
+            error_log("No usable optimized geometry found for cycle " + std::to_string(state.cycle), 1);
+        }
+        std::stringstream next_xyz;
+        next_xyz << "adaptive.c" << std::setw(3) << std::setfill('0') << state.cycle << ".xyz";
+        write_to_file(next_xyz.str(), FrameToXYZ(end, 0));
+
+        // A converged cycle with nothing frozen is the unrestrained optimization.
+        if (state.frozen.empty())
+        {
+            state.done = true;
+            WriteAdaptiveState(state, ADAPTIVE_STATE_FILE);
+            normal_log("Adaptive Restraints optimization converged after " + std::to_string(state.cycle) + " cycles, final geometry in " + next_xyz.str());
+            break;
+        }
+        if (state.cycle >= state.max_cycles)
+        {
+            error_log("Adaptive Restraints reached the maximum of " + std::to_string(state.max_cycles) + " cycles.", 1);
+        }
+
+        // Release frozen atoms with large residual gradients, or next to free atoms that moved this cycle.
+        std::set<int> frozen(state.frozen.begin(), state.frozen.end());
+        std::vector<size_t> moved = {};
+        for (size_t i = 0; i < end.n_atoms; i++)
+        {
+            if (frozen.count(i) == 0 && atom_distance(start, i, end, i) > state.displacement)
+            {
+                moved.push_back(i);
+            }
+        }
+        std::vector<int> still_frozen = {};
+        std::vector<int> released = {};
+        for (int i : state.frozen)
+        {
+            bool release = false;
+            if (3 * (size_t)i + 2 < results.gradient.size())
+            {
+                const double *g = &results.gradient[3 * i];
+                release = sqrt(g[0]*g[0] + g[1]*g[1] + g[2]*g[2]) > state.gradient;
+            }
+            for (size_t j = 0; !release && j < moved.size(); j++)
+            {
+                release = atom_distance(end, i, end, moved[j]) <= state.shell;
+            }
+            (release ? released : still_frozen).push_back(i);
+        }
+
+        // Always make progress: with nothing triggered, release the next shell around the free region.
+        if (released.empty())
+        {
+            still_frozen.clear();
+            for (int i : state.frozen)
+            {
+                bool near_free = false;
+                for (size_t j = 0; !near_free && j < end.n_atoms; j++)
+                {
+                    near_free = (frozen.count(j) == 0 && atom_distance(end, i, end, j) <= state.shell);
+                }
+                (near_free ? released : still_frozen).push_back(i);
+            }
+            if (released.empty())
+            {
+                released = still_frozen;
+                still_frozen.clear();
+            }
+        }
+        normal_log("Adaptive Restraints cycle " + std::to_string(state.cycle) + ": released " + std::to_string(released.size()) + " atoms, " + std::to_string(still_frozen.size()) + " remain frozen.");
+
+        state.frozen = still_frozen;
+        state.cycle++;
+        state.keywords["coordinates"] = next_xyz.str();
+        if (!Write_Adaptive_Cycle_Input(state))
+        {
+            error_log("Unable to open " + TC_FILENAME + " for writing.  Check permissions", 1);
+        }
+        WriteAdaptiveState(state, ADAPTIVE_STATE_FILE);
+    }
+}
@@ -0,0 +1,637 @@
+#include "amber.h"
+#include "resultcache.h"
+#include <chrono>
+#include <deque>
+#include <unistd.h>
+
+std::string QM_REGION = "";
+double QM_CUTOFF = 0.0;
+double MM_CUTOFF = 0.0;
+std::vector<int> MM_FROZEN_ATOMS = {};
+
+void check_qm_region_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("qm_region") > 0)
+    {
+        if (flags["qm_region"].empty())
+        {
+            PrintUsage();
+            error_log("The --qm_region flag requires a selection, e.g. --qm_region LIG", 1);
+        }
+        for (std::string part : flags["qm_region"])
+        {
+            QM_REGION += (QM_REGION.empty() ? "" : ",") + part;
+        }
+        flags.erase("qm_region");
+    }
+    for (std::string key : {"qm_cutoff", "mm_cutoff"})
+    {
+        if (flags.count(key) > 0)
+        {
+            if (!flags[key].empty())
+            {
+                (key == "qm_cutoff" ? QM_CUTOFF : MM_CUTOFF) = std::max(0.0, std::stod(flags[key][0]));
+            }
+            flags.erase(key);
+        }
+    }
+}
+
+// prmtop sections are fixed-width fields, e.g. %FORMAT(10I8), wrapped at the end of each line.
+struct PrmtopSection
+{
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    size_t width = 0;
+};
+
+std::map<std::string,PrmtopSection> index_prmtop_sections(const MappedFile &mapped)
+{
+    std::map<std::string,PrmtopSection> sections = {};
+    const char *p = mapped.data;
+    const char *file_end = mapped.data + mapped.size;
+    std::string current = "";
+    while (p < file_end)
+    {
+        const char *eol = (const char*)memchr(p, '\n', file_end - p);
+        const char *next = eol ? eol + 1 : file_end;
+        if (*p == '%')
+        {
+            if (!current.empty())
+            {
+                sections[current].end = p;
+            }
+            std::string line(p, (eol ? eol : file_end) - p);
+            if (line.rfind("%FLAG", 0) == 0)
+            {
+                std::stringstream buffer(line.substr(5));
+                buffer >> current;
+            }
+            else if (line.rfind("%FORMAT(", 0) == 0 && !current.empty())
+            {
+                // e.g. "10I8", "20a4", "5E16.8": the field width follows the type letter.
+                size_t letter = line.find_first_of("aAIiEeFf", 8);
+                sections[current].width = (letter == std::string::npos) ? 0 : atoi(line.c_str() + letter + 1);
+                sections[current].begin = next;
+                sections[current].end = next;
+            }
+            else if (line.rfind("%COMMENT", 0) != 0)
+            {
+                current = "";
+            }
+        }
+        p = next;
+    }
+    if (!current.empty())
+    {
+        sections[current].end = file_end;
+    }
+    return sections;
+}
+
+template <typename Visitor>
+size_t for_each_field(const PrmtopSection &section, Visitor visit)
+{
+    // Calls visit(field, length) for each field in order; returns the number of fields.
+    size_t n = 0;
+    if (section.begin == nullptr || section.width == 0)
+    {
+        return 0;
+    }
+    const char *p = section.begin;
+    while (p < section.end)
+    {
+        const char *eol = (const char*)memchr(p, '\n', section.end - p);
+        const char *line_end = eol ? eol : section.end;
+        if (line_end > p && line_end[-1] == '\r')
+        {
+            line_end--;
+        }
+        for (; p + section.width <= line_end; p += section.width)
+        {
+            visit(p, section.width);
+            n++;
+        }
+        p = eol ? eol + 1 : section.end;
+    }
+    return n;
+}
+
+long parse_fixed_int(const char *p, size_t length)
+{
+    const char *end = p + length;
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    bool negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+    long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        value = value * 10 + (*p - '0');
+    }
+    return negative ? -value : value;
+}
+
+double parse_fixed_double(const char *p, size_t length)
+{
+    // F12.7 and E16.8 fields, parsed by hand; strtod is several times slower on a million atoms.
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16};
+    const char *end = p + length;
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    const char *start = p;
+    bool negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, scale = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+    {
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++, scale--)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+    if (p < end && (*p == 'E' || *p == 'e' || *p == 'D' || *p == 'd'))
+    {
+        scale += (int)parse_fixed_int(p + 1, end - p - 1);
+    }
+    if (digits > 18)
+    {
+        std::string field(start, end);
+        return strtod(field.c_str(), nullptr);
+    }
+    double value = (double)mantissa;
+    value = (scale >= 0) ? value * (scale <= 16 ? powers[scale] : pow(10.0, scale)) : value / (-scale <= 16 ? powers[-scale] : pow(10.0, -scale));
+    return negative ? -value : value;
+}
+
+std::string parse_fixed_string(const char *p, size_t length)
+{
+    while (length > 0 && p[length-1] == ' ')
+    {
+        length--;
+    }
+    while (length > 0 && *p == ' ')
+    {
+        p++;
+        length--;
+    }
+    return std::string(p, length);
+}
+
+int guess_atomic_number(std::string name, std::string residue, size_t residue_atoms)
+{
+    // Without an ATOMIC_NUMBER section: the usual Amber naming, first letter for most.
+    // Two-letter element names are only read as ions in single-atom or ion residues, so CA stays an alpha carbon.
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    std::transform(residue.begin(), residue.end(), residue.begin(), ::toupper);
+    static const std::map<std::string,int> ions = {{"NA", 11}, {"MG", 12}, {"CL", 17}, {"CA", 20}, {"ZN", 30}, {"FE", 26}, {"BR", 35}};
+    bool ion_residue = (residue_atoms == 1 || ions.count(residue.substr(0, residue.find_first_of("+-0123456789"))) > 0);
+    if (ion_residue && ions.count(name.substr(0, 2)) > 0 && (name.size() == 2 || !isalpha(name[2])))
+    {
+        return ions.at(name.substr(0, 2));
+    }
+    static const std::map<char,int> first = {{'H', 1}, {'C', 6}, {'N', 7}, {'O', 8}, {'F', 9}, {'P', 15}, {'S', 16}};
+    return name.empty() || first.count(name[0]) == 0 ? 0 : first.at(name[0]);
+}
+
+bool ReadAmberTopology(AmberTopology &topology, std::string filename)
+{
+    MappedFile mapped;
+    if (!map_file(mapped, filename) || mapped.size == 0)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    std::map<std::string,PrmtopSection> sections = index_prmtop_sections(mapped);
+
+    // POINTERS: NATOM is the first entry, NRES the twelfth.
+    std::vector<long> pointers = {};
+    for_each_field(sections["POINTERS"], [&](const char *p, size_t n) { pointers.push_back(parse_fixed_int(p, n)); });
+    if (pointers.size() < 12 || pointers[0] <= 0)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    topology = AmberTopology();
+    topology.n_atoms = pointers[0];
+    topology.n_residues = pointers[11];
+
+    topology.atom_names.reserve(topology.n_atoms);
+    for_each_field(sections["ATOM_NAME"], [&](const char *p, size_t n) { topology.atom_names.push_back(parse_fixed_string(p, n)); });
+    topology.residue_labels.reserve(topology.n_residues);
+    for_each_field(sections["RESIDUE_LABEL"], [&](const char *p, size_t n) { topology.residue_labels.push_back(parse_fixed_string(p, n)); });
+    topology.residue_first.reserve(topology.n_residues + 1);
+    for_each_field(sections["RESIDUE_POINTER"], [&](const char *p, size_t n) { topology.residue_first.push_back(parse_fixed_int(p, n) - 1); });
+    topology.residue_first.push_back(topology.n_atoms);
+    topology.charges.reserve(topology.n_atoms);
+    for_each_field(sections["CHARGE"], [&](const char *p, size_t n) { topology.charges.push_back(parse_fixed_double(p, n) / 18.2223); });
+    topology.atomic_numbers.reserve(topology.n_atoms);
+    for_each_field(sections["ATOMIC_NUMBER"], [&](const char *p, size_t n) { topology.atomic_numbers.push_back(parse_fixed_int(p, n)); });
+    if (topology.atom_names.size() != topology.n_atoms || topology.residue_labels.size() != topology.n_residues || topology.residue_first.size() != topology.n_residues + 1)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    if (topology.atomic_numbers.size() != topology.n_atoms)
+    {
+        topology.atomic_numbers.assign(topology.n_atoms, 0);
+        for (size_t r = 0; r < topology.n_residues; r++)
+        {
+            size_t first = topology.residue_first[r], last = std::min(topology.residue_first[r+1], topology.n_atoms);
+            for (size_t a = first; a < last; a++)
+            {
+                topology.atomic_numbers[a] = guess_atomic_number(topology.atom_names[a], topology.residue_labels[r], last - first);
+            }
+        }
+    }
+    topology.charges.resize(topology.n_atoms, 0.0);
+
+    // Bonds are (3*i, 3*j, type) triplets; gathered into a compressed neighbor list.
+    std::vector<int> pairs = {};
+    for (std::string flag : {"BONDS_INC_HYDROGEN", "BONDS_WITHOUT_HYDROGEN"})
+    {
+        size_t k = 0;
+        for_each_field(sections[flag], [&](const char *p, size_t n)
+        {
+            if (k++ % 3 != 2)
+            {
+                pairs.push_back((int)(parse_fixed_int(p, n) / 3));
+            }
+        });
+        if (pairs.size() % 2 != 0)
+        {
+            pairs.pop_back();
+        }
+    }
+    unmap_file(mapped);
+    topology.bond_first.assign(topology.n_atoms + 1, 0);
+    for (int a : pairs)
+    {
+        if (a >= 0 && (size_t)a < topology.n_atoms)
+        {
+            topology.bond_first[a + 1]++;
+        }
+    }
+    for (size_t a = 0; a < topology.n_atoms; a++)
+    {
+        topology.bond_first[a + 1] += topology.bond_first[a];
+    }
+    topology.bond_atoms.assign(topology.bond_first.back(), -1);
+    std::vector<size_t> fill(topology.bond_first.begin(), topology.bond_first.end() - 1);
+    for (size_t k = 0; k + 1 < pairs.size(); k += 2)
+    {
+        int a = pairs[k], b = pairs[k + 1];
+        if (a < 0 || b < 0 || (size_t)a >= topology.n_atoms || (size_t)b >= topology.n_atoms)
+        {
+            continue;
+        }
+        topology.bond_atoms[fill[a]++] = b;
+        topology.bond_atoms[fill[b]++] = a;
+    }
+    return true;
+}
+
+bool ReadAmberCoordinates(XYZFrames &coordinates, std::string filename, size_t n_atoms)
+{
+    // ASCII rst7/inpcrd: title, "NATOM [time]", then 6F12.7 coordinates; velocities and box follow and are ignored.
+    MappedFile mapped;
+    if (!map_file(mapped, filename) || mapped.size < 3)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    if (memcmp(mapped.data, "CDF", 3) == 0)
+    {
+        unmap_file(mapped);
+        normal_log(filename + " is a NetCDF restart; convert it to ASCII rst7 first (e.g. cpptraj 'trajout file.rst7 restart').");
+        return false;
+    }
+    const char *end = mapped.data + mapped.size;
+    const char *title_end = (const char*)memchr(mapped.data, '\n', mapped.size);
+    const char *count_end = title_end ? (const char*)memchr(title_end + 1, '\n', end - title_end - 1) : nullptr;
+    if (count_end == nullptr || (size_t)atol(std::string(title_end + 1, count_end).c_str()) != n_atoms)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    coordinates = XYZFrames();
+    coordinates.n_atoms = n_atoms;
+    coordinates.frame_ids = {0};
+    coordinates.comments = {parse_fixed_string(mapped.data, title_end - mapped.data)};
+    coordinates.x.resize(n_atoms);
+    coordinates.y.resize(n_atoms);
+    coordinates.z.resize(n_atoms);
+    PrmtopSection values;
+    values.begin = count_end + 1;
+    values.end = end;
+    values.width = 12;
+    size_t k = 0;
+    for_each_field(values, [&](const char *p, size_t n)
+    {
+        if (k < 3 * n_atoms)
+        {
+            std::vector<double> &axis = (k % 3 == 0) ? coordinates.x : ((k % 3 == 1) ? coordinates.y : coordinates.z);
+            axis[k / 3] = parse_fixed_double(p, n);
+        }
+        k++;
+    });
+    unmap_file(mapped);
+    return k >= 3 * n_atoms;
+}
+
+CellList BuildCellList(const XYZFrames &coordinates, double cell_size)
+{
+    CellList cells;
+    size_t n = coordinates.n_atoms;
+    double low[3] = {0.0, 0.0, 0.0}, high[3] = {0.0, 0.0, 0.0};
+    const std::vector<double> *axes[3] = {&coordinates.x, &coordinates.y, &coordinates.z};
+    for (int d = 0; d < 3 && n > 0; d++)
+    {
+        auto range = std::minmax_element(axes[d]->begin(), axes[d]->begin() + n);
+        low[d] = *range.first;
+        high[d] = *range.second;
+    }
+    // Keep the grid to a few cells per atom, whatever the cutoff.
+    cells.cell_size = std::max(cell_size, 0.5);
+    while (true)
+    {
+        size_t total = 1;
+        for (int d = 0; d < 3; d++)
+        {
+            cells.dims[d] = (size_t)((high[d] - low[d]) / cells.cell_size) + 1;
+            total *= cells.dims[d];
+        }
+        if (total <= 4 * n + 8)
+        {
+            break;
+        }
+        cells.cell_size *= 1.25;
+    }
+    for (int d = 0; d < 3; d++)
+    {
+        cells.origin[d] = low[d];
+    }
+
+    // Counting sort of atoms into cells.
+    std::vector<size_t> cell_of(n);
+    cells.cell_first.assign(cells.dims[0] * cells.dims[1] * cells.dims[2] + 1, 0);
+    for (size_t a = 0; a < n; a++)
+    {
+        size_t ix = (size_t)((coordinates.x[a] - low[0]) / cells.cell_size);
+        size_t iy = (size_t)((coordinates.y[a] - low[1]) / cells.cell_size);
+        size_t iz = (size_t)((coordinates.z[a] - low[2]) / cells.cell_size);
+        cell_of[a] = (ix * cells.dims[1] + iy) * cells.dims[2] + iz;
+        cells.cell_first[cell_of[a] + 1]++;
+    }
+    for (size_t c = 0; c + 1 < cells.cell_first.size(); c++)
+    {
+        cells.cell_first[c + 1] += cells.cell_first[c];
+    }
+    cells.atoms.resize(n);
+    std::vector<size_t> fill(cells.cell_first.begin(), cells.cell_first.end() - 1);
+    for (size_t a = 0; a < n; a++)
+    {
+        cells.atoms[fill[cell_of[a]]++] = (int)a;
+    }
+    return cells;
+}
+
+std::vector<bool> AtomsWithinCutoff(const CellList &cells, const XYZFrames &coordinates, const std::vector<bool> &selected, double cutoff)
+{
+    // Selected atoms plus every atom within cutoff of one of them; only the cells around each selected atom are searched.
+    std::vector<bool> within = selected;
+    within.resize(coordinates.n_atoms, false);
+    double cutoff2 = cutoff * cutoff;
+    long reach = (long)ceil(cutoff / cells.cell_size);
+    for (size_t s = 0; s < selected.size() && s < coordinates.n_atoms; s++)
+    {
+        if (!selected[s])
+        {
+            continue;
+        }
+        long center[3] = {(long)((coordinates.x[s] - cells.origin[0]) / cells.cell_size),
+                          (long)((coordinates.y[s] - cells.origin[1]) / cells.cell_size),
+                          (long)((coordinates.z[s] - cells.origin[2]) / cells.cell_size)};
+        long first[3], last[3];
+        for (int d = 0; d < 3; d++)
+        {
+            first[d] = std::max(0L, center[d] - reach);
+            last[d] = std::min((long)cells.dims[d] - 1, center[d] + reach);
+        }
+        for (long ix = first[0]; ix <= last[0]; ix++)
+        {
+            for (long iy = first[1]; iy <= last[1]; iy++)
+            {
+                for (long iz = first[2]; iz <= last[2]; iz++)
+                {
+                    size_t c = (ix * cells.dims[1] + iy) * cells.dims[2] + iz;
+                    for (size_t k = cells.cell_first[c]; k < cells.cell_first[c + 1]; k++)
+                    {
+                        int a = cells.atoms[k];
+                        if (within[a])
+                        {
+                            continue;
+                        }
+                        double dx = coordinates.x[a] - coordinates.x[s];
+                        double dy = coordinates.y[a] - coordinates.y[s];
+                        double dz = coordinates.z[a] - coordinates.z[s];
+                        if (dx*dx + dy*dy + dz*dz <= cutoff2)
+                        {
+                            within[a] = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return within;
+}
+
+std::vector<bool> SelectAmberAtoms(const AmberTopology &topology, std::string selection)
+{
+    std::vector<bool> selected(topology.n_atoms, false);
+    for (std::string token : split_string(selection, ","))
+    {
+        token = parse_fixed_string(token.c_str(), token.size());
+        if (token.empty())
+        {
+            continue;
+        }
+        bool atoms = (token[0] == '@');
+        std::string range = atoms ? token.substr(1) : token;
+        if (!range.empty() && isdigit(range[0]))
+        {
+            size_t dash = range.find('-');
+            size_t first = std::stoul(range.substr(0, dash));
+            size_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (size_t i = std::max<size_t>(first, 1); i <= last; i++)
+            {
+                if (atoms && i <= topology.n_atoms)
+                {
+                    selected[i - 1] = true;
+                }
+                else if (!atoms && i <= topology.n_residues)
+                {
+                    std::fill(selected.begin() + topology.residue_first[i - 1], selected.begin() + topology.residue_first[i], true);
+                }
+            }
+            continue;
+        }
+        std::string label = token;
+        std::transform(label.begin(), label.end(), label.begin(), ::toupper);
+        for (size_t r = 0; r < topology.n_residues; r++)
+        {
+            std::string name = topology.residue_labels[r];
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            if (name == label)
+            {
+                std::fill(selected.begin() + topology.residue_first[r], selected.begin() + topology.residue_first[r + 1], true);
+            }
+        }
+    }
+    return selected;
+}
+
+void ExtendToBondBoundaries(const AmberTopology &topology, std::vector<bool> &qm)
+{
+    // Link atoms only go on C-C bonds; any other bond leaving the region pulls its MM atom in.
+    std::deque<int> pending = {};
+    for (size_t a = 0; a < qm.size(); a++)
+    {
+        if (qm[a])
+        {
+            pending.push_back((int)a);
+        }
+    }
+    while (!pending.empty())
+    {
+        int a = pending.front();
+        pending.pop_front();
+        for (size_t k = topology.bond_first[a]; k < topology.bond_first[a + 1]; k++)
+        {
+            int b = topology.bond_atoms[k];
+            if (b < 0 || qm[b] || (topology.atomic_numbers[a] == 6 && topology.atomic_numbers[b] == 6))
+            {
+                continue;
+            }
+            qm[b] = true;
+            pending.push_back(b);
+        }
+    }
+}
+
+void SelectQMRegion(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords)
+{
+    if (QM_REGION.empty())
+    {
+        return;
+    }
+    if (keywords.count("prmtop") == 0 || keywords.count("coordinates") == 0)
+    {
+        error_log("--qm_region needs both --prmtop and --coordinates.", 1);
+    }
+    auto start = std::chrono::steady_clock::now();
+    AmberTopology topology;
+    if (!ReadAmberTopology(topology, keywords["prmtop"]))
+    {
+        error_log("Unable to read Amber topology " + keywords["prmtop"], 1);
+    }
+    XYZFrames coordinates;
+    bool read = (fs::path(keywords["coordinates"]).extension() == ".xyz") ? ((coordinates = ReadLastFrame(keywords["coordinates"])).n_atoms == topology.n_atoms)
+                                                                             : ReadAmberCoordinates(coordinates, keywords["coordinates"], topology.n_atoms);
+    if (!read)
+    {
+        error_log("Unable to read " + std::to_string(topology.n_atoms) + " atoms from " + keywords["coordinates"], 1);
+    }
+
+    std::vector<bool> qm = SelectAmberAtoms(topology, QM_REGION);
+    if (std::find(qm.begin(), qm.end(), true) == qm.end())
+    {
+        error_log("The selection '" + QM_REGION + "' matches no atoms in " + keywords["prmtop"], 1);
+    }
+    // One grid serves both cutoffs; the larger one just searches more cells around each atom.
+    CellList cells;
+    if (QM_CUTOFF > 0.0 || MM_CUTOFF > 0.0)
+    {
+        cells = BuildCellList(coordinates, (QM_CUTOFF > 0.0 && MM_CUTOFF > 0.0) ? std::min(QM_CUTOFF, MM_CUTOFF) : std::max(QM_CUTOFF, MM_CUTOFF));
+    }
+    if (QM_CUTOFF > 0.0)
+    {
+        // Whole residues join the region when any of their atoms is close enough.
+        std::vector<bool> near = AtomsWithinCutoff(cells, coordinates, qm, QM_CUTOFF);
+        for (size_t r = 0; r < topology.n_residues; r++)
+        {
+            if (std::find(near.begin() + topology.residue_first[r], near.begin() + topology.residue_first[r + 1], true) != near.begin() + topology.residue_first[r + 1])
+            {
+                std::fill(qm.begin() + topology.residue_first[r], qm.begin() + topology.residue_first[r + 1], true);
+            }
+        }
+    }
+    ExtendToBondBoundaries(topology, qm);
+
+    std::vector<int> indices = {};
+    double charge = 0.0;
+    for (size_t a = 0; a < topology.n_atoms; a++)
+    {
+        if (qm[a])
+        {
+            indices.push_back((int)a);
+            charge += topology.charges[a];
+        }
+    }
+    MM_FROZEN_ATOMS.clear();
+    if (MM_CUTOFF > 0.0)
+    {
+        std::vector<bool> mobile = AtomsWithinCutoff(cells, coordinates, qm, MM_CUTOFF);
+        for (size_t a = 0; a < topology.n_atoms; a++)
+        {
+            if (!mobile[a])
+            {
+                MM_FROZEN_ATOMS.push_back((int)a);
+            }
+        }
+    }
+
+    // The index file lives in the cache until the job directory takes a copy of it.
+    std::stringstream buffer;
+    buffer.str("");
+    for (int a : indices)
+    {
+        buffer << a << "\n";
+    }
+    std::string selection_dir = autoquantum_cache_directory() + "selections/" + content_hash(fs::absolute(keywords["prmtop"]).string() + "|" + fs::absolute(keywords["coordinates"]).string() + "|" + buffer.str()) + "/";
+    std::error_code ec;
+    fs::create_directories(selection_dir, ec);
+    std::string partial = selection_dir + "qmindices.txt." + std::to_string(getpid());
+    write_to_file(partial, buffer.str());
+    fs::rename(partial, selection_dir + "qmindices.txt", ec);
+    if (ec)
+    {
+        error_log("Unable to write " + selection_dir + "qmindices.txt: " + ec.message(), 1);
+    }
+    keywords["qmindices"] = selection_dir + "qmindices.txt";
+    if (flags.count("charge") == 0)
+    {
+        keywords["charge"] = std::to_string((long)std::lround(charge));
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    normal_log("QM region '" + QM_REGION + "': " + std::to_string(indices.size()) + " of " + std::to_string(topology.n_atoms) + " atoms, QM region charge " + std::to_string(charge)
+               + (MM_CUTOFF > 0.0 ? ", " + std::to_string(MM_FROZEN_ATOMS.size()) + " atoms beyond " + std::to_string(MM_CUTOFF) + " A frozen" : ""));
+    debug_log("QM region selected in " + std::to_string(seconds) + " s.");
+}
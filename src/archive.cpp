@@ -0,0 +1,485 @@
+#include "archive.h"
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+std::string ARCHIVE_TARGET = "";
+std::vector<std::string> EXTRACT_REQUEST = {};
+
+void check_archive_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("archive") > 0)
+    {
+        if (flags["archive"].empty())
+        {
+            PrintUsage();
+            error_log("The --archive flag requires a directory.", 1);
+        }
+        ARCHIVE_TARGET = flags["archive"][0];
+        flags.erase("archive");
+    }
+    if (flags.count("extract") > 0)
+    {
+        if (flags["extract"].size() < 2)
+        {
+            PrintUsage();
+            error_log("The --extract flag requires an archive and the name of a file inside it.", 1);
+        }
+        EXTRACT_REQUEST = flags["extract"];
+        flags.erase("extract");
+    }
+}
+
+void RunArchiveMode()
+{
+    if (!ARCHIVE_TARGET.empty())
+    {
+        std::string directory = ARCHIVE_TARGET;
+        while (directory.size() > 1 && directory.back() == '/')
+        {
+            directory.pop_back();
+        }
+        compress_and_delete(directory);
+        if (!fs::exists(directory))
+        {
+            normal_log("Archived " + directory + " to " + directory + ".tar.gz");
+        }
+    }
+    if (!EXTRACT_REQUEST.empty())
+    {
+        std::string output = (EXTRACT_REQUEST.size() > 2) ? EXTRACT_REQUEST[2] : fs::path(EXTRACT_REQUEST[1]).filename().string();
+        if (!ExtractArchivedFile(EXTRACT_REQUEST[0], EXTRACT_REQUEST[1], output))
+        {
+            error_log("Unable to extract " + EXTRACT_REQUEST[1] + " from " + EXTRACT_REQUEST[0], 1);
+        }
+        normal_log("Extracted " + EXTRACT_REQUEST[1] + " to " + output);
+    }
+}
+
+// Tar layout
+void tar_octal(char *field, size_t width, uint64_t value)
+{
+    // Octal with a trailing NUL; sizes too large for that switch to GNU base-256.
+    if (width == 12 && value > 077777777777ull)
+    {
+        memset(field, 0, width);
+        field[0] = (char)0x80;
+        for (size_t i = width - 1; i > 0 && value > 0; i--)
+        {
+            field[i] = (char)(value & 0xff);
+            value >>= 8;
+        }
+        return;
+    }
+    snprintf(field, width, "%0*llo", (int)width - 1, (unsigned long long)value);
+}
+
+std::string tar_header_block(std::string name, char type, uint64_t size, long long mtime, unsigned int mode, std::string linkname = "")
+{
+    std::string block(512, '\0');
+    char *h = &block[0];
+    memcpy(h, name.data(), std::min<size_t>(name.size(), 100));
+    memcpy(h + 157, linkname.data(), std::min<size_t>(linkname.size(), 100));
+    tar_octal(h + 100, 8, mode & 07777);
+    tar_octal(h + 108, 8, 0);
+    tar_octal(h + 116, 8, 0);
+    tar_octal(h + 124, 12, size);
+    tar_octal(h + 136, 12, mtime > 0 ? mtime : 0);
+    h[156] = type;
+    memcpy(h + 257, "ustar", 6);
+    memcpy(h + 263, "00", 2);
+    memset(h + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (int i = 0; i < 512; i++)
+    {
+        checksum += (unsigned char)h[i];
+    }
+    snprintf(h + 148, 8, "%06o", checksum);
+    h[155] = ' ';
+    return block;
+}
+
+std::string tar_long_name(std::string name, char type)
+{
+    std::string long_name = name + '\0';
+    std::string header = tar_header_block("././@LongLink", type, long_name.size(), 0, 0644);
+    long_name.resize((long_name.size() + 511) / 512 * 512, '\0');
+    return header + long_name;
+}
+
+std::string tar_header(std::string name, char type, uint64_t size, long long mtime, unsigned int mode, std::string linkname = "")
+{
+    // Names and link targets over 100 characters are carried in preceding GNU long-name entries.
+    std::string header = "";
+    if (linkname.size() > 100)
+    {
+        header += tar_long_name(linkname, 'K');
+    }
+    if (name.size() > 100)
+    {
+        header += tar_long_name(name, 'L');
+    }
+    header += tar_header_block(name.substr(0, 100), type, size, mtime, mode, linkname.substr(0, 100));
+    return header;
+}
+
+void layout_archive(ArchiveIndex &index, std::string directory)
+{
+    // Same member names as 'tar -czf dir.tar.gz dir/': paths relative to the parent of dir.
+    fs::path root(directory);
+    fs::path base = root.parent_path();
+    std::vector<fs::path> paths = {root};
+    for (auto &item : fs::recursive_directory_iterator(root))
+    {
+        paths.push_back(item.path());
+    }
+    std::sort(paths.begin() + 1, paths.end());
+
+    uint64_t offset = 0;
+    for (fs::path &p : paths)
+    {
+        struct stat info;
+        if (lstat(p.c_str(), &info) != 0)
+        {
+            index.skipped.push_back(p.string());
+            continue;
+        }
+        ArchiveEntry entry;
+        std::string linkname = "";
+        entry.path = p.string();
+        entry.name = base.empty() ? p.string() : p.string().substr(base.string().size() + 1);
+        if (S_ISDIR(info.st_mode))
+        {
+            entry.type = '5';
+            entry.name += "/";
+        }
+        else if (S_ISREG(info.st_mode))
+        {
+            entry.type = '0';
+            entry.size = info.st_size;
+        }
+        else if (S_ISLNK(info.st_mode))
+        {
+            // Links are stored as links, not followed.
+            std::error_code ec;
+            linkname = fs::read_symlink(p, ec).string();
+            if (ec)
+            {
+                index.skipped.push_back(p.string());
+                continue;
+            }
+            entry.type = '2';
+        }
+        else
+        {
+            // Sockets, FIFOs and devices have no place in a job archive; the caller must not delete them.
+            index.skipped.push_back(p.string());
+            continue;
+        }
+        entry.header = tar_header(entry.name, entry.type, entry.size, info.st_mtime, info.st_mode, linkname);
+        entry.header_offset = offset;
+        entry.data_offset = offset + entry.header.size();
+        entry.end_offset = entry.data_offset + (entry.size + 511) / 512 * 512;
+        offset = entry.end_offset;
+        index.entries.push_back(entry);
+    }
+    // Two zero blocks end the archive.
+    index.total_size = offset + 1024;
+}
+
+bool fill_tar_chunk(const ArchiveIndex &index, uint64_t begin, std::string &buffer)
+{
+    // Build one slice of the virtual tar stream straight from the headers and member files.
+    uint64_t end = begin + buffer.size();
+    size_t lo = 0, hi = index.entries.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (index.entries[mid].end_offset <= begin) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t i = lo; i < index.entries.size() && index.entries[i].header_offset < end; i++)
+    {
+        const ArchiveEntry &entry = index.entries[i];
+        uint64_t a = std::max(begin, entry.header_offset);
+        uint64_t b = std::min(end, entry.data_offset);
+        if (a < b)
+        {
+            memcpy(&buffer[a - begin], entry.header.data() + (a - entry.header_offset), b - a);
+        }
+        a = std::max(begin, entry.data_offset);
+        b = std::min(end, entry.data_offset + entry.size);
+        if (a < b)
+        {
+            int fd = open(entry.path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+            uint64_t done = 0;
+            while (done < b - a)
+            {
+                ssize_t n = pread(fd, &buffer[a - begin + done], b - a - done, a - entry.data_offset + done);
+                if (n <= 0)
+                {
+                    close(fd);
+                    return false;
+                }
+                done += n;
+            }
+            close(fd);
+        }
+    }
+    return true;
+}
+
+bool gzip_chunk(const std::string &input, std::string &output)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, ARCHIVE_COMPRESSION_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    output.resize(deflateBound(&stream, input.size()));
+    stream.next_in = (Bytef*)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = output.size();
+    int status = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+bool gunzip_chunk(const std::string &input, std::string &output)
+{
+    // output must already be sized to the expected uncompressed length.
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+    {
+        return false;
+    }
+    stream.next_in = (Bytef*)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = output.size();
+    int status = inflate(&stream, Z_FINISH);
+    bool ok = (status == Z_STREAM_END && stream.total_out == output.size() && stream.avail_in == 0);
+    inflateEnd(&stream);
+    return ok;
+}
+
+bool write_archive_index(const ArchiveIndex &index, std::string filename)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "AQARCHIVE 1 " << index.chunk_size << " " << index.total_size << std::endl;
+    for (const ArchiveChunk &chunk : index.chunks)
+    {
+        buffer << "chunk " << chunk.offset << " " << chunk.length << " " << chunk.compressed_offset << " " << chunk.compressed_size << " " << chunk.crc << std::endl;
+    }
+    for (const ArchiveEntry &entry : index.entries)
+    {
+        buffer << "file " << entry.type << " " << entry.data_offset << " " << entry.size << " " << entry.name << std::endl;
+    }
+    std::ofstream out(filename, std::ios::out | std::ios::trunc);
+    out << buffer.str();
+    out.close();
+    return !out.fail();
+}
+
+bool ReadArchiveIndex(ArchiveIndex &index, std::string filename)
+{
+    std::ifstream fin(filename);
+    std::string tag;
+    int version = 0;
+    if (!(fin >> tag >> version >> index.chunk_size >> index.total_size) || tag != "AQARCHIVE" || version != 1)
+    {
+        return false;
+    }
+    while (fin >> tag)
+    {
+        if (tag == "chunk")
+        {
+            ArchiveChunk chunk;
+            fin >> chunk.offset >> chunk.length >> chunk.compressed_offset >> chunk.compressed_size >> chunk.crc;
+            index.chunks.push_back(chunk);
+        }
+        else if (tag == "file")
+        {
+            ArchiveEntry entry;
+            fin >> entry.type >> entry.data_offset >> entry.size;
+            std::getline(fin, entry.name);
+            entry.name.erase(0, 1);
+            index.entries.push_back(entry);
+        }
+    }
+    return !index.chunks.empty();
+}
+
+bool ArchiveDirectory(std::string directory, std::string archive, unsigned int n_threads)
+{
+    ArchiveIndex index;
+    index.chunk_size = ARCHIVE_CHUNK_SIZE;
+    layout_archive(index, directory);
+    for (std::string &path : index.skipped)
+    {
+        normal_log("Unable to archive " + path);
+    }
+    size_t n_chunks = (index.total_size + index.chunk_size - 1) / index.chunk_size;
+    index.chunks.resize(n_chunks);
+
+    std::ofstream out(archive, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        return false;
+    }
+
+    // Compress a window of chunks in parallel, then append them in order.
+    size_t window = std::max<size_t>(n_threads, 1) * 4;
+    uint64_t compressed_offset = 0;
+    bool ok = true;
+    for (size_t first = 0; ok && first < n_chunks; first += window)
+    {
+        size_t count = std::min(window, n_chunks - first);
+        std::vector<std::string> compressed(count);
+        std::vector<char> failed(count, 0);
+        parallel_for(count, n_threads, [&](size_t k)
+        {
+            ArchiveChunk &chunk = index.chunks[first + k];
+            chunk.offset = (first + k) * index.chunk_size;
+            chunk.length = std::min<uint64_t>(index.chunk_size, index.total_size - chunk.offset);
+            std::string raw(chunk.length, '\0');
+            if (!fill_tar_chunk(index, chunk.offset, raw) || !gzip_chunk(raw, compressed[k]))
+            {
+                failed[k] = 1;
+                return;
+            }
+            chunk.crc = crc32(0L, (const Bytef*)raw.data(), raw.size());
+        });
+        for (size_t k = 0; k < count; k++)
+        {
+            if (failed[k])
+            {
+                ok = false;
+                break;
+            }
+            ArchiveChunk &chunk = index.chunks[first + k];
+            chunk.compressed_offset = compressed_offset;
+            chunk.compressed_size = compressed[k].size();
+            out.write(compressed[k].data(), compressed[k].size());
+            compressed_offset += compressed[k].size();
+        }
+    }
+    out.close();
+    ok = ok && !out.fail();
+    if (!ok)
+    {
+        return false;
+    }
+    // An archive missing any entry is written but reported as incomplete, so the directory is kept.
+    return write_archive_index(index, archive + ".idx") && index.skipped.empty();
+}
+
+bool read_compressed_chunk(int fd, const ArchiveChunk &chunk, std::string &raw)
+{
+    std::string compressed(chunk.compressed_size, '\0');
+    uint64_t done = 0;
+    while (done < chunk.compressed_size)
+    {
+        ssize_t n = pread(fd, &compressed[done], chunk.compressed_size - done, chunk.compressed_offset + done);
+        if (n <= 0)
+        {
+            return false;
+        }
+        done += n;
+    }
+    raw.assign(chunk.length, '\0');
+    return gunzip_chunk(compressed, raw) && crc32(0L, (const Bytef*)raw.data(), raw.size()) == chunk.crc;
+}
+
+bool VerifyArchive(std::string archive, unsigned int n_threads)
+{
+    // Every chunk must inflate to its recorded length and checksum before anything is deleted.
+    ArchiveIndex index;
+    if (!ReadArchiveIndex(index, archive + ".idx"))
+    {
+        return false;
+    }
+    const ArchiveChunk &last = index.chunks.back();
+    if (!fs::exists(archive) || fs::file_size(archive) != last.compressed_offset + last.compressed_size || last.offset + last.length != index.total_size)
+    {
+        return false;
+    }
+    int fd = open(archive.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    std::atomic<bool> ok(true);
+    parallel_for(index.chunks.size(), n_threads, [&](size_t k)
+    {
+        std::string raw;
+        if (ok && !read_compressed_chunk(fd, index.chunks[k], raw))
+        {
+            ok = false;
+        }
+    });
+    close(fd);
+    return ok;
+}
+
+bool ExtractArchivedFile(std::string archive, std::string member, std::string output)
+{
+    ArchiveIndex index;
+    if (!ReadArchiveIndex(index, archive + ".idx"))
+    {
+        return false;
+    }
+    const ArchiveEntry *entry = nullptr;
+    for (const ArchiveEntry &candidate : index.entries)
+    {
+        if (candidate.type == '0' && (candidate.name == member || fs::path(candidate.name).filename() == member))
+        {
+            entry = &candidate;
+            if (candidate.name == member)
+            {
+                break;
+            }
+        }
+    }
+    if (entry == nullptr)
+    {
+        return false;
+    }
+    int fd = open(archive.c_str(), O_RDONLY);
+    std::ofstream out(output, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (fd < 0 || !out.is_open())
+    {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    // Inflate only the chunks that overlap the member's data.
+    bool ok = true;
+    uint64_t begin = entry->data_offset;
+    uint64_t end = entry->data_offset + entry->size;
+    for (size_t k = begin / index.chunk_size; ok && k < index.chunks.size() && index.chunks[k].offset < end; k++)
+    {
+        const ArchiveChunk &chunk = index.chunks[k];
+        std::string raw;
+        ok = read_compressed_chunk(fd, chunk, raw);
+        uint64_t a = std::max(begin, chunk.offset);
+        uint64_t b = std::min(end, chunk.offset + chunk.length);
+        if (ok && a < b)
+        {
+            out.write(raw.data() + (a - chunk.offset), b - a);
+        }
+    }
+    close(fd);
+    out.close();
+    return ok && !out.fail();
+}
@@ -0,0 +1,317 @@
+#include "campaign.h"
+#include "amber.h"
+
+bool CAMPAIGN = false;
+std::string CAMPAIGN_SOURCE = "";
+unsigned int CAMPAIGN_THREADS = 0;
+unsigned int CAMPAIGN_THROTTLE = 0;
+unsigned int CAMPAIGN_PACK = 0;
+
+void check_campaign_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    // Campaign flags are AutoQuantum-only, so they must be removed before the remaining flags become TeraChem keywords.
+    if (flags.count("campaign") > 0)
+    {
+        if (flags["campaign"].empty())
+        {
+            PrintUsage();
+            error_log("The --campaign flag requires a manifest file or a directory of .xyz files.", 1);
+        }
+        CAMPAIGN = true;
+        CAMPAIGN_SOURCE = flags["campaign"][0];
+        flags.erase("campaign");
+    }
+    if (flags.count("campaign_threads") > 0)
+    {
+        if (!flags["campaign_threads"].empty())
+        {
+            CAMPAIGN_THREADS = std::stoi(flags["campaign_threads"][0]);
+        }
+        flags.erase("campaign_threads");
+    }
+    if (flags.count("array_throttle") > 0)
+    {
+        if (!flags["array_throttle"].empty())
+        {
+            CAMPAIGN_THROTTLE = std::stoi(flags["array_throttle"][0]);
+        }
+        flags.erase("array_throttle");
+    }
+    if (flags.count("pack") > 0)
+    {
+        if (!flags["pack"].empty())
+        {
+            CAMPAIGN_PACK = std::stoi(flags["pack"][0]);
+        }
+        flags.erase("pack");
+    }
+    if (CAMPAIGN_THREADS == 0)
+    {
+        CAMPAIGN_THREADS = default_thread_count();
+    }
+}
+
+std::vector<std::string> read_campaign_structures(std::string source)
+{
+    std::vector<std::string> structures = {};
+    if (fs::is_directory(source))
+    {
+        std::set<std::string> sorted = {};
+        for (fs::path p : fs::directory_iterator(source))
+        {
+            if (p.extension() == ".xyz")
+            {
+                sorted.insert(p.string());
+            }
+        }
+        structures.assign(sorted.begin(), sorted.end());
+        return structures;
+    }
+
+    // Manifest: one structure per line, relative to the working directory or to the manifest itself.
+    std::ifstream fin(source);
+    if (!fin.is_open())
+    {
+        error_log("Unable to open campaign manifest " + source, 1);
+    }
+    fs::path manifest_dir = fs::path(source).parent_path();
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (is_empty(line.c_str()) || line[0] == '#')
+        {
+            continue;
+        }
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (!fs::exists(line) && fs::exists(manifest_dir / line))
+        {
+            line = (manifest_dir / line).string();
+        }
+        structures.push_back(line);
+    }
+    fin.close();
+    return structures;
+}
+
+std::vector<std::string> Build_Campaign_Directories(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords, std::vector<std::string> structures, std::string campaign_dir)
+{
+    // Job directories are numbered by array index, so no directory probing is needed.
+    int width = std::max(5, (int)std::to_string(structures.size()).size());
+    std::vector<std::string> job_dirs(structures.size());
+    std::vector<std::string> failures(structures.size());
+    std::vector<std::string> cached(structures.size());
+    std::vector<JobResources> resources(structures.size());
+    std::vector<JobFeatures> features(structures.size());
+
+    parallel_for(structures.size(), CAMPAIGN_THREADS, [&](size_t i)
+    {
+        std::map<std::string,std::string> job_keywords = keywords;
+        job_keywords["coordinates"] = structures[i];
+        CacheKey cache_key = ResultCacheKey(job_keywords);
+        cached[i] = LookupCachedResult(cache_key);
+        if (!cached[i].empty())
+        {
+            return;
+        }
+        std::string cached_guess = LookupCachedGuess(cache_key, structures[i]);
+        if (!cached_guess.empty() && job_keywords.count("guess") == 0)
+        {
+            job_keywords["guess"] = cached_guess;
+        }
+        resources[i] = TuneJobKeywords(flags, job_keywords);
+        if (CAMPAIGN_PACK > 0)
+        {
+            // Packed jobs each get a single GPU slice.
+            job_keywords["gpus"] = "1";
+        }
+        features[i] = JobFeaturesFromKeywords(job_keywords);
+
+        std::stringstream name;
+        name << "job." << std::setw(width) << std::setfill('0') << (i+1);
+        fs::path job_dir = fs::path(campaign_dir) / name.str();
+        std::error_code ec;
+        fs::create_directory(job_dir, ec);
+        for (std::string key : {"coordinates", "prmtop", "qmindices"})
+        {
+            if (ec || job_keywords.count(key) == 0)
+            {
+                continue;
+            }
+            fs::path source = job_keywords[key];
+            fs::copy_file(source, job_dir / source.filename(), fs::copy_options::overwrite_existing, ec);
+            job_keywords[key] = source.filename().string();
+        }
+        if (ec)
+        {
+            failures[i] = structures[i] + ": " + ec.message();
+            return;
+        }
+        if (!Write_TC_Input_File(job_keywords, (job_dir / TC_FILENAME).string()))
+        {
+            failures[i] = structures[i] + ": unable to write " + TC_FILENAME;
+            return;
+        }
+        if (!DRYRUN)
+        {
+            RegisterCachedResult(cache_key, job_dir.string(), TC_OUTFILE, job_keywords);
+        }
+        job_dirs[i] = name.str();
+    });
+
+    std::vector<std::string> built = {};
+    std::vector<JobFeatures> built_features = {};
+    std::vector<std::string> built_outputs = {};
+    std::stringstream manifest;
+    manifest.str("");
+    for (size_t i = 0; i < structures.size(); i++)
+    {
+        if (!cached[i].empty())
+        {
+            normal_log("Skipping " + structures[i] + ": already finished in " + cached[i]);
+            continue;
+        }
+        if (!failures[i].empty())
+        {
+            normal_log("Skipping " + failures[i]);
+            continue;
+        }
+        // One array header covers every task, so it asks for the largest of them.
+        JOB_RESOURCES = built.empty() ? resources[i] : CombineJobResources(JOB_RESOURCES, resources[i], false);
+        built.push_back(job_dirs[i]);
+        built_features.push_back(features[i]);
+        built_outputs.push_back((fs::path(campaign_dir) / job_dirs[i] / TC_OUTFILE).string());
+        manifest << job_dirs[i] << std::endl;
+    }
+    if (!DRYRUN)
+    {
+        RecordPendingTimings(built_features, built_outputs);
+    }
+    write_to_file(campaign_dir + "AutoQuantum_Campaign_Jobs.lst", manifest.str());
+    return built;
+}
+
+void SubmitSlurmArrayJob(std::map<std::string,std::string> &keywords, std::string campaign_dir, size_t n_jobs, std::string after_stage_out)
+{
+    // Large campaigns are split into arrays no bigger than the scheduler's MaxArraySize, one sbatch call per chunk.
+    size_t chunk = DEFAULT_SLURM_MAX_ARRAY_SIZE;
+    for (size_t offset = 0; offset < n_jobs; offset += chunk)
+    {
+        size_t n_tasks = std::min(chunk, n_jobs - offset);
+        std::stringstream array_spec;
+        array_spec.str("");
+        array_spec << "1-" << n_tasks;
+        if (CAMPAIGN_THROTTLE > 0)
+        {
+            array_spec << "%" << CAMPAIGN_THROTTLE;
+        }
+        std::string script_name = "AutoQuantum_TC_Array." + std::to_string(offset / chunk + 1) + ".sh";
+        StagingPlan plan;
+        plan.tc_inputs = {TC_FILENAME};
+        plan.outputs = {TC_OUTFILE, TC_ERRFILE, fs::path(keywords["scrdir"]).string()};
+        plan.after_stage_out = after_stage_out;
+        std::string buffer=SlurmJobHeader("AutoQuantum_TC_" + CALC_TYPE, "slurm_%A_%a.out", "slurm_%A_%a.err") + R"(#SBATCH --array=)" + array_spec.str() + R"(
+
+TASK=$(( SLURM_ARRAY_TASK_ID + )" + std::to_string(offset) + R"( ))
+JOBDIR=$(sed -n "${TASK}p" $SLURM_SUBMIT_DIR/AutoQuantum_Campaign_Jobs.lst)
+cd $SLURM_SUBMIT_DIR/$JOBDIR
+)" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + StagedScriptBody(plan, "terachem -i " + TC_FILENAME + " 1> " + TC_OUTFILE + " 2> " + TC_ERRFILE + "\n");
+        write_to_file(campaign_dir + script_name, buffer);
+        SubmitBatchScript(script_name, campaign_dir);
+        debug_log("Submitted " + script_name + " with array " + array_spec.str());
+    }
+}
+
+void SubmitSlurmPackedJob(std::string campaign_dir, size_t n_jobs, std::string after_stage_out)
+{
+    // Each array task takes CAMPAIGN_PACK jobs and works through them on every GPU slice of its allocation.
+    std::string gpu_name = DEFAULT_SLURM_GPU_JOB_GPUNAME;
+    int n_slots = std::max(1, atoi(gpu_name.substr(gpu_name.rfind(':') + 1).c_str()));
+    size_t n_groups = (n_jobs + CAMPAIGN_PACK - 1) / CAMPAIGN_PACK;
+    int rounds = (CAMPAIGN_PACK + n_slots - 1) / n_slots;
+    JOB_RESOURCES.gres = gpu_name;
+    JOB_RESOURCES.gpus = n_slots;
+    JOB_RESOURCES.cpus = n_slots + 2;
+    JOB_RESOURCES.mem_gb = std::min(DEFAULT_SLURM_MAX_MEMORY_GB, JOB_RESOURCES.mem_gb * n_slots);
+    JOB_RESOURCES.walltime_minutes = std::min(DEFAULT_SLURM_MAX_WALLTIME_MINUTES, JOB_RESOURCES.walltime_minutes * rounds);
+
+    size_t chunk = DEFAULT_SLURM_MAX_ARRAY_SIZE;
+    for (size_t offset = 0; offset < n_groups; offset += chunk)
+    {
+        size_t n_tasks = std::min(chunk, n_groups - offset);
+        std::stringstream array_spec;
+        array_spec.str("");
+        array_spec << "1-" << n_tasks;
+        if (CAMPAIGN_THROTTLE > 0)
+        {
+            array_spec << "%" << CAMPAIGN_THROTTLE;
+        }
+        std::string script_name = "AutoQuantum_TC_Pack." + std::to_string(offset / chunk + 1) + ".sh";
+        // The task's job directories are staged to node scratch together; $JOBDIRS is expanded by the script.
+        StagingPlan plan;
+        plan.inputs = {"AutoQuantum_Campaign_Jobs.lst", "$JOBDIRS"};
+        plan.outputs = {"$JOBDIRS", "AutoQuantum_Pack.$FIRST.report"};
+        plan.after_stage_out = after_stage_out;
+        std::string buffer=SlurmJobHeader("AutoQuantum_TC_PACK", "slurm_%A_%a.out", "slurm_%A_%a.err") + R"(#SBATCH --array=)" + array_spec.str() + R"(
+
+FIRST=$(( (SLURM_ARRAY_TASK_ID + )" + std::to_string(offset) + R"( - 1) * )" + std::to_string(CAMPAIGN_PACK) + R"( + 1 ))
+cd $SLURM_SUBMIT_DIR
+JOBDIRS=$(sed -n "${FIRST},$(( FIRST + )" + std::to_string(CAMPAIGN_PACK - 1) + R"( ))p" AutoQuantum_Campaign_Jobs.lst)
+)" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + StagedScriptBody(plan, AutoQuantumExecutable() + " --pack_worker . $FIRST " + std::to_string(CAMPAIGN_PACK) + (DEBUG ? " --debug" : "") + "\n");
+        write_to_file(campaign_dir + script_name, buffer);
+        SubmitBatchScript(script_name, campaign_dir);
+        debug_log("Submitted " + script_name + " with array " + array_spec.str() + ", " + std::to_string(CAMPAIGN_PACK) + " jobs per allocation");
+    }
+}
+
+void RunCampaign(std::map<std::string,std::vector<std::string>> &flags)
+{
+    std::map<std::string,std::string> keywords = {};
+    Prepare_TC_Keywords(flags, keywords);
+    if (MM_CUTOFF > 0.0)
+    {
+        // The frozen MM atoms depend on each structure's geometry.
+        error_log("--mm_cutoff is not available for campaigns.", 1);
+    }
+
+    std::vector<std::string> structures = read_campaign_structures(CAMPAIGN_SOURCE);
+    if (structures.empty())
+    {
+        error_log("No structures found in campaign source " + CAMPAIGN_SOURCE, 1);
+    }
+    std::string campaign_dir = MakeIterativeDirectoryName("AutoQuantum_Campaign", 4);
+    std::vector<std::string> job_dirs = Build_Campaign_Directories(flags, keywords, structures, campaign_dir);
+    normal_log("Prepared " + std::to_string(job_dirs.size()) + " of " + std::to_string(structures.size()) + " campaign jobs in " + campaign_dir);
+
+    if (DRYRUN || job_dirs.empty())
+    {
+        normal_log("No campaign jobs will be run at this time.");
+        return;
+    }
+
+    if (UseSlurmSubmission())
+    {
+        if (CAMPAIGN_PACK > 0)
+        {
+            SubmitSlurmPackedJob(campaign_dir, job_dirs.size());
+            return;
+        }
+        SubmitSlurmArrayJob(keywords, campaign_dir, job_dirs.size());
+        return;
+    }
+
+    // Without a scheduler, the jobs go through a local queue: the given one, or the campaign's own, drained here.
+    std::vector<std::string> queued = {};
+    for (std::string job_dir : job_dirs)
+    {
+        queued.push_back((fs::path(campaign_dir) / job_dir).string());
+    }
+    std::string queue_dir = LOCAL_QUEUE_DIR.empty() ? fs::absolute(campaign_dir).string() : LOCAL_QUEUE_DIR;
+    EnqueueLocalJobs(queue_dir, queued);
+    if (!LOCAL_QUEUE_DIR.empty())
+    {
+        normal_log("Added " + std::to_string(queued.size()) + " jobs to the queue in " + LOCAL_QUEUE_DIR + "; run 'autoquantum --run_queue " + LOCAL_QUEUE_DIR + "' to work through it.");
+        return;
+    }
+    RunLocalQueue(queue_dir);
+}
@@ -0,0 +1,239 @@
+#include "chain.h"
+#include "logger.h"
+
+std::vector<std::string> CHAIN = {};
+std::string CHAIN_RESUME_DIR = "";
+
+void check_chain_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("chain") > 0)
+    {
+        std::set<std::string> known = {"spe", "opt", "freq", "bomd", "ts"};
+        for (std::string step : flags["chain"])
+        {
+            std::transform(step.begin(), step.end(), step.begin(), ::tolower);
+            if (known.count(step) == 0)
+            {
+                PrintUsage();
+                error_log("Unknown chained calculation type: " + step, 1);
+            }
+            CHAIN.push_back(step);
+        }
+        if (CHAIN.empty())
+        {
+            PrintUsage();
+            error_log("The --chain flag requires a list of calculation types, e.g. --chain opt freq spe", 1);
+        }
+        flags.erase("chain");
+    }
+    if (flags.count("chain_resume") > 0)
+    {
+        CHAIN_RESUME_DIR = flags["chain_resume"].empty() ? "." : flags["chain_resume"][0];
+        flags.erase("chain_resume");
+    }
+}
+
+std::string carry_forward_geometry(const ChainStep &previous)
+{
+    // Optimizations and MD leave their final geometry as the last frame of a trajectory in scrdir.
+    std::string trajectory = "";
+    if (previous.calc_type == "OPT" || previous.calc_type == "TS")
+    {
+        trajectory = previous.scrdir + "optim.xyz";
+    }
+    if (previous.calc_type == "BOMD")
+    {
+        trajectory = previous.scrdir + "coors.xyz";
+    }
+    if (trajectory.empty() || !fs::exists(trajectory))
+    {
+        return "";
+    }
+    XYZFrames frames = ReadLastFrame(trajectory);
+    if (frames.n_atoms == 0)
+    {
+        return "";
+    }
+    std::string geometry = "chain." + previous.calc_type + ".xyz";
+    std::transform(geometry.begin(), geometry.end(), geometry.begin(), ::tolower);
+    write_to_file(geometry, FrameToXYZ(frames, 0));
+    return geometry;
+}
+
+std::string carry_forward_guess(std::string scrdir)
+{
+    // Restricted runs leave c0, unrestricted runs leave ca0/cb0.
+    if (fs::exists(scrdir + "c0"))
+    {
+        return scrdir + "c0";
+    }
+    if (fs::exists(scrdir + "ca0") && fs::exists(scrdir + "cb0"))
+    {
+        return scrdir + "ca0 " + scrdir + "cb0";
+    }
+    return "";
+}
+
+bool ReadChainSteps(std::vector<ChainStep> &steps, std::string filename)
+{
+    std::ifstream fin(filename);
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    ChainStep step;
+    while (fin >> step.calc_type >> step.input >> step.output >> step.error >> step.scrdir)
+    {
+        steps.push_back(step);
+    }
+    fin.close();
+    return !steps.empty();
+}
+
+void RunChain(std::map<std::string,std::vector<std::string>> &flags)
+{
+    // Every step gets its own input and scrdir, so earlier orbitals survive for the next step.
+    std::vector<ChainStep> steps = {};
+    std::vector<std::map<std::string,std::string>> step_keywords = {};
+    std::vector<JobFeatures> step_features = {};
+    JobResources chain_resources;
+    for (std::string calc : CHAIN)
+    {
+        std::map<std::string,std::vector<std::string>> step_flags = flags;
+        std::map<std::string,std::string> keywords = {};
+        step_flags[calc] = {};
+        Prepare_TC_Keywords(step_flags, keywords);
+        chain_resources = step_keywords.empty() ? JOB_RESOURCES : CombineJobResources(chain_resources, JOB_RESOURCES, true);
+        ChainStep step;
+        step.calc_type = CALC_TYPE;
+        step.input = TC_FILENAME;
+        step.output = TC_OUTFILE;
+        step.error = TC_ERRFILE;
+        step.scrdir = "scr." + calc + "/";
+        keywords["scrdir"] = step.scrdir;
+        steps.push_back(step);
+        step_keywords.push_back(keywords);
+        step_features.push_back(JobFeaturesFromKeywords(keywords));
+    }
+    JOB_RESOURCES = chain_resources;
+
+    // Prepare working directory
+    std::string job_dir = MakeIterativeDirectoryName("AutoQuantum", 4);
+    move_to_jobdir(step_keywords[0], job_dir);
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    normal_log("Copied relevant input files to " + job_dir);
+
+    // Refer to the copies in the job directory rather than the originals.
+    for (std::map<std::string,std::string> &keywords : step_keywords)
+    {
+        for (std::string key : {"coordinates", "prmtop", "qmindices"})
+        {
+            if (keywords.count(key) > 0)
+            {
+                keywords[key] = fs::path(keywords[key]).filename().string();
+            }
+        }
+    }
+
+    std::stringstream buffer;
+    buffer.str("");
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        // Later steps are rewritten with the carried-forward geometry and guess once the previous step finishes.
+        if (!Write_TC_Input_File(step_keywords[i], steps[i].input))
+        {
+            error_log("Unable to open " + steps[i].input + " for writing.  Check permissions", 1);
+        }
+        if (!MMFrozenBlock().empty())
+        {
+            append_to_file(steps[i].input, MMFrozenBlock());
+        }
+        if (!DRYRUN)
+        {
+            RecordPendingTiming(step_features[i], steps[i].output);
+        }
+        buffer << steps[i].calc_type << " " << steps[i].input << " " << steps[i].output << " " << steps[i].error << " " << steps[i].scrdir << std::endl;
+    }
+    write_to_file(CHAIN_STEPS_FILE, buffer.str());
+
+    if (DRYRUN)
+    {
+        normal_log("DRYRUN flag was invoked.  Input files have been generated, but TeraChem will not be run at this time.");
+        return;
+    }
+    if (UseSlurmSubmission())
+    {
+        // One allocation for the whole chain, every step running on the same node scratch.
+        StagingPlan plan;
+        plan.inputs = {CHAIN_STEPS_FILE};
+        plan.outputs = {"tc_*.in", "tc_*.out", "tc_*.err", "scr.*", "chain.*.xyz"};
+        for (ChainStep &step : steps)
+        {
+            plan.tc_inputs.push_back(step.input);
+        }
+        std::string body = "\n" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + StagedScriptBody(plan, AutoQuantumExecutable() + " --chain_resume . " + (DEBUG ? "--debug" : "") + "\n");
+        SubmitSlurmScript("AutoQuantum_TC_CHAIN", "slurm_tc_chain.out", "slurm_tc_chain.err", body);
+        return;
+    }
+    RunChainSteps();
+}
+
+void RunChainSteps()
+{
+    std::vector<ChainStep> steps = {};
+    if (!ReadChainSteps(steps, CHAIN_STEPS_FILE))
+    {
+        error_log("Unable to read " + (std::string)CHAIN_STEPS_FILE, 1);
+    }
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        CALC_TYPE = steps[i].calc_type;
+        TC_FILENAME = steps[i].input;
+        TC_OUTFILE = steps[i].output;
+        TC_ERRFILE = steps[i].error;
+
+        // Steps that already finished are skipped, so a resubmitted chain picks up where it stopped.
+        if (fs::exists(TC_OUTFILE) && ParseTCOutput(TC_OUTFILE).finished)
+        {
+            debug_log("Chain step " + TC_FILENAME + " already finished.");
+            continue;
+        }
+        if (i > 0)
+        {
+            std::map<std::string,std::string> keywords = {};
+            Read_TC_Input_File(keywords, TC_FILENAME);
+            std::string geometry = carry_forward_geometry(steps[i-1]);
+            if (geometry.empty())
+            {
+                // Steps that do not move atoms hand on the geometry they started from.
+                std::map<std::string,std::string> previous = {};
+                Read_TC_Input_File(previous, steps[i-1].input);
+                geometry = previous["coordinates"];
+            }
+            std::string guess = carry_forward_guess(steps[i-1].scrdir);
+            if (!geometry.empty())
+            {
+                keywords["coordinates"] = geometry;
+            }
+            if (!guess.empty() && keywords.count("guess") == 0)
+            {
+                keywords["guess"] = guess;
+            }
+            std::string blocks = Read_TC_Input_Blocks(TC_FILENAME);
+            Write_TC_Input_File(keywords, TC_FILENAME);
+            if (!blocks.empty())
+            {
+                append_to_file(TC_FILENAME, blocks);
+            }
+            debug_log("Chain step " + TC_FILENAME + " starts from geometry '" + keywords["coordinates"] + "' and guess '" + guess + "'");
+        }
+        RunTeraChem();
+        TCOutputResults results = ParseTCOutput(TC_OUTFILE);
+        if (!results.finished || !results.errors.empty())
+        {
+            error_log("Chain step " + TC_FILENAME + " did not finish cleanly, see " + TC_OUTFILE, 1);
+        }
+        normal_log("Chain step " + TC_FILENAME + " finished.");
+    }
+}
@@ -0,0 +1,270 @@
+#include "executor.h"
+#include <chrono>
+
+std::string PACK_WORKER_DIR = "";
+size_t PACK_WORKER_FIRST = 1;
+size_t PACK_WORKER_COUNT = 0;
+
+std::vector<std::string> VisibleGPUDevices()
+{
+    // SLURM sets CUDA_VISIBLE_DEVICES to the GPUs or MIG instances of the allocation.
+    std::vector<std::string> devices = {};
+    const char *visible = getenv("CUDA_VISIBLE_DEVICES");
+    if (visible == nullptr)
+    {
+        return devices;
+    }
+    for (std::string device : split_string(visible, ","))
+    {
+        if (!device.empty())
+        {
+            devices.push_back(device);
+        }
+    }
+    return devices;
+}
+
+bool ExecutorTaskFromJobDir(ExecutorTask &task, std::string job_dir)
+{
+    // Campaign job directories hold exactly one tc_<type>.in; the output names follow from it.
+    if (!fs::is_directory(job_dir))
+    {
+        return false;
+    }
+    for (fs::path p : fs::directory_iterator(job_dir))
+    {
+        std::string name = p.filename().string();
+        if (name.rfind("tc_", 0) == 0 && p.extension() == ".in")
+        {
+            std::string stem = p.stem().string();
+            task.job_dir = job_dir;
+            task.input = name;
+            task.output = stem + ".out";
+            task.error = stem + ".err";
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string ExecutorSlotName(const ExecutorSlot &slot)
+{
+    std::string name = slot.device.empty() ? "-" : slot.device;
+    if (!slot.cpus.empty())
+    {
+        name += "@" + std::to_string(slot.cpus.front()) + "-" + std::to_string(slot.cpus.back());
+    }
+    return name;
+}
+
+std::vector<ExecutorSlot> ExecutorSlots(std::vector<std::string> devices, std::vector<std::vector<int>> cpu_sets, unsigned int n_workers)
+{
+    // One slot per worker; devices and CPU sets are handed out round-robin.
+    if (n_workers == 0)
+    {
+        n_workers = std::max<size_t>(1, std::max(devices.size(), cpu_sets.size()));
+    }
+    std::vector<ExecutorSlot> slots(n_workers);
+    for (unsigned int w = 0; w < n_workers; w++)
+    {
+        if (!devices.empty())
+        {
+            slots[w].device = devices[w % devices.size()];
+        }
+        if (!cpu_sets.empty())
+        {
+            slots[w].cpus = cpu_sets[w % cpu_sets.size()];
+        }
+    }
+    return slots;
+}
+
+std::string ExecutorResultLine(const ExecutorResult &result)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << result.job_dir << " slot=" << (result.slot.empty() ? "-" : result.slot) << " exit=" << result.exit_code;
+    buffer << " finished=" << (result.finished ? "yes" : "no") << " errors=" << result.n_errors;
+    buffer << " seconds=" << std::fixed << std::setprecision(1) << result.seconds;
+    if (result.has_energy)
+    {
+        buffer << " energy=" << std::setprecision(10) << result.final_energy;
+    }
+    return buffer.str();
+}
+
+ExecutorResult collect_task_result(const ExecutorTask &task, std::string slot, int exit_code, double seconds)
+{
+    ExecutorResult result;
+    result.job_dir = task.job_dir;
+    result.slot = slot;
+    result.exit_code = exit_code;
+    result.seconds = seconds;
+    std::string output = (fs::path(task.job_dir) / task.output).string();
+    if (fs::exists(output))
+    {
+        TCOutputResults parsed = ParseTCOutput(output);
+        write_to_file(output + ".json", TCResultsToJSON(parsed));
+        result.finished = parsed.finished;
+        result.has_energy = parsed.has_energy;
+        result.final_energy = parsed.final_energy;
+        result.n_errors = parsed.errors.size();
+    }
+    return result;
+}
+
+void RunTaskQueue(ExecutorTaskSource next_task, std::vector<ExecutorSlot> slots, ExecutorResultSink finished)
+{
+    // Without named devices or workers there is a single unpinned slot.
+    if (slots.empty())
+    {
+        slots = {ExecutorSlot()};
+    }
+    std::string executable = TeraChemExecutable();
+    std::map<std::string,std::string> environment = TeraChemEnvironment();
+    std::vector<Process> processes(slots.size());
+    std::vector<ExecutorTask> running(slots.size());
+    std::vector<bool> busy(slots.size(), false);
+    std::vector<std::chrono::steady_clock::time_point> started(slots.size());
+    size_t n_running = 0;
+
+    while (true)
+    {
+        // Fill every free slot before waiting; an empty source is asked again once a slot frees up.
+        bool exhausted = false;
+        for (size_t s = 0; s < slots.size() && !exhausted; s++)
+        {
+            while (!busy[s] && !exhausted)
+            {
+                ExecutorTask task;
+                if (!next_task(task))
+                {
+                    exhausted = true;
+                    break;
+                }
+                ProcessOptions options;
+                options.working_dir = task.job_dir;
+                options.stdout_file = (fs::path(task.job_dir) / task.output).string();
+                options.stderr_file = (fs::path(task.job_dir) / task.error).string();
+                options.environment = environment;
+                options.cpu_affinity = slots[s].cpus;
+                if (!slots[s].device.empty())
+                {
+                    options.environment["CUDA_VISIBLE_DEVICES"] = slots[s].device;
+                }
+                debug_log("Starting " + task.job_dir + "/" + task.input + " on slot " + ExecutorSlotName(slots[s]));
+                started[s] = std::chrono::steady_clock::now();
+                if (SpawnProcess(processes[s], {executable, "-i", task.input}, options))
+                {
+                    running[s] = task;
+                    busy[s] = true;
+                    n_running++;
+                }
+                else
+                {
+                    normal_log("Unable to start " + executable + " for " + task.job_dir);
+                    finished(task, collect_task_result(task, ExecutorSlotName(slots[s]), -1, 0.0));
+                }
+            }
+        }
+        if (n_running == 0)
+        {
+            break;
+        }
+
+        // Wait for any slot to free up, then report on the task it ran.
+        std::vector<Process*> waiting = {};
+        std::vector<size_t> waiting_slots = {};
+        for (size_t s = 0; s < slots.size(); s++)
+        {
+            if (busy[s])
+            {
+                waiting.push_back(&processes[s]);
+                waiting_slots.push_back(s);
+            }
+        }
+        int done = WaitAnyProcess(waiting, -1);
+        if (done < 0)
+        {
+            continue;
+        }
+        size_t s = waiting_slots[done];
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started[s]).count();
+        busy[s] = false;
+        n_running--;
+        finished(running[s], collect_task_result(running[s], ExecutorSlotName(slots[s]), processes[s].exit_code, seconds));
+    }
+}
+
+std::vector<ExecutorResult> RunTaskQueue(const std::vector<ExecutorTask> &tasks, std::vector<ExecutorSlot> slots, std::string report_file)
+{
+    std::vector<ExecutorResult> results = {};
+    size_t next = 0;
+    RunTaskQueue([&](ExecutorTask &task)
+    {
+        if (next >= tasks.size())
+        {
+            return false;
+        }
+        task = tasks[next++];
+        return true;
+    }, slots, [&](const ExecutorTask &, const ExecutorResult &result)
+    {
+        results.push_back(result);
+        append_to_file(report_file, ExecutorResultLine(result) + "\n");
+        normal_log(ExecutorResultLine(result));
+    });
+    return results;
+}
+
+void check_pack_worker_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("pack_worker") > 0)
+    {
+        if (flags["pack_worker"].size() < 3)
+        {
+            PrintUsage();
+            error_log("The --pack_worker flag requires a campaign directory, a first job and a job count.", 1);
+        }
+        PACK_WORKER_DIR = flags["pack_worker"][0];
+        PACK_WORKER_FIRST = std::max(1, std::stoi(flags["pack_worker"][1]));
+        PACK_WORKER_COUNT = std::max(0, std::stoi(flags["pack_worker"][2]));
+        flags.erase("pack_worker");
+    }
+}
+
+void RunPackWorkerMode()
+{
+    // Runs lines [first, first+count) of the campaign job list on this allocation's GPU slots.
+    std::ifstream fin(fs::path(PACK_WORKER_DIR) / "AutoQuantum_Campaign_Jobs.lst");
+    if (!fin.is_open())
+    {
+        error_log("Unable to read the campaign job list in " + PACK_WORKER_DIR, 1);
+    }
+    std::vector<ExecutorTask> tasks = {};
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(fin, line) && line_number < PACK_WORKER_FIRST - 1 + PACK_WORKER_COUNT)
+    {
+        line_number++;
+        if (line_number < PACK_WORKER_FIRST || line.empty())
+        {
+            continue;
+        }
+        ExecutorTask task;
+        if (ExecutorTaskFromJobDir(task, (fs::path(PACK_WORKER_DIR) / line).string()))
+        {
+            tasks.push_back(task);
+        }
+        else
+        {
+            normal_log("No TeraChem input found in " + line + ", skipping.");
+        }
+    }
+    fin.close();
+
+    std::vector<ExecutorSlot> slots = ExecutorSlots(VisibleGPUDevices(), {}, 0);
+    std::string report_file = (fs::path(PACK_WORKER_DIR) / ("AutoQuantum_Pack." + std::to_string(PACK_WORKER_FIRST) + ".report")).string();
+    normal_log("Running " + std::to_string(tasks.size()) + " packed jobs on " + std::to_string(slots.size()) + " GPU slot(s).");
+    RunTaskQueue(tasks, slots, report_file);
+}
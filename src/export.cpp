@@ -0,0 +1,698 @@
+#include "export.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::vector<std::string> EXPORT_DIRS = {};
+std::string EXPORT_FILE = "";
+
+void check_export_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("export") > 0)
+    {
+        EXPORT_DIRS = flags["export"].empty() ? std::vector<std::string>{"."} : flags["export"];
+        flags.erase("export");
+    }
+    if (flags.count("export_file") > 0)
+    {
+        if (!flags["export_file"].empty())
+        {
+            EXPORT_FILE = flags["export_file"][0];
+        }
+        flags.erase("export_file");
+    }
+}
+
+// Header encoding
+size_t column_value_bytes(uint32_t type)
+{
+    if (type == COLUMN_BYTES)
+    {
+        return 1;
+    }
+    return (type == COLUMN_INT32) ? sizeof(int32_t) : sizeof(double);
+}
+
+uint64_t column_row_bytes(const ColumnInfo &column)
+{
+    return column.width * column_value_bytes(column.type);
+}
+
+uint64_t page_align(uint64_t bytes)
+{
+    return (bytes + COLUMN_FILE_HEADER_BYTES - 1) / COLUMN_FILE_HEADER_BYTES * COLUMN_FILE_HEADER_BYTES;
+}
+
+std::vector<char> encode_column_header(const ColumnFile &file)
+{
+    std::vector<char> header(COLUMN_FILE_HEADER_BYTES, '\0');
+    uint32_t version = COLUMN_FILE_VERSION, n_columns = file.columns.size(), header_bytes = COLUMN_FILE_HEADER_BYTES;
+    memcpy(&header[0], COLUMN_FILE_MAGIC, 4);
+    memcpy(&header[4], &version, 4);
+    memcpy(&header[8], &n_columns, 4);
+    memcpy(&header[12], &header_bytes, 4);
+    memcpy(&header[16], file.source.data(), std::min<size_t>(file.source.size(), COLUMN_FILE_SOURCE_BYTES - 1));
+    for (size_t k = 0; k < file.columns.size(); k++)
+    {
+        const ColumnInfo &column = file.columns[k];
+        char *entry = &header[512 + 64 * k];
+        memcpy(entry, column.name.data(), std::min<size_t>(column.name.size(), 23));
+        memcpy(entry + 24, &column.type, 4);
+        memcpy(entry + 28, &column.width, 4);
+        memcpy(entry + 32, &column.rows, 8);
+        memcpy(entry + 40, &column.capacity, 8);
+        memcpy(entry + 48, &column.offset, 8);
+        memcpy(entry + 56, &column.consumed, 8);
+    }
+    return header;
+}
+
+bool decode_column_header(ColumnFile &file, const char *header, size_t size)
+{
+    uint32_t version = 0, n_columns = 0;
+    if (size < COLUMN_FILE_HEADER_BYTES || memcmp(header, COLUMN_FILE_MAGIC, 4) != 0)
+    {
+        return false;
+    }
+    memcpy(&version, header + 4, 4);
+    memcpy(&n_columns, header + 8, 4);
+    if (version != COLUMN_FILE_VERSION || n_columns > COLUMN_FILE_MAX_COLUMNS)
+    {
+        return false;
+    }
+    file.source = std::string(header + 16, strnlen(header + 16, COLUMN_FILE_SOURCE_BYTES));
+    file.columns.clear();
+    for (size_t k = 0; k < n_columns; k++)
+    {
+        const char *entry = header + 512 + 64 * k;
+        ColumnInfo column;
+        column.name = std::string(entry, strnlen(entry, 24));
+        memcpy(&column.type, entry + 24, 4);
+        memcpy(&column.width, entry + 28, 4);
+        memcpy(&column.rows, entry + 32, 8);
+        memcpy(&column.capacity, entry + 40, 8);
+        memcpy(&column.offset, entry + 48, 8);
+        memcpy(&column.consumed, entry + 56, 8);
+        file.columns.push_back(column);
+    }
+    return true;
+}
+
+// Reading
+bool OpenColumnFile(ColumnFile &file, std::string filename)
+{
+    file = ColumnFile();
+    file.filename = filename;
+    if (!map_file(file.mapped, filename) || !decode_column_header(file, file.mapped.data, file.mapped.size))
+    {
+        unmap_file(file.mapped);
+        return false;
+    }
+    for (const ColumnInfo &column : file.columns)
+    {
+        if (column.offset + column.rows * column_row_bytes(column) > file.mapped.size)
+        {
+            unmap_file(file.mapped);
+            return false;
+        }
+    }
+    return true;
+}
+
+void CloseColumnFile(ColumnFile &file)
+{
+    unmap_file(file.mapped);
+    file = ColumnFile();
+}
+
+const ColumnInfo *FindColumn(const ColumnFile &file, std::string name)
+{
+    for (const ColumnInfo &column : file.columns)
+    {
+        if (column.name == name)
+        {
+            return &column;
+        }
+    }
+    return nullptr;
+}
+
+const void *ColumnData(const ColumnFile &file, const ColumnInfo &column)
+{
+    return (file.mapped.data == nullptr) ? nullptr : file.mapped.data + column.offset;
+}
+
+long FindSegment(const ColumnFile &file, std::string source)
+{
+    const ColumnInfo *sources = FindColumn(file, COLUMN_SEGMENT_SOURCE);
+    const char *data = (sources != nullptr) ? (const char*)ColumnData(file, *sources) : nullptr;
+    if (data == nullptr || sources->type != COLUMN_BYTES)
+    {
+        return -1;
+    }
+    for (uint64_t s = 0; s < sources->rows; s++)
+    {
+        const char *row = data + s * sources->width;
+        if (std::string(row, strnlen(row, sources->width)) == source)
+        {
+            return s;
+        }
+    }
+    return -1;
+}
+
+std::vector<uint64_t> SegmentRows(const ColumnFile &file, std::string name, long segment)
+{
+    // Rows of column 'name' that came from the given segment, in order.
+    std::vector<uint64_t> rows = {};
+    const ColumnInfo *tags = FindColumn(file, name + COLUMN_SEGMENT_SUFFIX);
+    const int32_t *data = (tags != nullptr && segment >= 0) ? (const int32_t*)ColumnData(file, *tags) : nullptr;
+    if (data == nullptr || tags->type != COLUMN_INT32)
+    {
+        return rows;
+    }
+    for (uint64_t r = 0; r < tags->rows; r++)
+    {
+        if (data[r] == segment)
+        {
+            rows.push_back(r);
+        }
+    }
+    return rows;
+}
+
+bool ReadColumnFileHeader(ColumnFile &file, std::string filename)
+{
+    file = ColumnFile();
+    file.filename = filename;
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    std::vector<char> header(COLUMN_FILE_HEADER_BYTES);
+    if (!fin.is_open() || !fin.read(header.data(), header.size()))
+    {
+        return false;
+    }
+    return decode_column_header(file, header.data(), header.size());
+}
+
+// Writing
+bool write_all(int fd, const void *data, size_t bytes, uint64_t offset)
+{
+    const char *p = (const char*)data;
+    while (bytes > 0)
+    {
+        ssize_t n = pwrite(fd, p, bytes, offset);
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool rebuild_column_file(std::string filename, int &fd, ColumnFile &file, const std::vector<uint64_t> &needed)
+{
+    // Lay the columns out again with room to grow, copy the existing rows across, and swap the file in.
+    ColumnFile rebuilt = file;
+    uint64_t offset = COLUMN_FILE_HEADER_BYTES;
+    for (size_t k = 0; k < rebuilt.columns.size(); k++)
+    {
+        ColumnInfo &column = rebuilt.columns[k];
+        if (needed[k] > column.capacity)
+        {
+            column.capacity = std::max<uint64_t>(needed[k] + needed[k] / 2, 16);
+        }
+        column.offset = offset;
+        offset = page_align(offset + column.capacity * column_row_bytes(column));
+    }
+    std::string partial = filename + ".partial." + std::to_string(getpid());
+    int new_fd = open(partial.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (new_fd < 0 || ftruncate(new_fd, offset) != 0)
+    {
+        normal_log("Unable to create " + partial);
+        if (new_fd >= 0)
+        {
+            close(new_fd);
+        }
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    bool ok = true;
+    for (size_t k = 0; ok && k < file.columns.size() && fd >= 0; k++)
+    {
+        uint64_t bytes = file.columns[k].rows * column_row_bytes(file.columns[k]);
+        for (uint64_t done = 0; ok && done < bytes; )
+        {
+            ssize_t n = pread(fd, buffer.data(), std::min<uint64_t>(buffer.size(), bytes - done), file.columns[k].offset + done);
+            ok = (n > 0) && write_all(new_fd, buffer.data(), n, rebuilt.columns[k].offset + done);
+            done += (n > 0) ? n : 0;
+        }
+    }
+    std::vector<char> header = encode_column_header(rebuilt);
+    ok = ok && write_all(new_fd, header.data(), header.size(), 0) && fdatasync(new_fd) == 0 && rename(partial.c_str(), filename.c_str()) == 0;
+    if (!ok)
+    {
+        normal_log("Unable to rebuild " + filename);
+        close(new_fd);
+        unlink(partial.c_str());
+        return false;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    fd = new_fd;
+    file = rebuilt;
+    return true;
+}
+
+uint64_t append_value_count(const ColumnAppend &append)
+{
+    if (append.type == COLUMN_BYTES)
+    {
+        return append.bytes.size();
+    }
+    return (append.type == COLUMN_INT32) ? append.ints.size() : append.values.size();
+}
+
+const void *append_data(const ColumnAppend &append)
+{
+    if (append.type == COLUMN_BYTES)
+    {
+        return append.bytes.data();
+    }
+    return (append.type == COLUMN_INT32) ? (const void*)append.ints.data() : (const void*)append.values.data();
+}
+
+void add_segment_columns(std::vector<ColumnAppend> &appends, const ColumnFile &file, long known_segment, std::string source)
+{
+    // A new source opens a new segment; each appended row is tagged with the segment it came from.
+    const ColumnInfo *sources = FindColumn(file, COLUMN_SEGMENT_SOURCE);
+    uint64_t n_segments = (sources != nullptr) ? sources->rows : 0;
+    bool new_segment = (known_segment < 0);
+    int32_t segment = new_segment ? n_segments : known_segment;
+    size_t n_data = appends.size();
+    for (size_t i = 0; i < n_data; i++)
+    {
+        uint64_t n_values = append_value_count(appends[i]);
+        if (appends[i].width == 0 || n_values % appends[i].width != 0)
+        {
+            continue;
+        }
+        ColumnAppend tags;
+        tags.name = appends[i].name + COLUMN_SEGMENT_SUFFIX;
+        tags.type = COLUMN_INT32;
+        tags.consumed = appends[i].consumed;
+        tags.replace_row = appends[i].replace_row;
+        tags.ints.assign(n_values / appends[i].width, segment);
+        appends.push_back(tags);
+    }
+    if (new_segment)
+    {
+        ColumnAppend name;
+        name.name = COLUMN_SEGMENT_SOURCE;
+        name.type = COLUMN_BYTES;
+        name.width = COLUMN_FILE_SOURCE_BYTES;
+        name.bytes.assign(COLUMN_FILE_SOURCE_BYTES, 0);
+        memcpy(name.bytes.data(), source.data(), std::min<size_t>(source.size(), COLUMN_FILE_SOURCE_BYTES - 1));
+        appends.push_back(name);
+    }
+}
+
+bool AppendColumns(std::string filename, std::string source, std::vector<ColumnAppend> appends)
+{
+    // Writers take turns through a lock file, since a rebuild replaces the data file itself.
+    std::string lock_file = filename + ".lock";
+    int lock_fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+    {
+        normal_log("Unable to lock " + lock_file);
+        if (lock_fd >= 0)
+        {
+            close(lock_fd);
+        }
+        return false;
+    }
+    ColumnFile file;
+    bool existing = ReadColumnFileHeader(file, filename);
+    if (!existing && fs::exists(filename) && fs::file_size(filename) > 0)
+    {
+        normal_log(filename + " is not an AutoQuantum column file (version " + std::to_string(COLUMN_FILE_VERSION) + "); not overwriting it.");
+        close(lock_fd);
+        return false;
+    }
+    ColumnFile mapped;
+    long known_segment = (existing && OpenColumnFile(mapped, filename)) ? FindSegment(mapped, source) : -1;
+    CloseColumnFile(mapped);
+    add_segment_columns(appends, file, known_segment, source);
+    if (file.source != source)
+    {
+        for (ColumnInfo &column : file.columns)
+        {
+            column.consumed = 0;
+        }
+    }
+    file.source = source;
+
+    // Match each append to its column, adding new columns at the end of the directory.
+    // Rows that do not fit a column, or a column that does not fit the file, fail the whole append.
+    std::vector<long> target(appends.size(), -1);
+    std::vector<uint64_t> first_row(appends.size(), 0);
+    for (size_t i = 0; i < appends.size(); i++)
+    {
+        ColumnAppend &append = appends[i];
+        uint64_t n_values = append_value_count(append);
+        if (append.width == 0 || n_values % append.width != 0)
+        {
+            continue;
+        }
+        long k = 0;
+        while (k < (long)file.columns.size() && file.columns[k].name != append.name)
+        {
+            k++;
+        }
+        if (k == (long)file.columns.size())
+        {
+            if (file.columns.size() >= COLUMN_FILE_MAX_COLUMNS)
+            {
+                normal_log("No room for column '" + append.name + "' in " + filename);
+                close(lock_fd);
+                return false;
+            }
+            ColumnInfo column;
+            column.name = append.name;
+            column.type = append.type;
+            column.width = append.width;
+            file.columns.push_back(column);
+        }
+        else if (file.columns[k].type != append.type || file.columns[k].width != append.width)
+        {
+            normal_log("Column '" + append.name + "' in " + filename + " holds rows of " + std::to_string(file.columns[k].width) + " values, not " + std::to_string(append.width) + " (a different system?)");
+            close(lock_fd);
+            return false;
+        }
+        target[i] = k;
+        first_row[i] = (append.replace_row >= 0 && (uint64_t)append.replace_row < file.columns[k].rows) ? append.replace_row : file.columns[k].rows;
+    }
+    int fd = existing ? open(filename.c_str(), O_RDWR | O_CLOEXEC) : -1;
+    std::vector<uint64_t> needed(file.columns.size(), 0);
+    bool grow = !existing;
+    for (size_t k = 0; k < file.columns.size(); k++)
+    {
+        needed[k] = file.columns[k].rows;
+    }
+    for (size_t i = 0; i < appends.size(); i++)
+    {
+        if (target[i] >= 0)
+        {
+            uint64_t n_values = append_value_count(appends[i]);
+            needed[target[i]] = std::max(needed[target[i]], first_row[i] + n_values / appends[i].width);
+            grow = grow || needed[target[i]] > file.columns[target[i]].capacity;
+        }
+    }
+    if (grow && !rebuild_column_file(filename, fd, file, needed))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        close(lock_fd);
+        return false;
+    }
+
+    // Rows first, then the header that makes them visible.
+    bool ok = true;
+    for (size_t i = 0; ok && i < appends.size(); i++)
+    {
+        if (target[i] < 0)
+        {
+            continue;
+        }
+        ColumnInfo &column = file.columns[target[i]];
+        const ColumnAppend &append = appends[i];
+        uint64_t n_rows = append_value_count(append) / append.width;
+        ok = write_all(fd, append_data(append), n_rows * column_row_bytes(column), column.offset + first_row[i] * column_row_bytes(column));
+        column.rows = std::max(column.rows, first_row[i] + n_rows);
+        column.consumed = append.consumed;
+    }
+    std::vector<char> header = encode_column_header(file);
+    ok = ok && fdatasync(fd) == 0 && write_all(fd, header.data(), header.size(), 0);
+    if (!ok)
+    {
+        normal_log("Unable to write to " + filename);
+    }
+    close(fd);
+    close(lock_fd);
+    return ok;
+}
+
+// Sources in a job directory
+std::string export_source_id(std::string job_dir, std::string output)
+{
+    // A restarted run writes a new output file, so its inode tells segments apart.
+    struct stat info;
+    std::string id = fs::absolute(job_dir).string();
+    if (stat((fs::path(job_dir) / output).c_str(), &info) == 0)
+    {
+        id += "#" + std::to_string((unsigned long long)info.st_ino);
+    }
+    return id;
+}
+
+void append_md_log_columns(std::vector<ColumnAppend> &appends, std::string log_file, std::function<uint64_t(std::string)> already)
+{
+    // TeraChem's MD log is a table with a header line; columns are picked out by name.
+    std::ifstream fin(log_file);
+    if (!fin.is_open())
+    {
+        return;
+    }
+    static const std::vector<std::pair<std::string,std::string>> wanted = {{"md_time", "time"}, {"md_temperature", "temp"}, {"md_potential_energy", "potential"},
+                                                                           {"md_kinetic_energy", "kinetic"}, {"md_total_energy", "total"}};
+    std::vector<long> field(wanted.size(), -1);
+    std::vector<ColumnAppend> columns(wanted.size());
+    for (size_t c = 0; c < wanted.size(); c++)
+    {
+        columns[c].name = wanted[c].first;
+        columns[c].consumed = already(wanted[c].first);
+    }
+    std::string line;
+    uint64_t row = 0;
+    bool header = false;
+    while (std::getline(fin, line))
+    {
+        std::vector<std::string> tokens = {};
+        for (std::string token : split_string(line, (line.find('\t') != std::string::npos) ? "\t" : " "))
+        {
+            if (!token.empty())
+            {
+                tokens.push_back(token);
+            }
+        }
+        if (tokens.empty())
+        {
+            continue;
+        }
+        if (!header && !(isdigit((unsigned char)tokens[0][0]) || tokens[0][0] == '-' || tokens[0][0] == '.'))
+        {
+            for (size_t t = 0; t < tokens.size(); t++)
+            {
+                std::string name = tokens[t];
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                for (size_t c = 0; c < wanted.size(); c++)
+                {
+                    if (field[c] < 0 && name.find(wanted[c].second) != std::string::npos)
+                    {
+                        field[c] = t;
+                    }
+                }
+            }
+            header = true;
+            continue;
+        }
+        for (size_t c = 0; c < wanted.size(); c++)
+        {
+            if (field[c] >= 0 && field[c] < (long)tokens.size() && row >= columns[c].consumed)
+            {
+                columns[c].values.push_back(strtod(tokens[field[c]].c_str(), nullptr));
+            }
+        }
+        row++;
+    }
+    for (size_t c = 0; c < wanted.size(); c++)
+    {
+        if (field[c] >= 0 && row > columns[c].consumed)
+        {
+            columns[c].consumed = row;
+            appends.push_back(columns[c]);
+        }
+    }
+}
+
+std::vector<ColumnAppend> ExportJobColumns(std::string job_dir, const ColumnFile &existing)
+{
+    std::vector<ColumnAppend> appends = {};
+    ExecutorTask task;
+    if (!ExecutorTaskFromJobDir(task, job_dir))
+    {
+        return appends;
+    }
+    std::map<std::string,std::string> keywords = {};
+    Read_TC_Input_File(keywords, (fs::path(job_dir) / task.input).string());
+    std::string scrdir = (fs::path(job_dir) / (keywords.count("scrdir") > 0 ? keywords["scrdir"] : "scr/")).string();
+    // What this source has already contributed is whatever rows carry its segment.
+    long segment = FindSegment(existing, export_source_id(job_dir, task.output));
+    auto already = [&](std::string name) -> uint64_t
+    {
+        return SegmentRows(existing, name, segment).size();
+    };
+    // Single-row results are rewritten in place, and left alone when unchanged.
+    auto unchanged_or_row = [&](ColumnAppend &append) -> bool
+    {
+        std::vector<uint64_t> rows = SegmentRows(existing, append.name, segment);
+        const ColumnInfo *column = FindColumn(existing, append.name);
+        if (rows.empty() || column == nullptr || column->width != append.width || column->type != COLUMN_FLOAT64)
+        {
+            return false;
+        }
+        append.replace_row = rows.back();
+        const double *stored = (const double*)ColumnData(existing, *column) + rows.back() * column->width;
+        return std::equal(append.values.begin(), append.values.end(), stored);
+    };
+
+    // Energies and the final gradient from the output.
+    std::string output = (fs::path(job_dir) / task.output).string();
+    if (fs::exists(output))
+    {
+        TCOutputResults results = ParseTCOutput(output);
+        ColumnAppend energies;
+        energies.name = "scf_energy";
+        for (size_t i = already("scf_energy"); i < results.scf_energies.size(); i++)
+        {
+            energies.values.push_back(results.scf_energies[i]);
+        }
+        energies.consumed = results.scf_energies.size();
+        if (!energies.values.empty())
+        {
+            appends.push_back(energies);
+        }
+        if (results.has_energy)
+        {
+            ColumnAppend final_energy;
+            final_energy.name = "final_energy";
+            final_energy.values = {results.final_energy};
+            final_energy.consumed = 1;
+            if (!unchanged_or_row(final_energy))
+            {
+                appends.push_back(final_energy);
+            }
+        }
+        if (!results.gradient.empty())
+        {
+            ColumnAppend gradient;
+            gradient.name = "gradient";
+            gradient.width = results.gradient.size();
+            gradient.values = results.gradient;
+            gradient.consumed = 1;
+            if (!unchanged_or_row(gradient))
+            {
+                appends.push_back(gradient);
+            }
+        }
+    }
+
+    // Per-step MD observables.
+    append_md_log_columns(appends, (fs::path(scrdir) / "log.xls").string(), already);
+
+    // Coordinates of every frame not yet exported, as x0 y0 z0 x1 y1 z1 ... rows.
+    XYZTrajectory trajectory;
+    std::string trajectory_file = fs::exists(fs::path(scrdir) / "coors.xyz") ? (fs::path(scrdir) / "coors.xyz").string() : (fs::path(scrdir) / "optim.xyz").string();
+    if (OpenTrajectory(trajectory, trajectory_file))
+    {
+        size_t n_frames = TrajectoryFrameCount(trajectory);
+        std::vector<size_t> frames = {};
+        for (size_t f = already("coordinates"); f < n_frames; f++)
+        {
+            frames.push_back(f);
+        }
+        XYZFrames decoded;
+        bool read = ReadTrajectoryFrames(decoded, trajectory, frames, default_thread_count());
+        CloseTrajectory(trajectory);
+        if (!read)
+        {
+            normal_log("Skipping coordinates from " + trajectory_file + ": its frames do not all have the same number of atoms.");
+        }
+        if (read && !frames.empty() && decoded.n_atoms > 0)
+        {
+            ColumnAppend coordinates;
+            coordinates.name = "coordinates";
+            coordinates.width = 3 * decoded.n_atoms;
+            coordinates.consumed = n_frames;
+            coordinates.values.resize(frames.size() * coordinates.width);
+            for (size_t i = 0; i < frames.size() * decoded.n_atoms; i++)
+            {
+                coordinates.values[3*i] = decoded.x[i];
+                coordinates.values[3*i+1] = decoded.y[i];
+                coordinates.values[3*i+2] = decoded.z[i];
+            }
+            appends.push_back(coordinates);
+            ColumnAppend elements;
+            elements.name = "atomic_number";
+            elements.type = COLUMN_INT32;
+            elements.width = decoded.n_atoms;
+            elements.consumed = 1;
+            elements.replace_row = 0;
+            for (std::string element : decoded.elements)
+            {
+                elements.ints.push_back(element_atomic_number(element));
+            }
+            appends.push_back(elements);
+        }
+    }
+    return appends;
+}
+
+void RunExportMode()
+{
+    // Each directory is one segment, appended in the order given; directories already exported only add what is new.
+    std::string filename = EXPORT_FILE.empty() ? (fs::path(EXPORT_DIRS[0]) / COLUMN_FILE_DEFAULT_NAME).string() : EXPORT_FILE;
+    for (std::string job_dir : EXPORT_DIRS)
+    {
+        ExecutorTask task;
+        if (!ExecutorTaskFromJobDir(task, job_dir))
+        {
+            normal_log("No TeraChem input found in " + job_dir + ", skipping.");
+            continue;
+        }
+        ColumnFile existing;
+        OpenColumnFile(existing, filename);
+        std::vector<ColumnAppend> appends = ExportJobColumns(job_dir, existing);
+        CloseColumnFile(existing);
+        if (appends.empty())
+        {
+            debug_log("Nothing new to export from " + job_dir);
+            continue;
+        }
+        if (!AppendColumns(filename, export_source_id(job_dir, task.output), appends))
+        {
+            error_log("Unable to export " + job_dir + " to " + filename, 1);
+        }
+    }
+    ColumnFile file;
+    if (!ReadColumnFileHeader(file, filename))
+    {
+        normal_log("Nothing was exported to " + filename);
+        return;
+    }
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "Exported to " << filename << ":";
+    for (const ColumnInfo &column : file.columns)
+    {
+        buffer << std::endl << "  " << std::left << std::setw(24) << column.name << column.rows << " x " << column.width << (column.type == COLUMN_BYTES ? " bytes" : (column.type == COLUMN_INT32 ? " int32" : " float64"));
+    }
+    normal_log(buffer.str());
+}
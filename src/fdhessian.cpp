@@ -0,0 +1,411 @@
+#include "fdhessian.h"
+#include "logger.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+bool FD_HESSIAN = false;
+double FD_STEP = DEFAULT_FD_STEP_BOHR;
+std::string FD_RESUME_DIR = "";
+
+void check_fd_hessian_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("fd_hessian") > 0)
+    {
+        FD_HESSIAN = true;
+        flags.erase("fd_hessian");
+    }
+    if (flags.count("fd_step") > 0)
+    {
+        if (!flags["fd_step"].empty())
+        {
+            FD_STEP = std::stod(flags["fd_step"][0]);
+        }
+        if (FD_STEP <= 0.0)
+        {
+            error_log("The --fd_step flag requires a positive step in Bohr.", 1);
+        }
+        flags.erase("fd_step");
+    }
+    if (flags.count("fd_resume") > 0)
+    {
+        FD_RESUME_DIR = flags["fd_resume"].empty() ? "." : flags["fd_resume"][0];
+        flags.erase("fd_resume");
+    }
+}
+
+std::string fd_displacement_name(size_t coordinate, int sign)
+{
+    // disp.00012.y+ moves the y coordinate of atom 12 up by one step.
+    std::stringstream name;
+    name.str("");
+    name << "disp." << std::setw(5) << std::setfill('0') << (coordinate / 3 + 1) << "." << "xyz"[coordinate % 3] << (sign > 0 ? "+" : "-");
+    return name.str();
+}
+
+// The state file keeps what the resuming process needs to know: step, packing and whether the displacements are out.
+struct FDState
+{
+    double step = DEFAULT_FD_STEP_BOHR;
+    unsigned int pack = 0;
+    unsigned int throttle = 0;
+    bool submitted = false;
+};
+
+bool read_fd_state(FDState &state, std::string filename)
+{
+    std::ifstream fin(filename);
+    std::string key;
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    while (fin >> key)
+    {
+        if (key == "step") fin >> state.step;
+        else if (key == "pack") fin >> state.pack;
+        else if (key == "throttle") fin >> state.throttle;
+        else if (key == "submitted") fin >> state.submitted;
+    }
+    return true;
+}
+
+void write_fd_state(const FDState &state, std::string filename)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::setprecision(10) << "step " << state.step << std::endl << "pack " << state.pack << std::endl
+           << "throttle " << state.throttle << std::endl << "submitted " << (state.submitted ? 1 : 0) << std::endl;
+    write_to_file(filename, buffer.str());
+}
+
+bool read_reference(std::string job_dir, ExecutorTask &reference, std::map<std::string,std::string> &keywords, XYZFrames &geometry)
+{
+    if (!ExecutorTaskFromJobDir(reference, job_dir) || !Read_TC_Input_File(keywords, (fs::path(job_dir) / reference.input).string()))
+    {
+        return false;
+    }
+    geometry = ReadLastFrame((fs::path(job_dir) / keywords["coordinates"]).string());
+    return geometry.n_atoms > 0;
+}
+
+std::vector<std::string> prepare_displacements(std::map<std::string,std::string> keywords, const ExecutorTask &reference, const XYZFrames &geometry, const FDState &state)
+{
+    // Run in the reference job directory. Every displacement gets hard links to the reference orbitals as its guess.
+    std::string scrdir = keywords.count("scrdir") > 0 ? keywords["scrdir"] : "scr/";
+    if (scrdir.back() != '/')
+    {
+        scrdir += "/";
+    }
+    std::vector<std::string> orbitals = {};
+    for (std::string file : split_string(carry_forward_guess(scrdir), " "))
+    {
+        if (!file.empty())
+        {
+            orbitals.push_back(file);
+        }
+    }
+    if (orbitals.empty())
+    {
+        normal_log("No orbitals found in " + scrdir + "; the displaced gradients start from TeraChem's default guess.");
+    }
+    keywords["coordinates"] = "geometry.xyz";
+    keywords["scrdir"] = "scr/";
+    keywords.erase("guess");
+    std::string guess = "";
+    for (std::string file : orbitals)
+    {
+        guess += (guess.empty() ? "" : " ") + fs::path(file).filename().string();
+    }
+    if (!guess.empty())
+    {
+        keywords["guess"] = guess;
+    }
+
+    size_t n = 3 * geometry.n_atoms;
+    double step_angstrom = state.step * 0.529177210903;
+    std::vector<std::string> names(2 * n), failures(2 * n);
+    parallel_for(2 * n, default_thread_count(), [&](size_t k)
+    {
+        size_t coordinate = k / 2;
+        int sign = (k % 2 == 0) ? 1 : -1;
+        names[k] = fd_displacement_name(coordinate, sign);
+        std::error_code ec;
+        fs::create_directory(names[k], ec);
+        XYZFrames displaced = geometry;
+        std::vector<double> &axis = (coordinate % 3 == 0) ? displaced.x : (coordinate % 3 == 1) ? displaced.y : displaced.z;
+        axis[coordinate / 3] += sign * step_angstrom;
+        write_to_file(names[k] + "/geometry.xyz", FrameToXYZ(displaced, 0));
+        for (std::string file : orbitals)
+        {
+            fs::path link = fs::path(names[k]) / fs::path(file).filename();
+            fs::remove(link, ec);
+            fs::create_hard_link(file, link, ec);
+            if (ec)
+            {
+                fs::copy_file(file, link, fs::copy_options::overwrite_existing, ec);
+            }
+        }
+        if (ec || !Write_TC_Input_File(keywords, names[k] + "/" + reference.input))
+        {
+            failures[k] = names[k] + (ec ? ": " + ec.message() : ": unable to write " + reference.input);
+        }
+    });
+    for (std::string failure : failures)
+    {
+        if (!failure.empty())
+        {
+            error_log("Unable to prepare displacement " + failure, 1);
+        }
+    }
+    std::stringstream manifest;
+    manifest.str("");
+    for (std::string name : names)
+    {
+        manifest << name << std::endl;
+    }
+    write_to_file("AutoQuantum_Campaign_Jobs.lst", manifest.str());
+    if (!DRYRUN)
+    {
+        std::vector<std::string> outputs = {};
+        for (std::string name : names)
+        {
+            outputs.push_back(name + "/" + reference.output);
+        }
+        RecordPendingTimings(std::vector<JobFeatures>(names.size(), JobFeaturesFromKeywords(keywords)), outputs);
+    }
+    return names;
+}
+
+bool AssembleFDHessian(std::string job_dir, std::vector<double> &hessian, size_t &n_finished)
+{
+    // Central differences, H[i][j] = (g_i(x + h e_j) - g_i(x - h e_j)) / 2h, then symmetrized.
+    ExecutorTask reference;
+    std::map<std::string,std::string> keywords = {};
+    XYZFrames geometry;
+    FDState state;
+    n_finished = 0;
+    if (!read_reference(job_dir, reference, keywords, geometry) || !read_fd_state(state, (fs::path(job_dir) / FD_STATE_FILE).string()))
+    {
+        return false;
+    }
+    size_t n = 3 * geometry.n_atoms;
+    std::vector<std::vector<double>> gradients(2 * n);
+    parallel_for(2 * n, default_thread_count(), [&](size_t k)
+    {
+        std::string output = (fs::path(job_dir) / fd_displacement_name(k / 2, (k % 2 == 0) ? 1 : -1) / reference.output).string();
+        if (!fs::exists(output))
+        {
+            return;
+        }
+        TCOutputResults results = ParseTCOutput(output);
+        if (results.finished && results.errors.empty() && results.gradient.size() == n)
+        {
+            gradients[k] = results.gradient;
+        }
+    });
+    for (const std::vector<double> &gradient : gradients)
+    {
+        n_finished += !gradient.empty();
+    }
+    if (n_finished < 2 * n)
+    {
+        return false;
+    }
+    hessian.assign(n * n, 0.0);
+    for (size_t j = 0; j < n; j++)
+    {
+        const std::vector<double> &plus = gradients[2*j], &minus = gradients[2*j + 1];
+        for (size_t i = 0; i < n; i++)
+        {
+            hessian[i*n + j] = (plus[i] - minus[i]) / (2.0 * state.step);
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = i + 1; j < n; j++)
+        {
+            double average = 0.5 * (hessian[i*n + j] + hessian[j*n + i]);
+            hessian[i*n + j] = average;
+            hessian[j*n + i] = average;
+        }
+    }
+    return true;
+}
+
+void resume_fd_hessian_here()
+{
+    ExecutorTask reference;
+    std::map<std::string,std::string> keywords = {};
+    XYZFrames geometry;
+    FDState state;
+    std::string here = fs::current_path().string();
+    if (!read_reference(".", reference, keywords, geometry) || !read_fd_state(state, FD_STATE_FILE))
+    {
+        error_log("No finite-difference Hessian job found in " + here, 1);
+    }
+    size_t n_points = 6 * geometry.n_atoms;
+    if (fs::exists(HESSIAN_FILE))
+    {
+        normal_log("The Hessian in " + here + " has already been assembled.");
+        return;
+    }
+
+    if (!state.submitted)
+    {
+        TCOutputResults results = ParseTCOutput(reference.output);
+        if (!results.finished || !results.errors.empty())
+        {
+            normal_log("The reference gradient in " + here + " has not finished cleanly; see " + reference.output);
+            return;
+        }
+        TC_FILENAME = reference.input;
+        TC_OUTFILE = reference.output;
+        TC_ERRFILE = reference.error;
+        CALC_TYPE = "GRAD";
+        std::map<std::string,std::vector<std::string>> kept = {{"gpus", {keywords["gpus"]}}, {"gpumem", {keywords["gpumem"]}}};
+        if (state.pack > 0)
+        {
+            // Packed displacements each get a single GPU slice.
+            keywords["gpus"] = "1";
+        }
+        JOB_RESOURCES = TuneJobKeywords(kept, keywords);
+        std::vector<std::string> names = prepare_displacements(keywords, reference, geometry, state);
+        normal_log("Prepared " + std::to_string(names.size()) + " displaced gradients in " + here);
+        if (DRYRUN)
+        {
+            return;
+        }
+        state.submitted = true;
+        write_fd_state(state, FD_STATE_FILE);
+
+        if (UseSlurmSubmission())
+        {
+            // Every displacement checks on the others once its outputs are back; the last one assembles the Hessian.
+            std::string after = "    " + AutoQuantumExecutable() + " --fd_resume " + here + (DEBUG ? " --debug" : "") + "\n";
+            CAMPAIGN_PACK = state.pack;
+            CAMPAIGN_THROTTLE = state.throttle;
+            if (state.pack > 0)
+            {
+                SubmitSlurmPackedJob(here + "/", names.size(), after);
+            }
+            else
+            {
+                SubmitSlurmArrayJob(keywords, here + "/", names.size(), after);
+            }
+            return;
+        }
+        std::vector<std::string> queued = {};
+        for (std::string name : names)
+        {
+            queued.push_back((fs::path(here) / name).string());
+        }
+        EnqueueLocalJobs(here, queued);
+    }
+    if (!UseSlurmSubmission() && !DRYRUN)
+    {
+        // Also picks up displacements left over from an interrupted local run.
+        RunLocalQueue(here);
+    }
+
+    std::vector<double> hessian;
+    size_t n_finished = 0;
+    if (!AssembleFDHessian(".", hessian, n_finished))
+    {
+        normal_log(std::to_string(n_finished) + " of " + std::to_string(n_points) + " displaced gradients in " + here + " have finished cleanly.");
+        return;
+    }
+    WriteHessianFile(HESSIAN_FILE, hessian, 3 * geometry.n_atoms);
+
+    VibrationalAnalysis analysis;
+    analysis.n_atoms = geometry.n_atoms;
+    for (const std::string &element : geometry.elements)
+    {
+        analysis.masses.push_back(element_mass(element_atomic_number(element)));
+    }
+    std::stringstream summary;
+    summary.str("");
+    summary << "Assembled the Hessian in " << here << "/" << HESSIAN_FILE << " from " << n_points << " displaced gradients";
+    if (HarmonicAnalysis(analysis, geometry, hessian) && !analysis.frequencies.empty())
+    {
+        summary << std::fixed << std::setprecision(1) << "; frequencies " << analysis.frequencies.front() << " to " << analysis.frequencies.back() << " cm^-1, " << analysis.n_imaginary << " imaginary";
+    }
+    normal_log(summary.str() + ". Run 'autoquantum --thermo " + here + "' for thermochemistry.");
+}
+
+void ResumeFDHessian(std::string job_dir)
+{
+    // Array tasks finishing together all call this; the lock lets one of them at a time look at the displacements.
+    std::string lock_file = (fs::path(job_dir) / FD_LOCK_FILE).string();
+    int lock_fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+    {
+        error_log("Unable to lock " + lock_file, 1);
+    }
+    fs::path previous = fs::current_path();
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    resume_fd_hessian_here();
+    fs::current_path(previous);
+    SetLogJobDirectory(".");
+    close(lock_fd);
+}
+
+void RunFDHessian(std::map<std::string,std::vector<std::string>> &flags)
+{
+    std::map<std::string,std::string> keywords = {};
+    Prepare_TC_Keywords(flags, keywords);
+    if (CALC_TYPE != "FREQ")
+    {
+        error_log("--fd_hessian builds the Hessian of a --freq calculation.", 1);
+    }
+    if (keywords.count("prmtop") > 0 || fs::path(keywords["coordinates"]).extension() != ".xyz")
+    {
+        error_log("--fd_hessian needs an XYZ geometry without MM atoms.", 1);
+    }
+
+    // The reference is a gradient at the input geometry; its orbitals seed every displacement.
+    keywords["run"] = "gradient";
+    keywords.erase("mincheck");
+    CALC_TYPE = "GRAD";
+    TC_FILENAME = "tc_grad.in";
+    TC_OUTFILE = "tc_grad.out";
+    TC_ERRFILE = "tc_grad.err";
+
+    std::string job_dir = MakeIterativeDirectoryName("AutoQuantum", 4);
+    move_to_jobdir(keywords, job_dir);
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    keywords["coordinates"] = fs::path(keywords["coordinates"]).filename().string();
+    if (!Write_TC_Input_File(keywords, TC_FILENAME))
+    {
+        error_log("Unable to open " + TC_FILENAME + " for writing.  Check permissions", 1);
+    }
+    FDState state;
+    state.step = FD_STEP;
+    state.pack = CAMPAIGN_PACK;
+    state.throttle = CAMPAIGN_THROTTLE;
+    write_fd_state(state, FD_STATE_FILE);
+    size_t n_atoms = ReadLastFrame(keywords["coordinates"]).n_atoms;
+    normal_log("Finite-difference Hessian in " + job_dir + ": a reference gradient, then " + std::to_string(6 * n_atoms) + " displaced gradients of " + std::to_string(FD_STEP) + " Bohr.");
+
+    if (DRYRUN)
+    {
+        normal_log("DRYRUN flag was invoked.  Input files have been generated, but TeraChem will not be run at this time.");
+        return;
+    }
+    RecordPendingTiming(JobFeaturesFromKeywords(keywords), TC_OUTFILE);
+    if (UseSlurmSubmission())
+    {
+        // The reference job hands out the displacements itself once its orbitals are back.
+        StagingPlan plan;
+        plan.tc_inputs = {TC_FILENAME};
+        plan.outputs = {TC_OUTFILE, TC_ERRFILE, fs::path(keywords["scrdir"]).string()};
+        plan.after_stage_out = "    " + AutoQuantumExecutable() + " --fd_resume \"$RETURN_DIR\"" + (DEBUG ? " --debug" : "") + "\n";
+        std::string body = "\n" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + StagedScriptBody(plan, "terachem -i " + TC_FILENAME + " 1> " + TC_OUTFILE + " 2> " + TC_ERRFILE + "\n");
+        SubmitSlurmScript("AutoQuantum_TC_FDREF", "slurm_" + TC_OUTFILE, "slurm_" + TC_ERRFILE, body);
+        return;
+    }
+    RunTeraChem();
+    ResumeFDHessian(".");
+}
@@ -0,0 +1,240 @@
+#include "localqueue.h"
+#include "restart.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+std::string LOCAL_QUEUE_DIR = "";
+std::string RUN_QUEUE_DIR = "";
+unsigned int LOCAL_WORKERS = 0;
+std::vector<std::string> LOCAL_DEVICES = {};
+std::vector<std::vector<int>> LOCAL_CPU_SETS = {};
+
+void check_local_queue_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    // Queue directories are made absolute here, since preparing a job changes into its directory.
+    if (flags.count("queue") > 0)
+    {
+        if (flags["queue"].empty())
+        {
+            PrintUsage();
+            error_log("The --queue flag requires a queue directory.", 1);
+        }
+        LOCAL_QUEUE_DIR = fs::absolute(flags["queue"][0]).string();
+        flags.erase("queue");
+    }
+    if (flags.count("run_queue") > 0)
+    {
+        RUN_QUEUE_DIR = fs::absolute(flags["run_queue"].empty() ? "." : flags["run_queue"][0]).string();
+        flags.erase("run_queue");
+    }
+    if (flags.count("workers") > 0)
+    {
+        if (!flags["workers"].empty())
+        {
+            LOCAL_WORKERS = std::stoi(flags["workers"][0]);
+        }
+        flags.erase("workers");
+    }
+    if (flags.count("devices") > 0)
+    {
+        for (std::string value : flags["devices"])
+        {
+            for (std::string device : split_string(value, ","))
+            {
+                if (!device.empty())
+                {
+                    LOCAL_DEVICES.push_back(device);
+                }
+            }
+        }
+        flags.erase("devices");
+    }
+    if (flags.count("cpu_sets") > 0)
+    {
+        for (std::string value : flags["cpu_sets"])
+        {
+            LOCAL_CPU_SETS.push_back(parse_cpu_list(value));
+        }
+        flags.erase("cpu_sets");
+    }
+    if (LOCAL_DEVICES.empty())
+    {
+        LOCAL_DEVICES = VisibleGPUDevices();
+    }
+}
+
+std::vector<int> parse_cpu_list(std::string list)
+{
+    // taskset-style lists, e.g. "0-3,8,10-11".
+    std::vector<int> cpus = {};
+    for (std::string part : split_string(list, ","))
+    {
+        if (part.empty() || !isdigit(part[0]))
+        {
+            continue;
+        }
+        size_t dash = part.find('-');
+        int first = std::stoi(part.substr(0, dash));
+        int last = (dash == std::string::npos) ? first : std::stoi(part.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+void append_journal_line(std::string queue_dir, std::string line)
+{
+    // Single short O_APPEND writes, so concurrent writers never interleave within a line.
+    std::string journal = (fs::path(queue_dir) / LOCAL_QUEUE_JOURNAL).string();
+    int fd = open(journal.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        error_log("Unable to open " + journal + " for writing.", 1);
+    }
+    line += "\n";
+    if (write(fd, line.data(), line.size()) != (ssize_t)line.size())
+    {
+        normal_log("Unable to append to " + journal);
+    }
+    close(fd);
+}
+
+void EnqueueLocalJobs(std::string queue_dir, std::vector<std::string> job_dirs)
+{
+    std::error_code ec;
+    fs::create_directories(queue_dir, ec);
+    for (std::string job_dir : job_dirs)
+    {
+        std::string absolute = fs::absolute(job_dir).string();
+        while (absolute.size() > 1 && (absolute.back() == '/' || (absolute.back() == '.' && absolute[absolute.size()-2] == '/')))
+        {
+            absolute.pop_back();
+        }
+        append_journal_line(queue_dir, "add " + absolute);
+    }
+    debug_log("Added " + std::to_string(job_dirs.size()) + " job(s) to the queue in " + queue_dir);
+}
+
+struct LocalQueueState
+{
+    std::string journal = "";
+    uint64_t offset = 0;                        // bytes of the journal already replayed
+    std::vector<std::string> order = {};        // job directories in the order they were added
+    std::map<std::string,std::string> state = {};   // job directory -> add/start/done
+    size_t next = 0;                            // first entry of 'order' that might still be pending
+};
+
+void replay_journal(LocalQueueState &queue)
+{
+    // Only whole lines are replayed; a line still being written is picked up next time.
+    std::ifstream fin(queue.journal, std::ios::in | std::ios::binary);
+    if (!fin.is_open())
+    {
+        return;
+    }
+    fin.seekg(queue.offset);
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (fin.eof())
+        {
+            break;
+        }
+        queue.offset += line.size() + 1;
+        size_t space = line.find(' ');
+        if (space == std::string::npos)
+        {
+            continue;
+        }
+        std::string action = line.substr(0, space);
+        std::string rest = line.substr(space + 1);
+        std::string job_dir = (action == "done") ? rest.substr(0, rest.rfind(' ')) : rest;
+        if (action == "add")
+        {
+            if (queue.state.count(job_dir) == 0 || queue.state[job_dir] == "done")
+            {
+                queue.order.push_back(job_dir);
+            }
+            queue.state[job_dir] = "add";
+        }
+        else if (queue.state.count(job_dir) > 0)
+        {
+            queue.state[job_dir] = action;
+        }
+    }
+}
+
+void RunLocalQueue(std::string queue_dir)
+{
+    // One drainer per queue; the lock is released by the kernel if this process dies.
+    std::error_code ec;
+    fs::create_directories(queue_dir, ec);
+    std::string lock_file = (fs::path(queue_dir) / LOCAL_QUEUE_LOCK).string();
+    int lock_fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        error_log("Another AutoQuantum process is already running the queue in " + queue_dir, 1);
+    }
+
+    LocalQueueState queue;
+    queue.journal = (fs::path(queue_dir) / LOCAL_QUEUE_JOURNAL).string();
+    replay_journal(queue);
+    size_t n_interrupted = 0;
+    for (auto &entry : queue.state)
+    {
+        if (entry.second == "start")
+        {
+            entry.second = "add";
+            n_interrupted++;
+        }
+    }
+    if (n_interrupted > 0)
+    {
+        normal_log("Restarting " + std::to_string(n_interrupted) + " job(s) interrupted in an earlier run of this queue.");
+    }
+
+    std::vector<ExecutorSlot> slots = ExecutorSlots(LOCAL_DEVICES, LOCAL_CPU_SETS, LOCAL_WORKERS);
+    std::string report_file = (fs::path(queue_dir) / LOCAL_QUEUE_REPORT).string();
+    normal_log("Running the queue in " + queue_dir + " with " + std::to_string(slots.size()) + " worker(s).");
+    size_t n_done = 0;
+    RunTaskQueue([&](ExecutorTask &task)
+    {
+        replay_journal(queue);
+        while (queue.next < queue.order.size())
+        {
+            std::string job_dir = queue.order[queue.next++];
+            if (queue.state[job_dir] != "add")
+            {
+                continue;
+            }
+            queue.state[job_dir] = "start";
+            if (!ExecutorTaskFromJobDir(task, job_dir))
+            {
+                normal_log("No TeraChem input found in " + job_dir + ", skipping.");
+                append_journal_line(queue_dir, "done " + job_dir + " -1");
+                queue.state[job_dir] = "done";
+                continue;
+            }
+            append_journal_line(queue_dir, "start " + job_dir);
+            return true;
+        }
+        return false;
+    }, slots, [&](const ExecutorTask &task, const ExecutorResult &result)
+    {
+        append_journal_line(queue_dir, "done " + task.job_dir + " " + std::to_string(result.exit_code));
+        queue.state[task.job_dir] = "done";
+        append_to_file(report_file, ExecutorResultLine(result) + "\n");
+        normal_log(ExecutorResultLine(result));
+        n_done++;
+        if (PrepareRestart(task.job_dir, "", ""))
+        {
+            // Interrupted runs go to the back of the queue with their restart input.
+            append_journal_line(queue_dir, "add " + task.job_dir);
+        }
+    });
+    normal_log("Queue in " + queue_dir + " is empty; ran " + std::to_string(n_done) + " job(s).");
+    close(lock_fd);
+}
@@ -0,0 +1,437 @@
+#include "logger.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string LOG_FILE = "";
+size_t LOG_MAX_BYTES = (size_t)DEFAULT_LOG_ROTATE_MB << 20;
+int LOG_KEEP_FILES = DEFAULT_LOG_KEEP_FILES;
+thread_local const char *LOG_PHASE = nullptr;
+
+// Control records travel through the ring with the messages, so the writer sees
+// a new job directory or log file exactly between the records around the change.
+enum LogControl { LOG_CONTROL_NONE, LOG_CONTROL_JOB_DIR, LOG_CONTROL_FILE };
+
+struct LogSlot
+{
+    std::atomic<size_t> sequence;
+    LogRecord record;
+    int control = LOG_CONTROL_NONE;
+};
+
+// Bounded multi-producer ring (sequence-numbered slots), drained by the one writer thread.
+LogSlot LOG_RING[LOG_RING_CAPACITY];
+std::atomic<size_t> LOG_HEAD(0);
+size_t LOG_TAIL = 0;
+std::atomic<bool> LOG_RUNNING(false);
+std::atomic<bool> LOG_STOPPING(false);
+std::atomic<bool> LOG_WRITER_IDLE(false);
+std::mutex LOG_WAKE_LOCK;
+std::condition_variable LOG_WAKE;
+std::thread *LOG_WRITER = nullptr;
+std::once_flag LOG_START;
+std::mutex LOG_SYNC_LOCK;               // held by whoever writes a batch: the writer thread, or callers once it has stopped
+
+// Writer state, only touched under LOG_SYNC_LOCK.
+std::string LOG_JOB_DIR = "";
+std::string LOG_OPEN_FILE = "";
+int LOG_FD = -1;
+size_t LOG_FILE_BYTES = 0;
+
+std::vector<std::function<void()>> CLEANUP_HOOKS = {};
+std::mutex CLEANUP_LOCK;
+std::atomic<bool> CLEANUP_DONE(false);
+
+bool log_enqueue(LogRecord &record, int control)
+{
+    size_t pos = LOG_HEAD.load(std::memory_order_relaxed);
+    while (true)
+    {
+        LogSlot &slot = LOG_RING[pos % LOG_RING_CAPACITY];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == pos)
+        {
+            if (LOG_HEAD.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot.record = std::move(record);
+                slot.control = control;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (sequence < pos)
+        {
+            return false;   // full
+        }
+        else
+        {
+            pos = LOG_HEAD.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool log_dequeue(LogRecord &record, int &control)
+{
+    LogSlot &slot = LOG_RING[LOG_TAIL % LOG_RING_CAPACITY];
+    if (slot.sequence.load(std::memory_order_acquire) != LOG_TAIL + 1)
+    {
+        return false;
+    }
+    record = std::move(slot.record);
+    control = slot.control;
+    slot.sequence.store(LOG_TAIL + LOG_RING_CAPACITY, std::memory_order_release);
+    LOG_TAIL++;
+    return true;
+}
+
+// Output
+std::string log_level_name(LogLevel level)
+{
+    switch (level)
+    {
+        case LOG_DEBUG: return "debug";
+        case LOG_ERROR: return "error";
+        default:        return "info";
+    }
+}
+
+std::string log_record_json(const LogRecord &record)
+{
+    time_t seconds = record.time_us / 1000000;
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "{\"time\": \"" << stamp << "." << std::setw(6) << std::setfill('0') << record.time_us % 1000000 << "Z\", \"level\": \"" << log_level_name(record.level)
+           << "\", \"pid\": " << getpid() << ", \"job_dir\": \"" << json_escape(LOG_JOB_DIR) << "\", \"phase\": \"" << (record.phase != nullptr ? record.phase : "")
+           << "\", \"message\": \"" << json_escape(record.message) << "\"}\n";
+    return buffer.str();
+}
+
+void open_log_file(std::string filename)
+{
+    if (LOG_FD >= 0)
+    {
+        close(LOG_FD);
+    }
+    LOG_OPEN_FILE = filename;
+    LOG_FD = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    struct stat info;
+    LOG_FILE_BYTES = (LOG_FD >= 0 && fstat(LOG_FD, &info) == 0) ? info.st_size : 0;
+}
+
+void rotate_log_file()
+{
+    // <file> becomes <file>.1, <file>.1 becomes <file>.2, ... and the oldest is dropped.
+    close(LOG_FD);
+    LOG_FD = -1;
+    for (int k = LOG_KEEP_FILES - 1; k >= 1; k--)
+    {
+        rename((LOG_OPEN_FILE + "." + std::to_string(k)).c_str(), (LOG_OPEN_FILE + "." + std::to_string(k + 1)).c_str());
+    }
+    if (LOG_KEEP_FILES > 0)
+    {
+        rename(LOG_OPEN_FILE.c_str(), (LOG_OPEN_FILE + ".1").c_str());
+    }
+    else
+    {
+        unlink(LOG_OPEN_FILE.c_str());
+    }
+    open_log_file(LOG_OPEN_FILE);
+}
+
+void write_log_json(const std::string &json)
+{
+    if (LOG_FD < 0 || json.empty())
+    {
+        return;
+    }
+    // Fill the current file up to the limit with whole records, then rotate and go on.
+    size_t start = 0;
+    while (start < json.size() && LOG_FD >= 0)
+    {
+        size_t room = (LOG_MAX_BYTES > LOG_FILE_BYTES) ? LOG_MAX_BYTES - LOG_FILE_BYTES : 0;
+        size_t end = json.size();
+        if (end - start > room)
+        {
+            size_t cut = (room > 0) ? json.rfind('\n', start + room - 1) : std::string::npos;
+            if (cut == std::string::npos || cut < start)
+            {
+                if (LOG_FILE_BYTES > 0)
+                {
+                    rotate_log_file();
+                    continue;
+                }
+                cut = json.find('\n', start);     // one record larger than the limit
+            }
+            end = cut + 1;
+        }
+        ssize_t n = write(LOG_FD, json.data() + start, end - start);
+        LOG_FILE_BYTES += (n > 0) ? n : 0;
+        start = end;
+    }
+}
+
+void write_log_batch(std::vector<LogRecord> &records, std::vector<int> &controls)
+{
+    // One write per stream per batch instead of a flush per line.
+    std::string out = "", err = "", json = "";
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        LogRecord &record = records[i];
+        if (controls[i] == LOG_CONTROL_JOB_DIR)
+        {
+            LOG_JOB_DIR = record.message;
+            continue;
+        }
+        if (controls[i] == LOG_CONTROL_FILE)
+        {
+            write_log_json(json);
+            json.clear();
+            open_log_file(record.message);
+            continue;
+        }
+        if (record.level == LOG_ERROR)
+        {
+            err += record.message + "\n";
+        }
+        else
+        {
+            out += (record.level == LOG_DEBUG ? "DEBUG: " : "") + record.message + "\n";
+        }
+        if (LOG_FD >= 0)
+        {
+            json += log_record_json(record);
+        }
+    }
+    if (!out.empty())
+    {
+        std::cout << out;
+        std::cout.flush();
+    }
+    if (!err.empty())
+    {
+        std::cerr << err;
+        std::cerr.flush();
+    }
+    write_log_json(json);
+}
+
+size_t drain_log_ring(size_t max_records)
+{
+    std::vector<LogRecord> records = {};
+    std::vector<int> controls = {};
+    LogRecord record;
+    int control = LOG_CONTROL_NONE;
+    while (records.size() < max_records && log_dequeue(record, control))
+    {
+        records.push_back(std::move(record));
+        controls.push_back(control);
+    }
+    if (!records.empty())
+    {
+        std::lock_guard<std::mutex> guard(LOG_SYNC_LOCK);
+        write_log_batch(records, controls);
+    }
+    return records.size();
+}
+
+void log_writer_thread()
+{
+    while (true)
+    {
+        if (drain_log_ring(LOG_RING_CAPACITY) > 0)
+        {
+            continue;
+        }
+        if (LOG_STOPPING.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        LOG_WRITER_IDLE.store(true);
+        {
+            std::unique_lock<std::mutex> lock(LOG_WAKE_LOCK);
+            LOG_WAKE.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_WAIT_MS));
+        }
+        LOG_WRITER_IDLE.store(false);
+    }
+}
+
+void logging_at_exit()
+{
+    RunCleanupHooks();
+    ShutdownLogging();
+}
+
+void start_logging()
+{
+    for (size_t i = 0; i < LOG_RING_CAPACITY; i++)
+    {
+        LOG_RING[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    std::error_code ec;
+    LOG_JOB_DIR = fs::current_path(ec).string();
+    LOG_WRITER = new std::thread(log_writer_thread);
+    LOG_RUNNING.store(true, std::memory_order_release);     // published last, so ShutdownLogging sees the writer
+    atexit(logging_at_exit);
+}
+
+void log_submit(LogRecord &record, int control)
+{
+    std::call_once(LOG_START, start_logging);
+    if (!LOG_RUNNING.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> guard(LOG_SYNC_LOCK);
+        std::vector<LogRecord> records = {record};
+        std::vector<int> controls = {control};
+        write_log_batch(records, controls);
+        return;
+    }
+    while (!log_enqueue(record, control))
+    {
+        // Full: wait for the writer rather than drop anything.
+        LOG_WAKE.notify_one();
+        std::this_thread::yield();
+    }
+    if (LOG_WRITER_IDLE.load(std::memory_order_relaxed))
+    {
+        LOG_WAKE.notify_one();
+    }
+}
+
+// Interface
+void LogMessage(LogLevel level, std::string message)
+{
+    LogRecord record;
+    record.level = level;
+    record.time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record.phase = LOG_PHASE;
+    record.message = std::move(message);
+    log_submit(record, LOG_CONTROL_NONE);
+}
+
+void SetLogJobDirectory(std::string job_dir)
+{
+    LogRecord record;
+    std::error_code ec;
+    fs::path path = fs::canonical(job_dir, ec);
+    record.message = ec ? fs::absolute(job_dir).string() : path.string();
+    log_submit(record, LOG_CONTROL_JOB_DIR);
+}
+
+void ShutdownLogging()
+{
+    // Stop the writer, then drain whatever was still being put into the ring from here.
+    if (!LOG_RUNNING.exchange(false))
+    {
+        return;
+    }
+    LOG_STOPPING.store(true, std::memory_order_release);
+    LOG_WAKE.notify_one();
+    LOG_WRITER->join();
+    for (int spins = 0; LOG_TAIL < LOG_HEAD.load(std::memory_order_acquire) && spins < 10000; spins++)
+    {
+        if (drain_log_ring(LOG_RING_CAPACITY) == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    std::lock_guard<std::mutex> guard(LOG_SYNC_LOCK);
+    if (LOG_FD >= 0)
+    {
+        close(LOG_FD);
+        LOG_FD = -1;
+    }
+}
+
+void AddCleanupHook(std::function<void()> hook)
+{
+    std::lock_guard<std::mutex> guard(CLEANUP_LOCK);
+    CLEANUP_HOOKS.push_back(hook);
+}
+
+void RunCleanupHooks()
+{
+    // Most recent first, and only once, whether AutoQuantum returns, exits or stops on an error.
+    if (CLEANUP_DONE.exchange(true))
+    {
+        return;
+    }
+    std::vector<std::function<void()>> hooks;
+    {
+        std::lock_guard<std::mutex> guard(CLEANUP_LOCK);
+        hooks = CLEANUP_HOOKS;
+    }
+    for (auto hook = hooks.rbegin(); hook != hooks.rend(); hook++)
+    {
+        (*hook)();
+    }
+}
+
+// Logging Flags (--log_file <path> [--log_max_mb N] [--log_keep N])
+void check_log_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    const char *environment = getenv("AUTOQUANTUM_LOG_FILE");
+    if (environment != nullptr && !is_empty(environment))
+    {
+        LOG_FILE = environment;
+    }
+    if (flags.count("log_file") > 0)
+    {
+        if (!flags["log_file"].empty())
+        {
+            LOG_FILE = flags["log_file"][0];
+        }
+        flags.erase("log_file");
+    }
+    if (flags.count("log_max_mb") > 0)
+    {
+        if (!flags["log_max_mb"].empty())
+        {
+            LOG_MAX_BYTES = (size_t)(std::max(1.0, std::stod(flags["log_max_mb"][0])) * (1 << 20));
+        }
+        flags.erase("log_max_mb");
+    }
+    if (flags.count("log_keep") > 0)
+    {
+        if (!flags["log_keep"].empty())
+        {
+            LOG_KEEP_FILES = std::max(0, std::stoi(flags["log_keep"][0]));
+        }
+        flags.erase("log_keep");
+    }
+    if (!LOG_FILE.empty())
+    {
+        // Absolute, so changing into a job directory does not move it; exported for AutoQuantum processes started later.
+        LOG_FILE = fs::absolute(LOG_FILE).string();
+        setenv("AUTOQUANTUM_LOG_FILE", LOG_FILE.c_str(), 1);
+        LogRecord record;
+        record.message = LOG_FILE;
+        log_submit(record, LOG_CONTROL_FILE);
+    }
+}
+
+// LOGGING FUNCTIONS - Normal, Error, Debug-flagged.
+void error_log(std::string message, int exit_code)
+{
+    LogMessage(LOG_ERROR, message);
+    RunCleanupHooks();
+    ShutdownLogging();
+    exit(exit_code);
+}
+void normal_log(std::string message)
+{
+    LogMessage(LOG_INFO, message);
+}
+void debug_log(std::string message)
+{
+    if (DEBUG)
+    {
+        LogMessage(LOG_DEBUG, message);
+    }
+}
@@ -1,5 +1,24 @@
 #include "utilities.h"
 #include "tcinterface.h"
+#include "campaign.h"
+#include "tcoutput.h"
+#include "trajectory.h"
+#include "adaptive.h"
+#include "chain.h"
+#include "archive.h"
+#include "resultcache.h"
+#include "resources.h"
+#include "executor.h"
+#include "localqueue.h"
+#include "monitor.h"
+#include "restart.h"
+#include "amber.h"
+#include "export.h"
+#include "thermo.h"
+#include "fdhessian.h"
+#include "neb.h"
+#include "trace.h"
+#include "logger.h"
 
 int main (int argc, char** argv)
 {
@@ -10,11 +29,170 @@ int main (int argc, char** argv)
     std::map<std::string, std::string> keywords = {};
 
     // Command Line Parse, includes checking for debug mode.
+    int64_t parse_start = trace_clock_us();
     parse_command_line_arguments(flags, argc, argv);
     debug_log("Parsed command line arguments to 'flags' variable.");
 
-    // Write TeraChem input for given flags
-    Write_TC_Input(flags, keywords);
+    // A JSON-lines log file, if asked for, and phase timings, written at exit when --trace is given.
+    check_log_flags(flags);
+    check_trace_flags(flags);
+    if (TRACE)
+    {
+        RecordTraceEvent("parse_arguments", parse_start, trace_clock_us());
+    }
+    if (!TRACE_REPORT_DIR.empty())
+    {
+        RunTraceReportMode();
+        return 0;
+    }
+
+    // Result cache and resource autotuning switches apply to every mode that prepares jobs.
+    check_result_cache_flags(flags);
+    check_resource_flags(flags);
+    check_local_queue_flags(flags);
+    check_restart_flags(flags);
+    check_qm_region_flags(flags);
+
+    // Without SLURM, a local queue of prepared jobs is drained by several workers.
+    if (!RUN_QUEUE_DIR.empty())
+    {
+        RunLocalQueue(RUN_QUEUE_DIR);
+        return 0;
+    }
+
+    // Restart check looks at a finished run and resubmits it if it was cut short.
+    if (!RESTART_CHECK_DIR.empty())
+    {
+        RunRestartCheckMode();
+        return 0;
+    }
+
+    // Status and watch modes report on submitted SLURM jobs.
+    check_monitor_mode(flags);
+    if (STATUS_MODE || WATCH_MODE)
+    {
+        RunMonitorMode();
+        return 0;
+    }
+
+    // Parse mode only reads an existing TeraChem output back into a results record.
+    check_parse_mode(flags);
+    if (!PARSE_TARGET.empty())
+    {
+        RunParseMode();
+        return 0;
+    }
+
+    // Export mode appends parsed results to a columnar file for AutoAnalytics.
+    check_export_mode(flags);
+    if (!EXPORT_DIRS.empty())
+    {
+        RunExportMode();
+        return 0;
+    }
+
+    // Thermochemistry mode turns finished frequency jobs into ZPE, enthalpy and free energy corrections.
+    check_thermo_mode(flags);
+    if (!THERMO_DIRS.empty())
+    {
+        RunThermoMode();
+        return 0;
+    }
+
+    // Archive modes pack a finished job directory, or pull one file back out of an archive.
+    check_archive_mode(flags);
+    if (!ARCHIVE_TARGET.empty() || !EXTRACT_REQUEST.empty())
+    {
+        RunArchiveMode();
+        return 0;
+    }
+
+    // Pack workers run a slice of a campaign's jobs inside one GPU allocation.
+    check_pack_worker_mode(flags);
+    if (!PACK_WORKER_DIR.empty())
+    {
+        RunPackWorkerMode();
+        return 0;
+    }
+
+    // Frame extraction pulls a single geometry out of a trajectory through its frame index.
+    check_extract_frame_mode(flags);
+    if (!EXTRACT_TRAJECTORY.empty())
+    {
+        RunExtractFrameMode();
+        return 0;
+    }
+
+    // Adaptive Restraints drives its own sequence of restrained optimizations.
+    check_adaptive_mode(flags);
+    if (!ADAPTIVE_RESUME_DIR.empty())
+    {
+        fs::current_path(ADAPTIVE_RESUME_DIR);
+        SetLogJobDirectory(".");
+        RunAdaptiveCycles();
+        return 0;
+    }
+    if (ADAPTIVE)
+    {
+        RunAdaptiveRestraints(flags);
+        return 0;
+    }
+
+    // Chained runs carry geometry and orbitals from one calculation type to the next.
+    check_chain_mode(flags);
+    if (!CHAIN_RESUME_DIR.empty())
+    {
+        fs::current_path(CHAIN_RESUME_DIR);
+        SetLogJobDirectory(".");
+        RunChainSteps();
+        return 0;
+    }
+    if (!CHAIN.empty())
+    {
+        RunChain(flags);
+        return 0;
+    }
+
+    // Campaign mode builds and submits a whole set of structures at once.
+    check_campaign_mode(flags);
+    if (CAMPAIGN)
+    {
+        RunCampaign(flags);
+        debug_log("RunCampaign() completed.");
+        return 0;
+    }
+
+    // Finite-difference Hessians spread the displaced gradients of a frequency job over many GPUs.
+    check_fd_hessian_mode(flags);
+    if (!FD_RESUME_DIR.empty())
+    {
+        ResumeFDHessian(FD_RESUME_DIR);
+        return 0;
+    }
+    if (FD_HESSIAN)
+    {
+        RunFDHessian(flags);
+        return 0;
+    }
+
+    // A band driven by AutoQuantum runs the image gradients of each iteration side by side.
+    check_neb_mode(flags);
+    if (!NEB_RESUME_DIR.empty())
+    {
+        RunNEBIterations(NEB_RESUME_DIR);
+        return 0;
+    }
+    if (NEB)
+    {
+        RunNEB(flags);
+        return 0;
+    }
+
+    // Write TeraChem input for given flags, unless the result cache already has this calculation.
+    if (!Write_TC_Input(flags, keywords))
+    {
+        return 0;
+    }
     debug_log("Write_TC_Input() completed.");
 
     // If the dryrun flag was included on the command line, we'll just generate the input files and work directory, but not run the TeraChem calculation.
@@ -25,18 +203,27 @@ int main (int argc, char** argv)
     }
 
     // Check if on warrior, then either submit a TC Job script or run directly.
-    std::string hostname = GetSysResponse("hostname");
-    if (hostname.find("warrior") != std::string::npos)
+    if (UseSlurmSubmission())
     {
         debug_log("Submitting batch job to SLURM queue.");
         // Submit SLURM job.
         SubmitSlurmJob(keywords);
     }
+    else if (!LOCAL_QUEUE_DIR.empty())
+    {
+        // Leave the job for a local queue runner.
+        EnqueueLocalJobs(LOCAL_QUEUE_DIR, {fs::current_path().string()});
+        normal_log("Added to the queue in " + LOCAL_QUEUE_DIR + "; run 'autoquantum --run_queue " + LOCAL_QUEUE_DIR + "' to work through it.");
+    }
     else
     {
         debug_log("Running terachem directly.");
-        // Run TeraChem input file directly.
+        // Run TeraChem input file directly, again from the last geometry if it is interrupted.
         RunTeraChem();
+        while (PrepareRestart(".", "", ""))
+        {
+            RunTeraChem();
+        }
     }
     
     // And we're done.
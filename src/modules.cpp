@@ -0,0 +1,238 @@
+#include "modules.h"
+#include "process.h"
+#include "trace.h"
+#include <unistd.h>
+#include <chrono>
+#include <mutex>
+
+std::string module_cache_directory()
+{
+    return autoquantum_cache_directory() + "modules/";
+}
+
+std::string find_modulefile(std::string module)
+{
+    // Tcl modulefiles have no extension, Lmod ones end in .lua.
+    const char *module_path = getenv("MODULEPATH");
+    if (module_path == nullptr)
+    {
+        return "";
+    }
+    for (std::string dir : split_string(module_path, ":"))
+    {
+        for (std::string candidate : {dir + "/" + module, dir + "/" + module + ".lua"})
+        {
+            if (!dir.empty() && fs::is_regular_file(candidate))
+            {
+                return candidate;
+            }
+        }
+    }
+    return "";
+}
+
+std::map<std::string,std::string> parse_environment_block(std::string block)
+{
+    // 'env -0' output: NUL-separated KEY=VALUE entries.
+    std::map<std::string,std::string> environment = {};
+    size_t start = 0;
+    while (start < block.size())
+    {
+        size_t end = block.find('\0', start);
+        if (end == std::string::npos)
+        {
+            end = block.size();
+        }
+        std::string entry = block.substr(start, end - start);
+        size_t eq = entry.find('=');
+        if (eq != std::string::npos && eq > 0)
+        {
+            environment[entry.substr(0, eq)] = entry.substr(eq + 1);
+        }
+        start = end + 1;
+    }
+    return environment;
+}
+
+bool read_module_cache(ModuleEnvironment &environment, std::string filename)
+{
+    std::ifstream fin(filename);
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        std::stringstream fields(line);
+        std::string kind, key, value;
+        fields >> kind >> key;
+        std::getline(fields, value);
+        if (!value.empty() && value[0] == ' ')
+        {
+            value.erase(0, 1);
+        }
+        if (kind == "module") environment.module = key;
+        else if (kind == "mtime")
+        {
+            // A damaged snapshot is a cache miss.
+            char *end = nullptr;
+            environment.mtime = strtoll(key.c_str(), &end, 10);
+            if (key.empty() || *end != '\0')
+            {
+                return false;
+            }
+        }
+        else if (kind == "prepend") environment.prepend[key] = value;
+        else if (kind == "set") environment.set[key] = value;
+    }
+    fin.close();
+    environment.resolved = true;
+    return true;
+}
+
+void write_module_cache(const ModuleEnvironment &environment, std::string filename)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "module " << environment.module << std::endl;
+    buffer << "mtime " << environment.mtime << std::endl;
+    for (auto &variable : environment.prepend)
+    {
+        buffer << "prepend " << variable.first << " " << variable.second << std::endl;
+    }
+    for (auto &variable : environment.set)
+    {
+        buffer << "set " << variable.first << " " << variable.second << std::endl;
+    }
+    // Write then rename, so concurrent invocations never read a half-written snapshot.
+    std::string temporary = filename + "." + std::to_string(getpid());
+    write_to_file(temporary, buffer.str());
+    std::error_code ec;
+    fs::rename(temporary, filename, ec);
+}
+
+std::map<std::string,ModuleEnvironment> RESOLVED_MODULES = {};
+std::mutex RESOLVED_MODULES_LOCK;      // jobs resolve modules from several threads; one 'module load' per module
+
+ModuleEnvironment ResolveModuleEnvironment(std::string module)
+{
+    TraceScope trace("load_module");
+    std::lock_guard<std::mutex> guard(RESOLVED_MODULES_LOCK);
+    if (RESOLVED_MODULES.count(module) > 0)
+    {
+        return RESOLVED_MODULES[module];
+    }
+    ModuleEnvironment environment;
+    environment.module = module;
+
+    // Without a modulefile (no MODULEPATH, or not found on it) nothing tells a stale snapshot apart,
+    // so the disk cache is not used and the module is loaded once per process.
+    std::string modulefile = find_modulefile(module);
+    std::error_code mtime_ec;
+    fs::file_time_type written = modulefile.empty() ? fs::file_time_type() : fs::last_write_time(modulefile, mtime_ec);
+    bool cacheable = !modulefile.empty() && !mtime_ec;
+    if (cacheable)
+    {
+        environment.mtime = std::chrono::duration_cast<std::chrono::seconds>(written.time_since_epoch()).count();
+    }
+
+    std::string cache_name = module;
+    std::replace(cache_name.begin(), cache_name.end(), '/', '_');
+    std::string cache_file = module_cache_directory() + cache_name + ".env";
+    ModuleEnvironment cached;
+    if (cacheable && read_module_cache(cached, cache_file) && cached.module == module && cached.mtime == environment.mtime)
+    {
+        debug_log("Using cached environment for module " + module);
+        RESOLVED_MODULES[module] = cached;
+        return cached;
+    }
+
+    // Cache miss: pay for one 'module load' and keep only what it changed.
+    debug_log("Resolving environment for module " + module);
+    ProcessOptions options;
+    options.capture = true;
+    Process process = RunProcess({"/bin/sh", "-c", "module load " + module + " >/dev/null 2>&1 && env -0"}, options);
+    if (process.exit_code != 0)
+    {
+        debug_log("Unable to load module " + module);
+        return environment;
+    }
+    std::map<std::string,std::string> loaded = parse_environment_block(process.output);
+    for (auto &variable : loaded)
+    {
+        const char *current = getenv(variable.first.c_str());
+        std::string before = (current != nullptr) ? current : "";
+        if (variable.second == before || variable.first == "_" || variable.first == "SHLVL" || variable.first == "PWD" || variable.first.substr(0, 9) == "BASH_FUNC" || variable.second.find('\n') != std::string::npos)
+        {
+            continue;
+        }
+        // Path-like variables that only gained a prefix are stored as a prepend, so the snapshot stays valid for other base environments.
+        std::string suffix = ":" + before;
+        if (!before.empty() && variable.second.size() > suffix.size() && variable.second.compare(variable.second.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            environment.prepend[variable.first] = variable.second.substr(0, variable.second.size() - suffix.size());
+        }
+        else
+        {
+            environment.set[variable.first] = variable.second;
+        }
+    }
+    environment.resolved = true;
+    if (cacheable)
+    {
+        std::error_code ec;
+        fs::create_directories(module_cache_directory(), ec);
+        write_module_cache(environment, cache_file);
+    }
+    else
+    {
+        debug_log("No modulefile found for " + module + " on MODULEPATH; its environment is not cached on disk.");
+    }
+    RESOLVED_MODULES[module] = environment;
+    return environment;
+}
+
+std::map<std::string,std::string> ModuleProcessEnvironment(const ModuleEnvironment &environment)
+{
+    // Variables to hand to ProcessOptions::environment.
+    std::map<std::string,std::string> variables = environment.set;
+    for (auto &variable : environment.prepend)
+    {
+        const char *current = getenv(variable.first.c_str());
+        variables[variable.first] = (current != nullptr && *current != '\0') ? variable.second + ":" + current : variable.second;
+    }
+    return variables;
+}
+
+std::string shell_quote(std::string value)
+{
+    std::string quoted = "'";
+    for (char c : value)
+    {
+        quoted += (c == '\'') ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+std::string ModuleScriptLines(std::string module)
+{
+    // Batch scripts get the snapshot as exports; 'module load' is only the fallback.
+    ModuleEnvironment environment = ResolveModuleEnvironment(module);
+    if (!environment.resolved)
+    {
+        return "module load " + module + "\n";
+    }
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "# Environment of module " << module << ", cached by AutoQuantum" << std::endl;
+    for (auto &variable : environment.set)
+    {
+        buffer << "export " << variable.first << "=" << shell_quote(variable.second) << std::endl;
+    }
+    for (auto &variable : environment.prepend)
+    {
+        buffer << "export " << variable.first << "=" << shell_quote(variable.second) << "${" << variable.first << ":+:$" << variable.first << "}" << std::endl;
+    }
+    return buffer.str();
+}
@@ -0,0 +1,527 @@
+#include "monitor.h"
+#include "restart.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <chrono>
+
+bool STATUS_MODE = false;
+bool WATCH_MODE = false;
+int WATCH_INTERVAL = MONITOR_DEFAULT_INTERVAL;
+std::vector<std::string> MONITOR_DIRS = {};
+std::string MONITOR_NOTIFY = "";
+
+void check_monitor_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    for (std::string mode : {"status", "watch"})
+    {
+        if (flags.count(mode) > 0)
+        {
+            (mode == "status" ? STATUS_MODE : WATCH_MODE) = true;
+            MONITOR_DIRS.insert(MONITOR_DIRS.end(), flags[mode].begin(), flags[mode].end());
+            flags.erase(mode);
+        }
+    }
+    if (flags.count("watch_interval") > 0)
+    {
+        if (!flags["watch_interval"].empty())
+        {
+            WATCH_INTERVAL = std::max(1, std::stoi(flags["watch_interval"][0]));
+        }
+        flags.erase("watch_interval");
+    }
+    if (flags.count("notify") > 0)
+    {
+        if (!flags["notify"].empty())
+        {
+            MONITOR_NOTIFY = flags["notify"][0];
+        }
+        flags.erase("notify");
+    }
+}
+
+std::string ParseSbatchJobId(std::string response)
+{
+    // "Submitted batch job 12345", or just "12345" with --parsable.
+    std::string marker = "Submitted batch job ";
+    size_t start = response.find(marker);
+    start = (start == std::string::npos) ? response.find_first_of("0123456789") : start + marker.size();
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+    size_t end = response.find_first_not_of("0123456789", start);
+    return response.substr(start, end - start);
+}
+
+std::string job_registry_file()
+{
+    return autoquantum_cache_directory() + "jobs.txt";
+}
+
+int lock_job_registry()
+{
+    std::error_code ec;
+    fs::create_directories(autoquantum_cache_directory(), ec);
+    int fd = open(job_registry_file().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void RecordSubmittedJob(std::string job_id, std::string job_dir)
+{
+    std::string absolute = fs::absolute(job_dir).string();
+    while (absolute.size() > 1 && (absolute.back() == '/' || (absolute.back() == '.' && absolute[absolute.size()-2] == '/')))
+    {
+        absolute.pop_back();
+    }
+    append_to_file((fs::path(absolute) / JOB_ID_FILE).string(), job_id + "\n");
+    int fd = lock_job_registry();
+    if (fd < 0)
+    {
+        return;
+    }
+    std::string line = job_id + " " + absolute + "\n";
+    if (write(fd, line.data(), line.size()) != (ssize_t)line.size())
+    {
+        debug_log("Unable to append to " + job_registry_file());
+    }
+    close(fd);
+}
+
+std::string newest_tc_output(std::string job_dir)
+{
+    // Chains leave several outputs behind; the most recently written one shows current progress.
+    std::string newest = "";
+    fs::file_time_type newest_time;
+    std::error_code ec;
+    for (fs::directory_iterator it(job_dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        std::string name = it->path().filename().string();
+        if (name.rfind("tc_", 0) == 0 && it->path().extension() == ".out")
+        {
+            fs::file_time_type written = fs::last_write_time(it->path(), ec);
+            if (newest.empty() || written > newest_time)
+            {
+                newest = it->path().string();
+                newest_time = written;
+            }
+        }
+    }
+    return newest;
+}
+
+std::vector<TrackedJob> ReadTrackedJobs(std::vector<std::string> job_dirs)
+{
+    // Job directories name their own IDs; without any, everything in the registry is tracked.
+    std::vector<std::pair<std::string,std::string>> entries = {};
+    if (job_dirs.empty())
+    {
+        std::ifstream fin(job_registry_file());
+        std::string job_id, job_dir;
+        while (fin >> job_id && std::getline(fin >> std::ws, job_dir))
+        {
+            entries.push_back({job_id, job_dir});
+        }
+    }
+    for (std::string job_dir : job_dirs)
+    {
+        std::ifstream fin((fs::path(job_dir) / JOB_ID_FILE).string());
+        std::string job_id;
+        bool found = false;
+        while (fin >> job_id)
+        {
+            entries.push_back({job_id, fs::absolute(job_dir).string()});
+            found = true;
+        }
+        if (!found)
+        {
+            normal_log("No SLURM job ID recorded in " + job_dir);
+        }
+    }
+    std::vector<TrackedJob> jobs = {};
+    std::set<std::string> seen = {};
+    for (auto &entry : entries)
+    {
+        if (seen.count(entry.first) > 0 || !fs::is_directory(entry.second))
+        {
+            continue;
+        }
+        seen.insert(entry.first);
+        TrackedJob job;
+        job.job_id = entry.first;
+        job.job_dir = entry.second;
+        job.output = newest_tc_output(job.job_dir);
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+bool IsTerminalState(std::string state)
+{
+    static const std::set<std::string> terminal = {"COMPLETED", "FAILED", "CANCELLED", "TIMEOUT", "PREEMPTED", "NODE_FAIL", "OUT_OF_MEMORY", "BOOT_FAIL", "DEADLINE"};
+    return terminal.count(state) > 0;
+}
+
+std::string summarize_task_states(const std::map<std::string,int> &counts, std::string &tasks)
+{
+    // Array jobs are running while any task runs, pending while any waits, and otherwise report their worst outcome.
+    tasks = "";
+    int n_tasks = 0;
+    for (auto &count : counts)
+    {
+        tasks += (tasks.empty() ? "" : " ") + count.first + "=" + std::to_string(count.second);
+        n_tasks += count.second;
+    }
+    if (n_tasks <= 1)
+    {
+        tasks = "";
+    }
+    for (std::string state : {"RUNNING", "COMPLETING", "CONFIGURING", "PENDING", "REQUEUED", "SUSPENDED"})
+    {
+        if (counts.count(state) > 0)
+        {
+            return state;
+        }
+    }
+    for (auto &count : counts)
+    {
+        if (count.first != "COMPLETED")
+        {
+            return count.first;
+        }
+    }
+    return "COMPLETED";
+}
+
+void QuerySlurmStates(std::vector<TrackedJob> &jobs)
+{
+    // One squeue call for all jobs; one sacct call for the ones squeue no longer knows.
+    if (jobs.empty())
+    {
+        return;
+    }
+    std::string id_list = "";
+    for (TrackedJob &job : jobs)
+    {
+        id_list += (id_list.empty() ? "" : ",") + job.job_id;
+    }
+    ProcessOptions options;
+    options.capture = true;
+    std::map<std::string,std::map<std::string,int>> counts = {};
+    Process squeue = RunProcess({"squeue", "-h", "-r", "-o", "%i %T", "-j", id_list}, options);
+    for (std::string line : split_string(squeue.output, "\n"))
+    {
+        std::stringstream buffer(line);
+        std::string id, state;
+        if (buffer >> id >> state)
+        {
+            counts[id.substr(0, id.find('_'))][state]++;
+        }
+    }
+
+    std::string missing = "";
+    for (TrackedJob &job : jobs)
+    {
+        if (counts.count(job.job_id) == 0)
+        {
+            missing += (missing.empty() ? "" : ",") + job.job_id;
+        }
+    }
+    if (!missing.empty())
+    {
+        Process sacct = RunProcess({"sacct", "-n", "-P", "-X", "-o", "JobID,State", "-j", missing}, options);
+        for (std::string line : split_string(sacct.output, "\n"))
+        {
+            std::vector<std::string> fields = split_string(line, "|");
+            if (fields.size() < 2 || fields[0].empty())
+            {
+                continue;
+            }
+            std::string state = fields[1].substr(0, fields[1].find(' '));
+            counts[fields[0].substr(0, fields[0].find('_'))][state]++;
+        }
+    }
+
+    for (TrackedJob &job : jobs)
+    {
+        if (counts.count(job.job_id) > 0)
+        {
+            job.state = summarize_task_states(counts[job.job_id], job.tasks);
+        }
+    }
+}
+
+bool output_changed(TrackedJob &job)
+{
+    // Follows the newest tc_*.out, and reports whether it was written since it was last looked at.
+    std::string output = newest_tc_output(job.job_dir);
+    if (output.empty())
+    {
+        return false;
+    }
+    if (output != job.output)
+    {
+        job.output = output;
+        job.progress = TCOutputResults();
+        job.output_time = fs::file_time_type();
+        job.output_size = 0;
+    }
+    std::error_code time_ec, size_ec;
+    fs::file_time_type written = fs::last_write_time(output, time_ec);
+    uintmax_t size = fs::file_size(output, size_ec);
+    if (time_ec || size_ec || (written == job.output_time && size == job.output_size))
+    {
+        return false;
+    }
+    job.output_time = written;
+    job.output_size = size;
+    return true;
+}
+
+bool update_job_progress(TrackedJob &job)
+{
+    // Incremental: only the bytes written since the last call are parsed.
+    if (job.output.empty() || !fs::exists(job.output))
+    {
+        return false;
+    }
+    int steps = job.progress.opt_steps;
+    double energy = job.progress.final_energy;
+    bool finished = job.progress.finished;
+    if (job.progress.offset == 0)
+    {
+        ReadTCResultsBinary(job.progress, job.output + ".aqres");
+    }
+    parse_tc_output_from(job.progress, job.output);
+    return steps != job.progress.opt_steps || energy != job.progress.final_energy || finished != job.progress.finished;
+}
+
+std::string job_progress_text(const TrackedJob &job)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    if (job.progress.opt_steps > 0)
+    {
+        buffer << "step " << job.progress.opt_steps << " ";
+    }
+    if (job.progress.has_energy)
+    {
+        buffer << std::fixed << std::setprecision(8) << job.progress.final_energy << " ";
+    }
+    if (!job.progress.errors.empty())
+    {
+        buffer << "errors=" << job.progress.errors.size() << " ";
+    }
+    if (job.progress.finished)
+    {
+        buffer << "finished";
+    }
+    return buffer.str();
+}
+
+std::string JobStatusTable(const std::vector<TrackedJob> &jobs)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::left << std::setw(12) << "JOBID" << std::setw(12) << "STATE" << std::setw(36) << "PROGRESS" << "DIRECTORY" << std::endl;
+    for (const TrackedJob &job : jobs)
+    {
+        std::string progress = job.tasks.empty() ? job_progress_text(job) : job.tasks;
+        buffer << std::left << std::setw(12) << job.job_id << std::setw(12) << job.state << std::setw(36) << progress << job.job_dir << std::endl;
+    }
+    return buffer.str();
+}
+
+void report_job_change(const TrackedJob &job, std::string old_state)
+{
+    normal_log(GetTimeAndDate() + "  " + job.job_id + "  " + old_state + " -> " + job.state + "  " + job.job_dir);
+    if (!MONITOR_NOTIFY.empty())
+    {
+        RunProcess({MONITOR_NOTIFY, job.job_id, job.state, job.job_dir});
+    }
+}
+
+void forget_finished_jobs(const std::vector<TrackedJob> &jobs)
+{
+    // Finished jobs leave the registry; their directories keep the ID for --status <dir>.
+    std::set<std::string> finished = {};
+    for (const TrackedJob &job : jobs)
+    {
+        if (IsTerminalState(job.state))
+        {
+            finished.insert(job.job_id);
+        }
+    }
+    if (finished.empty())
+    {
+        return;
+    }
+    int fd = lock_job_registry();
+    if (fd < 0)
+    {
+        return;
+    }
+    std::ifstream fin(job_registry_file());
+    std::string line, kept = "";
+    while (std::getline(fin, line))
+    {
+        if (!line.empty() && finished.count(line.substr(0, line.find(' '))) == 0)
+        {
+            kept += line + "\n";
+        }
+    }
+    fin.close();
+    if (ftruncate(fd, 0) != 0 || write(fd, kept.data(), kept.size()) != (ssize_t)kept.size())
+    {
+        debug_log("Unable to rewrite " + job_registry_file());
+    }
+    close(fd);
+}
+
+void RunMonitorMode()
+{
+    std::vector<TrackedJob> jobs = ReadTrackedJobs(MONITOR_DIRS);
+    if (jobs.empty())
+    {
+        normal_log("No tracked SLURM jobs.");
+        return;
+    }
+    QuerySlurmStates(jobs);
+    for (TrackedJob &job : jobs)
+    {
+        if (output_changed(job))
+        {
+            update_job_progress(job);
+        }
+    }
+    normal_log(JobStatusTable(jobs));
+    if (MONITOR_DIRS.empty())
+    {
+        forget_finished_jobs(jobs);
+    }
+    if (!WATCH_MODE)
+    {
+        return;
+    }
+
+    // Watch: every interval, outputs whose modification time or size moved are re-read and SLURM is asked once.
+    // inotify only shortens the wait for outputs written on this host.
+    std::vector<TrackedJob> watched = {};
+    for (TrackedJob &job : jobs)
+    {
+        if (!IsTerminalState(job.state))
+        {
+            watched.push_back(job);
+        }
+    }
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    std::vector<int> job_watch(watched.size(), -1);
+    for (size_t i = 0; i < watched.size(); i++)
+    {
+        job_watch[i] = (inotify_fd >= 0) ? inotify_add_watch(inotify_fd, watched[i].job_dir.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) : -1;
+    }
+    auto last_query = std::chrono::steady_clock::now();
+    std::vector<char> events(64 * 1024);
+    while (!watched.empty())
+    {
+        int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - last_query).count();
+        int timeout = std::max(0, WATCH_INTERVAL * 1000 - elapsed);
+        struct pollfd pfd = {inotify_fd, POLLIN, 0};
+        if (inotify_fd >= 0 && poll(&pfd, 1, timeout) > 0)
+        {
+            while (read(inotify_fd, events.data(), events.size()) > 0)
+            {
+            }
+        }
+        else if (inotify_fd < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        }
+        for (TrackedJob &job : watched)
+        {
+            if (output_changed(job) && update_job_progress(job))
+            {
+                normal_log(GetTimeAndDate() + "  " + job.job_id + "  " + job_progress_text(job));
+            }
+        }
+
+        if (std::chrono::steady_clock::now() - last_query < std::chrono::seconds(WATCH_INTERVAL))
+        {
+            continue;
+        }
+        last_query = std::chrono::steady_clock::now();
+        std::vector<std::string> old_states = {};
+        for (TrackedJob &job : watched)
+        {
+            old_states.push_back(job.state);
+        }
+        QuerySlurmStates(watched);
+        bool any_finished = false;
+        for (size_t i = 0; i < watched.size(); i++)
+        {
+            if (watched[i].state != old_states[i])
+            {
+                report_job_change(watched[i], old_states[i]);
+            }
+            any_finished = any_finished || IsTerminalState(watched[i].state);
+        }
+        // Single jobs cut short by walltime, preemption or a GPU error are resubmitted and followed under their new ID.
+        std::vector<TrackedJob> resubmitted = {};
+        for (size_t i = 0; i < watched.size(); i++)
+        {
+            if (watched[i].state != old_states[i] && IsTerminalState(watched[i].state) && watched[i].tasks.empty())
+            {
+                TrackedJob restarted;
+                restarted.job_id = RestartInterruptedJob(watched[i].job_dir, watched[i].job_id, watched[i].state);
+                restarted.job_dir = watched[i].job_dir;
+                if (!restarted.job_id.empty())
+                {
+                    resubmitted.push_back(restarted);
+                }
+            }
+        }
+        if (!any_finished)
+        {
+            continue;
+        }
+        if (MONITOR_DIRS.empty())
+        {
+            forget_finished_jobs(watched);
+        }
+        std::vector<TrackedJob> remaining = {};
+        std::vector<int> remaining_watches = {};
+        for (size_t i = 0; i < watched.size(); i++)
+        {
+            if (IsTerminalState(watched[i].state))
+            {
+                if (job_watch[i] >= 0)
+                {
+                    inotify_rm_watch(inotify_fd, job_watch[i]);
+                }
+                continue;
+            }
+            remaining.push_back(watched[i]);
+            remaining_watches.push_back(job_watch[i]);
+        }
+        for (TrackedJob &job : resubmitted)
+        {
+            int wd = (inotify_fd >= 0) ? inotify_add_watch(inotify_fd, job.job_dir.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) : -1;
+            remaining.push_back(job);
+            remaining_watches.push_back(wd);
+        }
+        watched = remaining;
+        job_watch = remaining_watches;
+    }
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+    }
+    normal_log("All watched jobs have finished.");
+}
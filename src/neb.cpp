@@ -0,0 +1,589 @@
+#include "neb.h"
+#include "logger.h"
+#include <numeric>
+
+bool NEB = false;
+std::string NEB_RESUME_DIR = "";
+double NEB_SPRING = DEFAULT_NEB_SPRING;
+double NEB_FORCE_TOL = DEFAULT_NEB_FORCE_TOL;
+size_t NEB_MAX_ITERATIONS = 0;
+
+void check_neb_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("neb") > 0)
+    {
+        NEB = true;
+        flags.erase("neb");
+    }
+    if (flags.count("neb_spring") > 0)
+    {
+        if (!flags["neb_spring"].empty())
+        {
+            NEB_SPRING = std::stod(flags["neb_spring"][0]);
+        }
+        flags.erase("neb_spring");
+    }
+    if (flags.count("neb_ftol") > 0)
+    {
+        if (!flags["neb_ftol"].empty())
+        {
+            NEB_FORCE_TOL = std::stod(flags["neb_ftol"][0]);
+        }
+        flags.erase("neb_ftol");
+    }
+    if (flags.count("neb_max_iter") > 0)
+    {
+        if (!flags["neb_max_iter"].empty())
+        {
+            NEB_MAX_ITERATIONS = std::stoul(flags["neb_max_iter"][0]);
+        }
+        flags.erase("neb_max_iter");
+    }
+    if (flags.count("neb_resume") > 0)
+    {
+        NEB_RESUME_DIR = flags["neb_resume"].empty() ? "." : flags["neb_resume"][0];
+        flags.erase("neb_resume");
+    }
+}
+
+const double NEB_BOHR_TO_ANGSTROM = 0.529177210903;
+
+// FIRE settings (Bitzek et al., PRL 97, 170201), in atomic units with unit masses.
+const double FIRE_DT_START = 1.0;
+const double FIRE_DT_MAX = 5.0;
+const double FIRE_ALPHA_START = 0.1;
+const size_t FIRE_N_MIN = 5;
+const double FIRE_MAX_STEP = 0.2;           // Bohr per atom and iteration
+
+// State file
+bool ReadNEBState(NEBState &state, std::string filename)
+{
+    std::ifstream fin(filename);
+    std::string key;
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    auto read_vector = [&](std::vector<double> &values, size_t n)
+    {
+        values.assign(n, 0.0);
+        for (size_t i = 0; i < n; i++)
+        {
+            fin >> values[i];
+        }
+    };
+    while (fin >> key)
+    {
+        if (key == "iteration") fin >> state.iteration;
+        else if (key == "images") fin >> state.n_images;
+        else if (key == "coordinates") fin >> state.n_coordinates;
+        else if (key == "climbing") fin >> state.climbing;
+        else if (key == "converged") fin >> state.converged;
+        else if (key == "spring") fin >> state.spring;
+        else if (key == "force_tolerance") fin >> state.force_tolerance;
+        else if (key == "max_iterations") fin >> state.max_iterations;
+        else if (key == "dt") fin >> state.dt;
+        else if (key == "alpha") fin >> state.alpha;
+        else if (key == "downhill") fin >> state.n_downhill;
+        else if (key == "elements")
+        {
+            state.elements.assign(state.n_coordinates / 3, "");
+            for (std::string &element : state.elements) fin >> element;
+        }
+        else if (key == "positions") read_vector(state.positions, state.n_images * state.n_coordinates);
+        else if (key == "velocities") read_vector(state.velocities, state.n_images * state.n_coordinates);
+        else if (key == "energies") read_vector(state.energies, state.n_images);
+    }
+    return !fin.bad() && state.n_images > 0 && state.positions.size() == state.n_images * state.n_coordinates;
+}
+
+void WriteNEBState(const NEBState &state, std::string filename)
+{
+    // Written to a side file and renamed, so an interruption leaves the previous iteration intact.
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "iteration " << state.iteration << std::endl << "images " << state.n_images << std::endl << "coordinates " << state.n_coordinates << std::endl
+           << "climbing " << state.climbing << std::endl << "converged " << state.converged << std::endl << std::setprecision(17)
+           << "spring " << state.spring << std::endl << "force_tolerance " << state.force_tolerance << std::endl << "max_iterations " << state.max_iterations << std::endl
+           << "dt " << state.dt << std::endl << "alpha " << state.alpha << std::endl << "downhill " << state.n_downhill << std::endl << "elements";
+    for (const std::string &element : state.elements)
+    {
+        buffer << " " << element;
+    }
+    for (auto section : {std::make_pair("positions", &state.positions), std::make_pair("velocities", &state.velocities)})
+    {
+        buffer << std::endl << section.first;
+        for (size_t i = 0; i < section.second->size(); i++)
+        {
+            buffer << ((i % state.n_coordinates == 0) ? "\n" : " ") << (*section.second)[i];
+        }
+    }
+    buffer << std::endl << "energies";
+    for (double energy : state.energies)
+    {
+        buffer << " " << energy;
+    }
+    buffer << std::endl;
+    write_to_file(filename + ".partial", buffer.str());
+    std::error_code ec;
+    fs::rename(filename + ".partial", filename, ec);
+}
+
+XYZFrames images_to_frames(const NEBState &state)
+{
+    XYZFrames frames;
+    frames.n_atoms = state.n_coordinates / 3;
+    frames.elements = state.elements;
+    for (size_t k = 0; k < state.n_images; k++)
+    {
+        std::stringstream comment;
+        comment << "image " << k << " energy " << std::setprecision(12) << state.energies[k] << " iteration " << state.iteration;
+        frames.comments.push_back(comment.str());
+        for (size_t a = 0; a < frames.n_atoms; a++)
+        {
+            const double *r = &state.positions[k * state.n_coordinates + 3 * a];
+            frames.x.push_back(r[0] * NEB_BOHR_TO_ANGSTROM);
+            frames.y.push_back(r[1] * NEB_BOHR_TO_ANGSTROM);
+            frames.z.push_back(r[2] * NEB_BOHR_TO_ANGSTROM);
+        }
+    }
+    return frames;
+}
+
+// Band
+std::vector<double> InterpolatePath(const XYZFrames &frames, size_t n_images)
+{
+    // Images evenly spaced in arc length along the given frames (at least reactant and product), in Bohr.
+    size_t n = 3 * frames.n_atoms;
+    size_t n_frames = frames.comments.size();
+    std::vector<double> path(n_frames * n);
+    for (size_t f = 0; f < n_frames; f++)
+    {
+        for (size_t a = 0; a < frames.n_atoms; a++)
+        {
+            size_t i = f * frames.n_atoms + a;
+            path[f*n + 3*a] = frames.x[i] / NEB_BOHR_TO_ANGSTROM;
+            path[f*n + 3*a + 1] = frames.y[i] / NEB_BOHR_TO_ANGSTROM;
+            path[f*n + 3*a + 2] = frames.z[i] / NEB_BOHR_TO_ANGSTROM;
+        }
+    }
+    if (n_frames == n_images)
+    {
+        return path;
+    }
+    std::vector<double> length(n_frames, 0.0);
+    for (size_t f = 1; f < n_frames; f++)
+    {
+        double d2 = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            d2 += (path[f*n + i] - path[(f-1)*n + i]) * (path[f*n + i] - path[(f-1)*n + i]);
+        }
+        length[f] = length[f-1] + sqrt(d2);
+    }
+    std::vector<double> images(n_images * n);
+    size_t f = 0;
+    for (size_t k = 0; k < n_images; k++)
+    {
+        double s = length.back() * k / (n_images - 1);
+        while (f + 2 < n_frames && length[f+1] < s)
+        {
+            f++;
+        }
+        double span = length[f+1] - length[f];
+        double t = (span > 0.0) ? std::min(1.0, std::max(0.0, (s - length[f]) / span)) : 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            images[k*n + i] = (1.0 - t) * path[f*n + i] + t * path[(f+1)*n + i];
+        }
+    }
+    return images;
+}
+
+double NEBForces(const NEBState &state, const std::vector<double> &gradients, std::vector<double> &forces)
+{
+    // Improved tangent (Henkelman and Jonsson, JCP 113, 9978) and climbing image (JCP 113, 9901).
+    // Returns the largest per-atom force on any moving image.
+    size_t n = state.n_coordinates, m = state.n_images;
+    const std::vector<double> &r = state.positions, &e = state.energies;
+    forces.assign(m * n, 0.0);
+    size_t climber = 0;
+    for (size_t k = 1; k + 1 < m; k++)
+    {
+        if (climber == 0 || e[k] > e[climber])
+        {
+            climber = k;
+        }
+    }
+    double largest = 0.0;
+    std::vector<double> tangent(n);
+    for (size_t k = 1; k + 1 < m; k++)
+    {
+        double up = e[k+1] - e[k], down = e[k-1] - e[k];
+        double weight_next = 1.0, weight_previous = 1.0;
+        if (up > 0.0 && down < 0.0)
+        {
+            weight_previous = 0.0;
+        }
+        else if (up < 0.0 && down > 0.0)
+        {
+            weight_next = 0.0;
+        }
+        else
+        {
+            double larger = std::max(fabs(up), fabs(down)), smaller = std::min(fabs(up), fabs(down));
+            weight_next = (e[k+1] > e[k-1]) ? larger : smaller;
+            weight_previous = (e[k+1] > e[k-1]) ? smaller : larger;
+        }
+        double norm = 0.0, next_length = 0.0, previous_length = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double next = r[(k+1)*n + i] - r[k*n + i];
+            double previous = r[k*n + i] - r[(k-1)*n + i];
+            tangent[i] = weight_next * next + weight_previous * previous;
+            norm += tangent[i] * tangent[i];
+            next_length += next * next;
+            previous_length += previous * previous;
+        }
+        norm = sqrt(norm);
+        double parallel = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            tangent[i] = (norm > 0.0) ? tangent[i] / norm : 0.0;
+            parallel += gradients[k*n + i] * tangent[i];
+        }
+        double spring = state.spring * (sqrt(next_length) - sqrt(previous_length));
+        bool climbs = state.climbing && k == climber;
+        for (size_t i = 0; i < n; i++)
+        {
+            // The climbing image feels no springs and has its force along the band inverted.
+            forces[k*n + i] = climbs ? -gradients[k*n + i] + 2.0 * parallel * tangent[i]
+                                     : -(gradients[k*n + i] - parallel * tangent[i]) + spring * tangent[i];
+        }
+        for (size_t a = 0; a < n / 3; a++)
+        {
+            const double *f = &forces[k*n + 3*a];
+            largest = std::max(largest, sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]));
+        }
+    }
+    return largest;
+}
+
+void fire_step(NEBState &state, const std::vector<double> &forces)
+{
+    // All moving images are one system; the endpoints have no force and stay where they are.
+    std::vector<double> &v = state.velocities;
+    double power = 0.0, force_norm = 0.0, velocity_norm = 0.0;
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        power += forces[i] * v[i];
+        force_norm += forces[i] * forces[i];
+        velocity_norm += v[i] * v[i];
+    }
+    force_norm = sqrt(force_norm);
+    velocity_norm = sqrt(velocity_norm);
+    if (power > 0.0)
+    {
+        for (size_t i = 0; i < v.size(); i++)
+        {
+            v[i] = (1.0 - state.alpha) * v[i] + state.alpha * velocity_norm * forces[i] / force_norm;
+        }
+        if (state.n_downhill > FIRE_N_MIN)
+        {
+            state.dt = std::min(state.dt * 1.1, FIRE_DT_MAX);
+            state.alpha *= 0.99;
+        }
+        state.n_downhill++;
+    }
+    else
+    {
+        std::fill(v.begin(), v.end(), 0.0);
+        state.dt *= 0.5;
+        state.alpha = FIRE_ALPHA_START;
+        state.n_downhill = 0;
+    }
+    std::vector<double> step(v.size());
+    double longest = 0.0;
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        v[i] += state.dt * forces[i];
+        step[i] = state.dt * v[i];
+    }
+    for (size_t i = 0; i + 2 < step.size(); i += 3)
+    {
+        longest = std::max(longest, sqrt(step[i]*step[i] + step[i+1]*step[i+1] + step[i+2]*step[i+2]));
+    }
+    double scale = (longest > FIRE_MAX_STEP) ? FIRE_MAX_STEP / longest : 1.0;
+    for (size_t i = 0; i < step.size(); i++)
+    {
+        state.positions[i] += scale * step[i];
+    }
+}
+
+// Driver
+std::string neb_iteration_dir(size_t iteration)
+{
+    std::stringstream name;
+    name.str("");
+    name << "iter." << std::setw(4) << std::setfill('0') << iteration;
+    return name.str();
+}
+
+std::string neb_image_dir(size_t iteration, size_t image)
+{
+    std::stringstream name;
+    name.str("");
+    name << neb_iteration_dir(iteration) << "/image." << std::setw(2) << std::setfill('0') << image;
+    return name.str();
+}
+
+bool image_gradient(std::string image_dir, size_t n, double &energy, std::vector<double> &gradient)
+{
+    std::string output = image_dir + "/tc_grad.out";
+    if (!fs::exists(output))
+    {
+        return false;
+    }
+    TCOutputResults results = ParseTCOutput(output);
+    if (!results.finished || !results.errors.empty() || !results.has_energy || results.gradient.size() != n)
+    {
+        return false;
+    }
+    energy = results.final_energy;
+    gradient = results.gradient;
+    return true;
+}
+
+void prepare_image(std::map<std::string,std::string> keywords, const NEBState &state, size_t k)
+{
+    // Each image starts from its own orbitals of the previous iteration.
+    std::string dir = neb_image_dir(state.iteration, k);
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    XYZFrames frames = images_to_frames(state);
+    write_to_file(dir + "/geometry.xyz", FrameToXYZ(frames, k));
+    keywords["coordinates"] = "geometry.xyz";
+    keywords["scrdir"] = "scr/";
+    if (state.iteration > 0)
+    {
+        std::string guess = "";
+        for (std::string file : split_string(carry_forward_guess(neb_image_dir(state.iteration - 1, k) + "/scr/"), " "))
+        {
+            if (file.empty())
+            {
+                continue;
+            }
+            fs::path link = fs::path(dir) / fs::path(file).filename();
+            fs::remove(link, ec);
+            fs::create_hard_link(file, link, ec);
+            if (ec)
+            {
+                fs::copy_file(file, link, fs::copy_options::overwrite_existing, ec);
+            }
+            guess += (guess.empty() ? "" : " ") + fs::path(file).filename().string();
+        }
+        keywords.erase("guess");
+        if (!guess.empty())
+        {
+            keywords["guess"] = guess;
+        }
+    }
+    Write_TC_Input_File(keywords, dir + "/tc_grad.in");
+}
+
+void RunNEBIterations(std::string job_dir)
+{
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    NEBState state;
+    std::map<std::string,std::string> keywords = {};
+    if (!ReadNEBState(state, NEB_STATE_FILE) || !Read_TC_Input_File(keywords, NEB_TEMPLATE_FILE))
+    {
+        error_log("No NEB state found in " + job_dir, 1);
+    }
+    if (NEB_MAX_ITERATIONS > 0)
+    {
+        state.max_iterations = NEB_MAX_ITERATIONS;
+    }
+    size_t n = state.n_coordinates, m = state.n_images;
+    std::vector<ExecutorSlot> slots = ExecutorSlots(LOCAL_DEVICES, LOCAL_CPU_SETS, LOCAL_WORKERS);
+    normal_log("NEB with " + std::to_string(m) + " images on " + std::to_string(slots.size()) + " slot(s), starting at iteration " + std::to_string(state.iteration));
+
+    std::vector<double> gradients(m * n, 0.0), forces;
+    while (!state.converged && state.iteration < state.max_iterations)
+    {
+        // The endpoints are fixed, so their energies are only needed once.
+        size_t first = (state.iteration == 0) ? 0 : 1;
+        size_t last = (state.iteration == 0) ? m : m - 1;
+        std::vector<ExecutorTask> tasks = {};
+        std::vector<double> gradient;
+        for (size_t k = first; k < last; k++)
+        {
+            std::string dir = neb_image_dir(state.iteration, k);
+            if (image_gradient(dir, n, state.energies[k], gradient))
+            {
+                continue;
+            }
+            prepare_image(keywords, state, k);
+            ExecutorTask task;
+            task.job_dir = dir;
+            task.input = "tc_grad.in";
+            task.output = "tc_grad.out";
+            task.error = "tc_grad.err";
+            tasks.push_back(task);
+        }
+        if (!tasks.empty())
+        {
+            RunTaskQueue(tasks, slots, neb_iteration_dir(state.iteration) + "/AutoQuantum_NEB.report");
+        }
+        for (size_t k = first; k < last; k++)
+        {
+            std::string dir = neb_image_dir(state.iteration, k);
+            if (!image_gradient(dir, n, state.energies[k], gradient))
+            {
+                error_log("The gradient of image " + std::to_string(k) + " did not finish cleanly, see " + dir + "/tc_grad.out; continue with 'autoquantum --neb_resume " + fs::current_path().string() + "'", 1);
+            }
+            std::copy(gradient.begin(), gradient.end(), gradients.begin() + k * n);
+        }
+
+        // Climb once the band is roughly relaxed; converge with the climbing image on.
+        double largest = NEBForces(state, gradients, forces);
+        if (!state.climbing && m > 2 && largest < 5.0 * state.force_tolerance)
+        {
+            state.climbing = true;
+            largest = NEBForces(state, gradients, forces);
+        }
+        state.converged = (largest < state.force_tolerance) && (state.climbing || m < 3);
+        size_t highest = std::max_element(state.energies.begin() + 1, state.energies.end() - 1) - state.energies.begin();
+        std::stringstream line;
+        line << std::fixed << std::setprecision(6) << state.iteration << " max_force " << largest << " barrier_kcal " << (state.energies[highest] - state.energies[0]) * 627.5094740631
+             << " highest_image " << highest << (state.climbing ? " climbing" : "") << std::endl;
+        append_to_file(NEB_LOG_FILE, line.str());
+        write_to_file(NEB_PATH_FILE, "");
+        XYZFrames frames = images_to_frames(state);
+        for (size_t k = 0; k < m; k++)
+        {
+            append_to_file(NEB_PATH_FILE, FrameToXYZ(frames, k));
+        }
+        normal_log("NEB iteration " + line.str().substr(0, line.str().size() - 1));
+        if (state.converged)
+        {
+            write_to_file("ts.xyz", FrameToXYZ(frames, highest));
+            WriteNEBState(state, NEB_STATE_FILE);
+            break;
+        }
+
+        fire_step(state, forces);
+        state.iteration++;
+        WriteNEBState(state, NEB_STATE_FILE);
+
+        // Only the previous iteration's orbitals are needed; iter.0000 keeps the endpoints.
+        if (state.iteration >= 3)
+        {
+            std::error_code ec;
+            fs::remove_all(neb_iteration_dir(state.iteration - 2), ec);
+        }
+    }
+    if (state.converged)
+    {
+        normal_log("NEB converged after " + std::to_string(state.iteration + 1) + " iterations; the climbing image is in ts.xyz and the band in " + NEB_PATH_FILE);
+    }
+    else
+    {
+        normal_log("NEB did not converge within " + std::to_string(state.max_iterations) + " iterations; continue with 'autoquantum --neb_resume " + fs::current_path().string() + " --neb_max_iter N'");
+    }
+}
+
+void RunNEB(std::map<std::string,std::vector<std::string>> &flags)
+{
+    std::map<std::string,std::string> keywords = {};
+    Prepare_TC_Keywords(flags, keywords);
+    if (CALC_TYPE != "TS")
+    {
+        error_log("--neb drives the band of a --ts calculation.", 1);
+    }
+    if (keywords.count("prmtop") > 0 || fs::path(keywords["coordinates"]).extension() != ".xyz")
+    {
+        error_log("--neb needs an XYZ path (reactant, optional intermediates, product) without MM atoms.", 1);
+    }
+    XYZTrajectory trajectory;
+    if (!OpenTrajectory(trajectory, keywords["coordinates"]))
+    {
+        error_log("Unable to read " + keywords["coordinates"], 1);
+    }
+    std::vector<size_t> indices(TrajectoryFrameCount(trajectory));
+    std::iota(indices.begin(), indices.end(), 0);
+    XYZFrames frames;
+    bool read = ReadTrajectoryFrames(frames, trajectory, indices, default_thread_count());
+    CloseTrajectory(trajectory);
+    if (!read)
+    {
+        error_log("The frames of " + keywords["coordinates"] + " do not all have the same number of atoms.", 1);
+    }
+    if (frames.comments.size() < 2)
+    {
+        error_log("--neb needs at least a reactant and a product frame in " + keywords["coordinates"], 1);
+    }
+
+    NEBState state;
+    state.n_images = std::max(3, atoi(keywords["min_image"].c_str()));
+    state.n_coordinates = 3 * frames.n_atoms;
+    state.spring = NEB_SPRING;
+    state.force_tolerance = NEB_FORCE_TOL;
+    state.max_iterations = (NEB_MAX_ITERATIONS > 0) ? NEB_MAX_ITERATIONS : DEFAULT_NEB_MAX_ITERATIONS;
+    state.dt = FIRE_DT_START;
+    state.alpha = FIRE_ALPHA_START;
+    state.elements = frames.elements;
+    state.positions = InterpolatePath(frames, state.n_images);
+    state.velocities.assign(state.positions.size(), 0.0);
+    state.energies.assign(state.n_images, 0.0);
+
+    // Image gradients are plain gradient jobs, one GPU slice each.
+    for (std::string key : {"run", "nstep", "min_maxallowedstep", "timestep", "min_image", "orbitalswrtfrq", "min_coordinates", "ts_method", "new_minimizer"})
+    {
+        keywords.erase(key);
+    }
+    keywords["run"] = "gradient";
+    keywords["gpus"] = "1";
+    if (keywords.count("guess") > 0)
+    {
+        // The first iteration runs three directories down, so a given guess is made absolute.
+        std::string guess = "";
+        for (std::string file : split_string(keywords["guess"], " "))
+        {
+            guess += file.empty() ? "" : (guess.empty() ? "" : " ") + fs::absolute(file).string();
+        }
+        keywords["guess"] = guess;
+    }
+    std::string job_dir = MakeIterativeDirectoryName("AutoQuantum", 4);
+    move_to_jobdir(keywords, job_dir);
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    keywords["coordinates"] = fs::path(keywords["coordinates"]).filename().string();
+    if (!Write_TC_Input_File(keywords, NEB_TEMPLATE_FILE))
+    {
+        error_log("Unable to open " + (std::string)NEB_TEMPLATE_FILE + " for writing.  Check permissions", 1);
+    }
+    WriteNEBState(state, NEB_STATE_FILE);
+    normal_log("Prepared a " + std::to_string(state.n_images) + "-image band in " + job_dir);
+
+    if (DRYRUN)
+    {
+        normal_log("DRYRUN flag was invoked.  Input files have been generated, but TeraChem will not be run at this time.");
+        return;
+    }
+    if (UseSlurmSubmission())
+    {
+        // One allocation with several GPU slices; the driver runs the images of each iteration side by side.
+        std::string gpu_name = DEFAULT_SLURM_GPU_JOB_GPUNAME;
+        int n_slots = std::max(1, atoi(gpu_name.substr(gpu_name.rfind(':') + 1).c_str()));
+        JOB_RESOURCES.gres = gpu_name;
+        JOB_RESOURCES.gpus = n_slots;
+        JOB_RESOURCES.cpus = n_slots + 2;
+        JOB_RESOURCES.mem_gb = std::min(DEFAULT_SLURM_MAX_MEMORY_GB, JOB_RESOURCES.mem_gb * n_slots);
+        std::string body = "\n" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + AutoQuantumExecutable() + " --neb_resume ." + (DEBUG ? " --debug" : "") + "\n";
+        SubmitSlurmScript("AutoQuantum_TC_NEB", "slurm_tc_neb.out", "slurm_tc_neb.err", body);
+        return;
+    }
+    RunNEBIterations(".");
+}
@@ -0,0 +1,304 @@
+#include "process.h"
+#include <spawn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <chrono>
+
+extern char **environ;
+
+int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    return -1;
+#endif
+}
+
+bool SpawnProcess(Process &process, std::vector<std::string> args, ProcessOptions options)
+{
+    process = Process();
+    if (args.empty())
+    {
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    int pipe_fds[2] = {-1, -1};
+    if (options.capture)
+    {
+        if (pipe2(pipe_fds, O_CLOEXEC) != 0)
+        {
+            posix_spawn_file_actions_destroy(&actions);
+            return false;
+        }
+        posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+    }
+    else if (!options.stdout_file.empty())
+    {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, options.stdout_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    else
+    {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+    if (options.merge_stderr)
+    {
+        posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    }
+    else if (!options.stderr_file.empty())
+    {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, options.stderr_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (!options.working_dir.empty())
+    {
+        posix_spawn_file_actions_addchdir_np(&actions, options.working_dir.c_str());
+    }
+
+    std::vector<char*> argv = {};
+    for (std::string &arg : args)
+    {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    // Environment overrides replace matching entries of the current environment.
+    std::vector<std::string> env_strings = {};
+    for (char **e = environ; *e != nullptr; e++)
+    {
+        std::string entry(*e);
+        if (options.environment.count(entry.substr(0, entry.find('='))) == 0)
+        {
+            env_strings.push_back(entry);
+        }
+    }
+    for (auto &variable : options.environment)
+    {
+        env_strings.push_back(variable.first + "=" + variable.second);
+    }
+    std::vector<char*> envp = {};
+    for (std::string &entry : env_strings)
+    {
+        envp.push_back(&entry[0]);
+    }
+    envp.push_back(nullptr);
+
+    // Look the program up in the PATH being handed to the child, not our own.
+    std::string program = args[0];
+    if (options.environment.count("PATH") > 0)
+    {
+        std::string found = FindInPath(program, options.environment["PATH"]);
+        program = found.empty() ? program : found;
+    }
+
+    // posix_spawn has no affinity attribute, but the child inherits the calling thread's mask.
+    cpu_set_t saved_mask;
+    bool pinned = false;
+    if (!options.cpu_affinity.empty() && sched_getaffinity(0, sizeof(saved_mask), &saved_mask) == 0)
+    {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int cpu : options.cpu_affinity)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &mask);
+            }
+        }
+        pinned = (sched_setaffinity(0, sizeof(mask), &mask) == 0);
+    }
+    int status = posix_spawnp(&process.pid, program.c_str(), &actions, nullptr, argv.data(), envp.data());
+    if (pinned)
+    {
+        sched_setaffinity(0, sizeof(saved_mask), &saved_mask);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    if (options.capture)
+    {
+        close(pipe_fds[1]);
+        process.output_fd = pipe_fds[0];
+    }
+    if (status != 0)
+    {
+        if (process.output_fd >= 0)
+        {
+            close(process.output_fd);
+        }
+        process = Process();
+        debug_log("Unable to spawn " + args[0] + ": " + std::string(strerror(status)));
+        return false;
+    }
+    process.pidfd = open_pidfd(process.pid);
+    process.running = true;
+    return true;
+}
+
+void drain_process_output(Process &process, bool block)
+{
+    if (process.output_fd < 0)
+    {
+        return;
+    }
+    std::vector<char> buffer(PROCESS_READ_BUFFER_SIZE);
+    while (true)
+    {
+        if (!block)
+        {
+            struct pollfd pfd = {process.output_fd, POLLIN, 0};
+            if (poll(&pfd, 1, 0) <= 0)
+            {
+                return;
+            }
+        }
+        ssize_t n = read(process.output_fd, buffer.data(), buffer.size());
+        if (n > 0)
+        {
+            process.output.append(buffer.data(), n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        close(process.output_fd);
+        process.output_fd = -1;
+        return;
+    }
+}
+
+void reap_process(Process &process, int status)
+{
+    process.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    process.running = false;
+    if (process.pidfd >= 0)
+    {
+        close(process.pidfd);
+        process.pidfd = -1;
+    }
+}
+
+bool PollProcess(Process &process)
+{
+    // Returns true once the process has exited; exit_code is then valid.
+    if (!process.running)
+    {
+        return true;
+    }
+    drain_process_output(process, false);
+    int status = 0;
+    pid_t result = waitpid(process.pid, &status, WNOHANG);
+    if (result == process.pid)
+    {
+        drain_process_output(process, true);
+        reap_process(process, status);
+        return true;
+    }
+    return false;
+}
+
+int WaitProcess(Process &process)
+{
+    if (!process.running)
+    {
+        return process.exit_code;
+    }
+    // Read the pipe to EOF first so a chatty child can't block on a full pipe.
+    drain_process_output(process, true);
+    int status = 0;
+    while (waitpid(process.pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    reap_process(process, status);
+    return process.exit_code;
+}
+
+int WaitAnyProcess(std::vector<Process*> &processes, int timeout_ms)
+{
+    // Returns the index of a finished process, or -1 on timeout.
+    if (processes.empty())
+    {
+        return -1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    while (true)
+    {
+        std::vector<struct pollfd> fds = {};
+        bool all_pidfds = true;
+        for (size_t i = 0; i < processes.size(); i++)
+        {
+            if (PollProcess(*processes[i]))
+            {
+                return i;
+            }
+            if (processes[i]->pidfd >= 0)
+            {
+                fds.push_back({processes[i]->pidfd, POLLIN, 0});
+            }
+            else
+            {
+                all_pidfds = false;
+            }
+            if (processes[i]->output_fd >= 0)
+            {
+                fds.push_back({processes[i]->output_fd, POLLIN, 0});
+            }
+        }
+        int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (timeout_ms >= 0 && elapsed >= timeout_ms)
+        {
+            return -1;
+        }
+        // Without pidfds, fall back to short sleeps between waitpid checks.
+        int slice = (timeout_ms < 0) ? -1 : timeout_ms - elapsed;
+        if (!all_pidfds && (slice < 0 || slice > 50))
+        {
+            slice = 50;
+        }
+        poll(fds.data(), fds.size(), slice);
+    }
+}
+
+void KillProcess(Process &process, int signal_number)
+{
+    if (process.running)
+    {
+        kill(process.pid, signal_number);
+    }
+}
+
+Process RunProcess(std::vector<std::string> args, ProcessOptions options)
+{
+    Process process;
+    if (SpawnProcess(process, args, options))
+    {
+        WaitProcess(process);
+    }
+    return process;
+}
+
+std::string FindInPath(std::string program, std::string path)
+{
+    // In-process equivalent of 'which', against the given PATH or our own.
+    if (program.find('/') != std::string::npos)
+    {
+        return (access(program.c_str(), X_OK) == 0) ? program : "";
+    }
+    if (path.empty() && getenv("PATH") != nullptr)
+    {
+        path = getenv("PATH");
+    }
+    for (std::string dir : split_string(path, ":"))
+    {
+        std::string candidate = dir + "/" + program;
+        if (!dir.empty() && access(candidate.c_str(), X_OK) == 0)
+        {
+            return candidate;
+        }
+    }
+    return "";
+}
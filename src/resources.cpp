@@ -0,0 +1,459 @@
+#include "resources.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <mutex>
+
+bool AUTOTUNE = true;
+JobResources JOB_RESOURCES;
+
+void check_resource_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("no_autotune") > 0)
+    {
+        AUTOTUNE = false;
+        flags.erase("no_autotune");
+    }
+}
+
+// Basis functions per atom for {H-He, Li-Ne, Na-Ar, K and heavier}.
+std::map<std::string, std::array<int,4>> BASIS_FUNCTION_COUNTS = {{"sto-3g"     , {1,  5,  9, 18}},
+                                                                 {"3-21g"      , {2,  9, 13, 23}},
+                                                                 {"6-31g"      , {2,  9, 13, 23}},
+                                                                 {"6-31gs"     , {2, 15, 19, 29}},
+                                                                 {"6-31gss"    , {5, 15, 19, 29}},
+                                                                 {"6-31+gs"    , {2, 19, 23, 33}},
+                                                                 {"6-31+gss"   , {5, 19, 23, 33}},
+                                                                 {"6-311gs"    , {3, 19, 25, 35}},
+                                                                 {"6-311gss"   , {6, 19, 25, 35}},
+                                                                 {"def2-svp"   , {5, 14, 18, 24}},
+                                                                 {"def2-tzvp"  , {6, 31, 37, 45}},
+                                                                 {"cc-pvdz"    , {5, 14, 18, 27}},
+                                                                 {"cc-pvtz"    , {14, 30, 34, 50}},
+                                                                 {"lanl2dz_ecp", {2,  9,  9, 18}},};
+
+int element_row(std::string element)
+{
+    std::transform(element.begin(), element.end(), element.begin(), ::toupper);
+    static const std::set<std::string> first = {"H", "HE"};
+    static const std::set<std::string> second = {"LI", "BE", "B", "C", "N", "O", "F", "NE"};
+    static const std::set<std::string> third = {"NA", "MG", "AL", "SI", "P", "S", "CL", "AR"};
+    if (first.count(element) > 0) return 0;
+    if (second.count(element) > 0) return 1;
+    if (third.count(element) > 0) return 2;
+    return 3;
+}
+
+std::vector<int> read_qm_indices(std::string filename)
+{
+    // 0-based indices, whitespace or comma separated, with optional "a-b" ranges.
+    std::vector<int> indices = {};
+    std::ifstream fin(filename);
+    std::string token;
+    while (fin >> token)
+    {
+        for (std::string part : split_string(token, ","))
+        {
+            if (part.empty() || !isdigit(part[0]))
+            {
+                continue;
+            }
+            size_t dash = part.find('-');
+            int first = std::stoi(part.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(part.substr(dash + 1));
+            for (int i = first; i <= last; i++)
+            {
+                indices.push_back(i);
+            }
+        }
+    }
+    return indices;
+}
+
+JobFeatures JobFeaturesFromKeywords(std::map<std::string,std::string> keywords)
+{
+    JobFeatures features;
+    // Chains prepare several types at once, so the type comes from the 'run' keyword.
+    std::map<std::string,std::string> run_types = {{"energy", "SPE"}, {"minimize", "OPT"}, {"frequencies", "FREQ"}, {"md", "BOMD"}, {"ts", "TS"}};
+    features.calc_type = (run_types.count(keywords["run"]) > 0) ? run_types[keywords["run"]] : CALC_TYPE;
+    features.method = keywords["method"];
+    features.basis = keywords["basis"];
+    std::transform(features.basis.begin(), features.basis.end(), features.basis.begin(), ::tolower);
+    std::replace(features.basis.begin(), features.basis.end(), '*', 's');
+    if (keywords.count("nstep") > 0 && (keywords["run"] == "md" || keywords["run"] == "ts"))
+    {
+        features.steps = std::max(1, atoi(keywords["nstep"].c_str()));
+    }
+
+    std::array<int,4> counts = BASIS_FUNCTION_COUNTS.at("6-31gss");
+    if (BASIS_FUNCTION_COUNTS.count(features.basis) > 0)
+    {
+        counts = BASIS_FUNCTION_COUNTS.at(features.basis);
+    }
+    else
+    {
+        debug_log("No basis function counts for '" + features.basis + "'; sizing the job as 6-31gss.");
+    }
+
+    // QM/MM coordinates may not be XYZ; without elements, QM atoms count as half hydrogen, half first row.
+    XYZFrames geometry;
+    if (fs::path(keywords["coordinates"]).extension() == ".xyz" && fs::exists(keywords["coordinates"]))
+    {
+        geometry = ReadLastFrame(keywords["coordinates"]);
+    }
+    std::vector<int> qm_atoms = {};
+    if (keywords.count("qmindices") > 0)
+    {
+        qm_atoms = read_qm_indices(keywords["qmindices"]);
+    }
+    else
+    {
+        for (size_t a = 0; a < geometry.n_atoms; a++)
+        {
+            qm_atoms.push_back((int)a);
+        }
+    }
+    double n_basis = 0.0;
+    for (int a : qm_atoms)
+    {
+        if (a >= 0 && (size_t)a < geometry.n_atoms)
+        {
+            n_basis += counts[element_row(geometry.elements[a])];
+        }
+        else
+        {
+            n_basis += 0.5 * (counts[0] + counts[1]);
+        }
+    }
+    features.n_atoms = qm_atoms.size();
+    features.n_basis = (size_t)ceil(n_basis);
+    return features;
+}
+
+// Timing History
+struct TimingRecord
+{
+    JobFeatures features;
+    double seconds = -1.0;              // -1 while pending
+    std::string output = "";            // absolute path of the output, for pending records
+};
+
+std::string timing_history_file()
+{
+    return autoquantum_cache_directory() + "timings.txt";
+}
+
+std::string timing_record_line(const TimingRecord &record)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << (record.seconds < 0 ? "pending " : "done ") << record.features.calc_type << " " << record.features.method << " " << record.features.basis << " ";
+    buffer << record.features.n_atoms << " " << record.features.n_basis << " " << record.features.steps << " ";
+    if (record.seconds < 0)
+    {
+        buffer << record.output << "\n";
+    }
+    else
+    {
+        buffer << record.seconds << "\n";
+    }
+    return buffer.str();
+}
+
+bool parse_timing_record(std::string line, TimingRecord &record)
+{
+    std::stringstream buffer(line);
+    std::string state;
+    if (!(buffer >> state >> record.features.calc_type >> record.features.method >> record.features.basis >> record.features.n_atoms >> record.features.n_basis >> record.features.steps))
+    {
+        return false;
+    }
+    if (state == "done")
+    {
+        return (bool)(buffer >> record.seconds);
+    }
+    std::getline(buffer >> std::ws, record.output);
+    return state == "pending" && !record.output.empty();
+}
+
+int lock_timing_history()
+{
+    std::string filename = timing_history_file();
+    std::error_code ec;
+    fs::create_directories(fs::path(filename).parent_path(), ec);
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::mutex TIMING_HISTORY_MUTEX;
+bool TIMING_HISTORY_LOADED = false;
+std::vector<TimingRecord> TIMING_HISTORY = {};
+
+const std::vector<TimingRecord> &load_timing_history()
+{
+    // Loaded once per process; pending runs whose outputs have since finished are converted in place.
+    std::lock_guard<std::mutex> guard(TIMING_HISTORY_MUTEX);
+    if (TIMING_HISTORY_LOADED)
+    {
+        return TIMING_HISTORY;
+    }
+    TIMING_HISTORY_LOADED = true;
+    int fd = lock_timing_history();
+    if (fd < 0)
+    {
+        return TIMING_HISTORY;
+    }
+    std::string contents = "";
+    char block[65536];
+    ssize_t n_read;
+    while ((n_read = read(fd, block, sizeof(block))) > 0)
+    {
+        contents.append(block, n_read);
+    }
+
+    std::vector<TimingRecord> done = {}, pending = {};
+    bool changed = false;
+    for (std::string line : split_string(contents, "\n"))
+    {
+        TimingRecord record;
+        if (!parse_timing_record(line, record))
+        {
+            changed = changed || !line.empty();
+            continue;
+        }
+        if (record.seconds >= 0)
+        {
+            done.push_back(record);
+            continue;
+        }
+        if (!fs::exists(fs::path(record.output).parent_path()))
+        {
+            changed = true;
+            continue;
+        }
+        if (!fs::exists(record.output))
+        {
+            pending.push_back(record);
+            continue;
+        }
+        TCOutputResults results;
+        if (!PeekTCOutput(results, record.output) || !results.finished)
+        {
+            pending.push_back(record);
+            continue;
+        }
+        changed = true;
+        if (results.errors.empty() && results.total_time > 0)
+        {
+            record.seconds = results.total_time;
+            record.output = "";
+            done.push_back(record);
+        }
+    }
+    if (done.size() > TIMING_HISTORY_MAX_RECORDS)
+    {
+        done.erase(done.begin(), done.end() - TIMING_HISTORY_MAX_RECORDS);
+        changed = true;
+    }
+    if (changed)
+    {
+        std::string buffer = "";
+        for (TimingRecord &record : done)
+        {
+            buffer += timing_record_line(record);
+        }
+        for (TimingRecord &record : pending)
+        {
+            buffer += timing_record_line(record);
+        }
+        if (ftruncate(fd, 0) == 0 && pwrite(fd, buffer.data(), buffer.size(), 0) != (ssize_t)buffer.size())
+        {
+            debug_log("Unable to rewrite " + timing_history_file());
+        }
+    }
+    close(fd);
+    TIMING_HISTORY = done;
+    return TIMING_HISTORY;
+}
+
+void RecordPendingTiming(const JobFeatures &features, std::string output)
+{
+    RecordPendingTimings({features}, {output});
+}
+
+void RecordPendingTimings(const std::vector<JobFeatures> &features, const std::vector<std::string> &outputs)
+{
+    // A whole campaign goes in with one lock and one write.
+    std::string buffer = "";
+    for (size_t i = 0; i < features.size() && i < outputs.size(); i++)
+    {
+        if (!AUTOTUNE || features[i].n_basis == 0)
+        {
+            continue;
+        }
+        TimingRecord record;
+        record.features = features[i];
+        record.output = fs::absolute(outputs[i]).string();
+        buffer += timing_record_line(record);
+    }
+    if (buffer.empty())
+    {
+        return;
+    }
+    int fd = lock_timing_history();
+    if (fd < 0)
+    {
+        return;
+    }
+    lseek(fd, 0, SEEK_END);
+    if (write(fd, buffer.data(), buffer.size()) != (ssize_t)buffer.size())
+    {
+        debug_log("Unable to append to " + timing_history_file());
+    }
+    close(fd);
+}
+
+// Runtime Model
+double PredictRuntimeSeconds(const JobFeatures &features)
+{
+    // Same calculation type and method first, then any method of that type.
+    const std::vector<TimingRecord> &history = load_timing_history();
+    std::vector<double> x = {}, y = {};
+    for (int pass = 0; pass < 2 && x.empty(); pass++)
+    {
+        for (const TimingRecord &record : history)
+        {
+            if (record.features.calc_type != features.calc_type || record.features.n_basis == 0 || record.seconds <= 0)
+            {
+                continue;
+            }
+            if (pass == 0 && record.features.method != features.method)
+            {
+                continue;
+            }
+            x.push_back(log((double)record.features.n_basis));
+            y.push_back(log(record.seconds / std::max(1, record.features.steps)));
+        }
+    }
+    double nbf = std::max<double>(features.n_basis, 1.0);
+    if (x.empty())
+    {
+        // Rough GPU DFT prior: an energy at 1000 basis functions takes DEFAULT_PRIOR_ENERGY_SECONDS and grows
+        // as nbf^2.5, about what TeraChem's screened Fock builds show over 500-5000 functions; a gradient costs 2.5 energies.
+        double evaluations = 1.0;
+        if (features.calc_type == "OPT") evaluations = 2.5 * (10.0 + 0.5 * features.n_atoms);
+        if (features.calc_type == "FREQ") evaluations = 2.5 * (6.0 * features.n_atoms + 1.0);
+        if (features.calc_type == "BOMD" || features.calc_type == "TS") evaluations = 2.5 * features.steps;
+        return DEFAULT_PRIOR_ENERGY_SECONDS * pow(nbf / 1000.0, DEFAULT_PRIOR_SCALING_EXPONENT) * evaluations;
+    }
+
+    // log t = log c + p log nbf, with p fit only when the history spans a useful range of sizes.
+    double exponent = 3.0;
+    double x_mean = 0.0, y_mean = 0.0;
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x_mean += x[i] / x.size();
+        y_mean += y[i] / x.size();
+    }
+    double x_min = *std::min_element(x.begin(), x.end());
+    double x_max = *std::max_element(x.begin(), x.end());
+    if (x.size() >= 3 && x_max - x_min > log(1.5))
+    {
+        double sxy = 0.0, sxx = 0.0;
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            sxy += (x[i] - x_mean) * (y[i] - y_mean);
+            sxx += (x[i] - x_mean) * (x[i] - x_mean);
+        }
+        exponent = std::min(4.0, std::max(1.0, sxy / sxx));
+    }
+    std::vector<double> intercepts = {};
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        intercepts.push_back(y[i] - exponent * x[i]);
+    }
+    std::nth_element(intercepts.begin(), intercepts.begin() + intercepts.size() / 2, intercepts.end());
+    double intercept = intercepts[intercepts.size() / 2];
+    return exp(intercept + exponent * log(nbf)) * std::max(1, features.steps);
+}
+
+std::string SlurmWalltime(int minutes)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << minutes / 60 << ":" << std::setw(2) << std::setfill('0') << minutes % 60 << ":00";
+    return buffer.str();
+}
+
+JobResources EstimateJobResources(const JobFeatures &features)
+{
+    JobResources resources;
+    if (features.n_basis == 0)
+    {
+        return resources;
+    }
+    double nbf = features.n_basis;
+
+    // Walltime: padded prediction, rounded up to 15 minutes.
+    double minutes = DEFAULT_WALLTIME_SAFETY_FACTOR * PredictRuntimeSeconds(features) / 60.0 + 10.0;
+    int walltime = 15 * (int)ceil(minutes / 15.0);
+    resources.walltime_minutes = std::min(DEFAULT_SLURM_MAX_WALLTIME_MINUTES, std::max(DEFAULT_SLURM_MIN_WALLTIME_MINUTES, walltime));
+
+    // GPUs only pay off once the Fock builds are large.
+    resources.gpus = (nbf < 1500) ? 1 : ((nbf < 4000) ? 2 : DEFAULT_SLURM_MAX_GPUS);
+    resources.cpus = resources.gpus + 2;
+
+    // Host memory holds a few dozen nbf^2 double matrices; gpumem (MB) about six per GPU.
+    // Never below the old fixed request, which is known to be safe, since memory use is not recorded.
+    double matrix_gb = nbf * nbf * 8.0 / 1.0e9;
+    resources.mem_gb = std::min(DEFAULT_SLURM_MAX_MEMORY_GB, std::max(DEFAULT_SLURM_MIN_MEMORY_GB, (int)ceil(2.0 + 40.0 * matrix_gb + 0.002 * features.n_atoms)));
+    resources.gpumem = std::max(256, 256 * (int)ceil(6.0 * matrix_gb * 1000.0 / 256.0));
+    return resources;
+}
+
+JobResources CombineJobResources(const JobResources &a, const JobResources &b, bool sequential)
+{
+    // Sequential steps share one allocation: walltimes add, everything else takes the larger request.
+    JobResources combined;
+    combined.walltime_minutes = sequential ? std::min(DEFAULT_SLURM_MAX_WALLTIME_MINUTES, a.walltime_minutes + b.walltime_minutes) : std::max(a.walltime_minutes, b.walltime_minutes);
+    combined.cpus = std::max(a.cpus, b.cpus);
+    combined.gpus = std::max(a.gpus, b.gpus);
+    combined.mem_gb = std::max(a.mem_gb, b.mem_gb);
+    combined.gpumem = std::max(a.gpumem, b.gpumem);
+    combined.gres = a.gres.empty() ? b.gres : a.gres;
+    return combined;
+}
+
+JobResources TuneJobKeywords(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords)
+{
+    // 'gpus' and 'gpumem' given on the command line are kept as they are.
+    JobResources resources;
+    if (!AUTOTUNE)
+    {
+        return resources;
+    }
+    JobFeatures features = JobFeaturesFromKeywords(keywords);
+    if (features.n_basis == 0)
+    {
+        return resources;
+    }
+    resources = EstimateJobResources(features);
+    if (flags.count("gpus") > 0)
+    {
+        resources.gpus = std::max(1, atoi(keywords["gpus"].c_str()));
+        resources.cpus = resources.gpus + 2;
+    }
+    if (flags.count("gpumem") > 0)
+    {
+        resources.gpumem = atoi(keywords["gpumem"].c_str());
+    }
+    keywords["gpus"] = std::to_string(resources.gpus);
+    keywords["gpumem"] = std::to_string(resources.gpumem);
+    debug_log(features.calc_type + " with " + std::to_string(features.n_atoms) + " QM atoms and ~" + std::to_string(features.n_basis) + " basis functions: " + SlurmWalltime(resources.walltime_minutes) + ", " + std::to_string(resources.gpus) + " GPU(s), " + std::to_string(resources.mem_gb) + "GB, gpumem " + std::to_string(resources.gpumem));
+    return resources;
+}
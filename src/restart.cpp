@@ -0,0 +1,275 @@
+#include "restart.h"
+#include "logger.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+bool AUTO_RESTART = true;
+int MAX_RESTARTS = DEFAULT_MAX_RESTARTS;
+std::string RESTART_CHECK_DIR = "";
+std::string RESTART_CHECK_JOB = "";
+
+void check_restart_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("no_restart") > 0)
+    {
+        AUTO_RESTART = false;
+        flags.erase("no_restart");
+    }
+    if (flags.count("max_restarts") > 0)
+    {
+        if (!flags["max_restarts"].empty())
+        {
+            MAX_RESTARTS = std::max(0, std::stoi(flags["max_restarts"][0]));
+        }
+        flags.erase("max_restarts");
+    }
+    if (flags.count("restart_check") > 0)
+    {
+        RESTART_CHECK_DIR = flags["restart_check"].empty() ? "." : flags["restart_check"][0];
+        if (flags["restart_check"].size() > 1)
+        {
+            RESTART_CHECK_JOB = flags["restart_check"][1];
+        }
+        flags.erase("restart_check");
+    }
+}
+
+bool IsRestartableCalculation(std::string run_type)
+{
+    // A TS search runs a frozen-endpoint band that one frame of optim.xyz cannot restart.
+    return (run_type == "minimize");
+}
+
+bool is_transient_gpu_error(std::string error)
+{
+    for (std::string marker : {"CUDA", "cuda", "GPU", "ECC", "Xid"})
+    {
+        if (error.find(marker) != std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+RestartReason DiagnoseInterruptedRun(const TCOutputResults &results, std::string slurm_state)
+{
+    // The scheduler's word wins; otherwise a missing "Job finished" banner without an error means the run was cut short.
+    if (slurm_state == "TIMEOUT" || slurm_state == "PREEMPTED" || slurm_state == "NODE_FAIL")
+    {
+        return RESTART_SCHEDULER;
+    }
+    if (results.finished && results.errors.empty())
+    {
+        return RESTART_NONE;
+    }
+    for (const std::string &error : results.errors)
+    {
+        if (is_transient_gpu_error(error))
+        {
+            return RESTART_GPU_ERROR;
+        }
+    }
+    if (!results.errors.empty() || slurm_state.rfind("CANCELLED", 0) == 0 || slurm_state == "OUT_OF_MEMORY")
+    {
+        return RESTART_FAILED;
+    }
+    return RESTART_INTERRUPTED;
+}
+
+std::string RestartReasonText(RestartReason reason)
+{
+    switch (reason)
+    {
+        case RESTART_INTERRUPTED: return "interrupted";
+        case RESTART_SCHEDULER:   return "stopped by the scheduler";
+        case RESTART_GPU_ERROR:   return "GPU error";
+        case RESTART_FAILED:      return "failed";
+        default:                  return "finished";
+    }
+}
+
+std::string RestartCheckCommand()
+{
+    // Run from the submit directory once a batch job's outputs have been staged back.
+    return AutoQuantumExecutable() + " --restart_check . \"${SLURM_JOB_ID:-}\" --max_restarts " + std::to_string(MAX_RESTARTS) + "\n";
+}
+
+int read_restart_attempts()
+{
+    std::ifstream fin(RESTART_STATE_FILE);
+    int attempts = 0;
+    if (!(fin >> attempts))
+    {
+        return 0;
+    }
+    return attempts;
+}
+
+std::string last_recorded_job_id()
+{
+    std::ifstream fin(JOB_ID_FILE);
+    std::string job_id, last = "";
+    while (fin >> job_id)
+    {
+        last = job_id;
+    }
+    return last;
+}
+
+void set_aside(std::string from, std::string to)
+{
+    std::error_code ec;
+    if (fs::exists(from, ec))
+    {
+        fs::rename(from, to, ec);
+        if (ec)
+        {
+            normal_log("Unable to move " + from + " to " + to + ": " + ec.message());
+        }
+    }
+}
+
+bool prepare_restart_here(std::string job_id, std::string slurm_state)
+{
+    ExecutorTask task;
+    if (!ExecutorTaskFromJobDir(task, ".") || fs::exists(CHAIN_STEPS_FILE))
+    {
+        return false;
+    }
+    std::map<std::string,std::string> keywords = {};
+    if (!Read_TC_Input_File(keywords, task.input) || !IsRestartableCalculation(keywords["run"]) || !fs::exists(task.output))
+    {
+        return false;
+    }
+    // Whoever restarts first (the batch script itself, or a watcher) records the new job; later callers see a stale ID.
+    if (!job_id.empty() && last_recorded_job_id() != job_id)
+    {
+        debug_log("Job " + job_id + " in " + fs::current_path().string() + " has already been resubmitted.");
+        return false;
+    }
+    RestartReason reason = DiagnoseInterruptedRun(ParseTCOutput(task.output), slurm_state);
+    if (reason == RESTART_NONE)
+    {
+        return false;
+    }
+    std::string here = fs::current_path().string();
+    if (reason == RESTART_FAILED)
+    {
+        normal_log(task.output + " in " + here + " failed; not restarting.");
+        return false;
+    }
+    int attempt = read_restart_attempts() + 1;
+    if (attempt > MAX_RESTARTS)
+    {
+        normal_log(task.output + " in " + here + " was " + RestartReasonText(reason) + ", but all " + std::to_string(MAX_RESTARTS) + " restart(s) are used up.");
+        return false;
+    }
+
+    // Set the partial run aside: tc_opt.out -> tc_opt.restart1.out, scr/ -> scr.restart1/.
+    std::string tag = ".restart" + std::to_string(attempt);
+    std::string stem = fs::path(task.input).stem().string();
+    set_aside(task.output, stem + tag + ".out");
+    set_aside(task.output + ".aqres", stem + tag + ".out.aqres");
+    set_aside(task.error, stem + tag + ".err");
+    std::string scrdir = keywords.count("scrdir") > 0 ? keywords["scrdir"] : "scr/";
+    std::string old_scrdir = scrdir;
+    while (old_scrdir.size() > 1 && old_scrdir.back() == '/')
+    {
+        old_scrdir.pop_back();
+    }
+    old_scrdir += tag + "/";
+    set_aside(scrdir, old_scrdir);
+
+    // Start from the last completed geometry and the last orbitals.
+    XYZFrames last = ReadLastFrame(old_scrdir + "optim.xyz");
+    if (last.n_atoms > 0)
+    {
+        std::string geometry = "restart" + std::to_string(attempt) + ".xyz";
+        write_to_file(geometry, FrameToXYZ(last, 0));
+        keywords["coordinates"] = geometry;
+    }
+    std::string guess = carry_forward_guess(old_scrdir);
+    if (!guess.empty())
+    {
+        keywords["guess"] = guess;
+    }
+    std::string blocks = Read_TC_Input_Blocks(task.input);
+    Write_TC_Input_File(keywords, task.input);
+    if (!blocks.empty())
+    {
+        append_to_file(task.input, blocks);
+    }
+    write_to_file(RESTART_STATE_FILE, std::to_string(attempt) + "\n");
+    normal_log(task.output + " in " + here + " was " + RestartReasonText(reason) + "; restart " + std::to_string(attempt) + " of " + std::to_string(MAX_RESTARTS) + " starts from '" + keywords["coordinates"] + "' with guess '" + guess + "'.");
+    return true;
+}
+
+bool PrepareRestart(std::string job_dir, std::string job_id, std::string slurm_state)
+{
+    if (!AUTO_RESTART || !fs::is_directory(job_dir))
+    {
+        return false;
+    }
+    fs::path previous = fs::current_path();
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    bool prepared = prepare_restart_here(job_id, slurm_state);
+    fs::current_path(previous);
+    SetLogJobDirectory(".");
+    return prepared;
+}
+
+std::string RestartInterruptedJob(std::string job_dir, std::string job_id, std::string slurm_state)
+{
+    // Returns the new SLURM job ID, or an empty string when nothing was resubmitted.
+    // The state file stays locked until sbatch has answered, so only one caller resubmits.
+    std::string state_file = (fs::path(job_dir) / RESTART_STATE_FILE).string();
+    int lock_fd = open(state_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+    {
+        normal_log("Unable to lock " + state_file);
+        if (lock_fd >= 0)
+        {
+            close(lock_fd);
+        }
+        return "";
+    }
+    std::string new_job_id = "";
+    std::string script = (fs::path(job_dir) / "AutoQuantum_TC_Job.sh").string();
+    if (fs::exists(script) && PrepareRestart(job_dir, job_id, slurm_state))
+    {
+        new_job_id = ParseSbatchJobId(SubmitBatchScript("AutoQuantum_TC_Job.sh", job_dir));
+        if (!new_job_id.empty())
+        {
+            normal_log("Resubmitted " + job_dir + " as job " + new_job_id);
+        }
+    }
+    close(lock_fd);
+    return new_job_id;
+}
+
+void RunRestartCheckMode()
+{
+    // Batch jobs are submitted again; a run started directly is rerun in place.
+    if (fs::exists(fs::path(RESTART_CHECK_DIR) / "AutoQuantum_TC_Job.sh") && (UseSlurmSubmission() || !RESTART_CHECK_JOB.empty()))
+    {
+        RestartInterruptedJob(RESTART_CHECK_DIR, RESTART_CHECK_JOB, "");
+        return;
+    }
+    ExecutorTask task;
+    if (!ExecutorTaskFromJobDir(task, RESTART_CHECK_DIR))
+    {
+        error_log("No TeraChem input found in " + RESTART_CHECK_DIR, 1);
+    }
+    fs::current_path(RESTART_CHECK_DIR);
+    SetLogJobDirectory(".");
+    TC_FILENAME = task.input;
+    TC_OUTFILE = task.output;
+    TC_ERRFILE = task.error;
+    while (PrepareRestart(".", "", ""))
+    {
+        RunTeraChem();
+    }
+}
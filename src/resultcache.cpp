@@ -0,0 +1,276 @@
+#include "resultcache.h"
+#include <unistd.h>
+#include <mutex>
+
+bool RESULT_CACHE = true;
+std::string RESULT_CACHE_DIR = "";
+double RESULT_CACHE_GUESS_RMSD = 0.1;
+
+void check_result_cache_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("no_cache") > 0)
+    {
+        RESULT_CACHE = false;
+        flags.erase("no_cache");
+    }
+    if (flags.count("result_cache") > 0)
+    {
+        if (!flags["result_cache"].empty())
+        {
+            RESULT_CACHE_DIR = flags["result_cache"][0];
+        }
+        flags.erase("result_cache");
+    }
+    if (flags.count("cache_guess_rmsd") > 0)
+    {
+        if (!flags["cache_guess_rmsd"].empty())
+        {
+            RESULT_CACHE_GUESS_RMSD = std::stod(flags["cache_guess_rmsd"][0]);
+        }
+        flags.erase("cache_guess_rmsd");
+    }
+    if (RESULT_CACHE_DIR.empty())
+    {
+        RESULT_CACHE_DIR = autoquantum_cache_directory() + "results";
+    }
+    if (RESULT_CACHE_DIR.back() != '/')
+    {
+        RESULT_CACHE_DIR += "/";
+    }
+}
+
+std::string content_hash(const std::string &data)
+{
+    // Two FNV-1a lanes with different offsets, as 32 hex characters.
+    uint64_t a = 14695981039346656037ull;
+    uint64_t b = 0x84222325cbf29ce4ull;
+    for (unsigned char c : data)
+    {
+        a = (a ^ c) * 1099511628211ull;
+        b = (b ^ c) * 0x100000001b3ull;
+        b ^= b >> 29;
+    }
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::hex << std::setw(16) << std::setfill('0') << a << std::setw(16) << std::setfill('0') << b;
+    return buffer.str();
+}
+
+std::string read_whole_file(std::string filename, bool &ok)
+{
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    ok = fin.is_open();
+    std::stringstream buffer;
+    buffer << fin.rdbuf();
+    return buffer.str();
+}
+
+XYZFrames read_first_frame(std::string filename)
+{
+    XYZTrajectory trajectory;
+    XYZFrames frames;
+    if (OpenTrajectory(trajectory, filename) && TrajectoryFrameCount(trajectory) > 0)
+    {
+        ReadTrajectoryFrames(frames, trajectory, {0}, 1);
+    }
+    CloseTrajectory(trajectory);
+    return frames;
+}
+
+CacheKey ResultCacheKey(std::map<std::string,std::string> keywords, std::string input_blocks)
+{
+    CacheKey key;
+    if (!RESULT_CACHE)
+    {
+        return key;
+    }
+    std::stringstream chemistry, geometry;
+    chemistry.str("");
+    geometry.str("");
+
+    // Keywords that name files or resources, not physics, are left out; file contents stand in for file names.
+    std::set<std::string> skipped = {"coordinates", "prmtop", "qmindices", "scrdir", "guess", "gpus", "gpumem"};
+    for (auto &keyword : keywords)
+    {
+        if (skipped.count(keyword.first) == 0)
+        {
+            chemistry << keyword.first << "=" << keyword.second << "\n";
+        }
+    }
+    chemistry << input_blocks;
+    for (std::string file_key : {"prmtop", "qmindices"})
+    {
+        if (keywords.count(file_key) > 0)
+        {
+            bool ok = false;
+            std::string contents = read_whole_file(keywords[file_key], ok);
+            if (!ok)
+            {
+                return key;
+            }
+            chemistry << file_key << "#" << content_hash(contents) << "\n";
+        }
+    }
+
+    // Geometry is normalized: element names upper-cased, coordinates rounded to 1e-6 Angstrom.
+    XYZFrames frames = read_first_frame(keywords["coordinates"]);
+    if (frames.n_atoms == 0)
+    {
+        return key;
+    }
+    geometry << std::fixed << std::setprecision(6);
+    for (size_t a = 0; a < frames.n_atoms; a++)
+    {
+        std::string element = frames.elements[a];
+        std::transform(element.begin(), element.end(), element.begin(), ::toupper);
+        chemistry << element << " ";
+        geometry << frames.x[a] + 0.0 << " " << frames.y[a] + 0.0 << " " << frames.z[a] + 0.0 << "\n";
+    }
+    key.chemistry = content_hash(chemistry.str());
+    key.exact = content_hash(chemistry.str() + geometry.str());
+    key.valid = true;
+    return key;
+}
+
+std::map<std::string,std::string> read_cache_entry(std::string hash)
+{
+    std::map<std::string,std::string> entry = {};
+    std::ifstream fin(RESULT_CACHE_DIR + hash + ".entry");
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        size_t space = line.find(' ');
+        if (space != std::string::npos)
+        {
+            entry[line.substr(0, space)] = line.substr(space + 1);
+        }
+    }
+    return entry;
+}
+
+bool cached_run_finished(std::map<std::string,std::string> &entry)
+{
+    std::string output = entry["job_dir"] + "/" + entry["output"];
+    if (entry["job_dir"].empty() || !fs::exists(output))
+    {
+        return false;
+    }
+    TCOutputResults results;
+    return PeekTCOutput(results, output) && results.finished && results.errors.empty();
+}
+
+std::string LookupCachedResult(const CacheKey &key)
+{
+    if (!key.valid)
+    {
+        return "";
+    }
+    std::map<std::string,std::string> entry = read_cache_entry(key.exact);
+    if (entry.empty())
+    {
+        return "";
+    }
+    if (!cached_run_finished(entry))
+    {
+        debug_log("Cached run for " + key.exact + " in " + entry["job_dir"] + " has not finished cleanly, running again.");
+        return "";
+    }
+    return entry["job_dir"];
+}
+
+std::string LookupCachedGuess(const CacheKey &key, std::string coordinates)
+{
+    // The closest finished run on the same system, within the RMSD limit, lends its orbitals.
+    if (!key.valid)
+    {
+        return "";
+    }
+    XYZFrames target = read_first_frame(coordinates);
+    std::ifstream fin(RESULT_CACHE_DIR + key.chemistry + ".near");
+    std::string hash, best_guess = "";
+    double best_rmsd = RESULT_CACHE_GUESS_RMSD;
+    while (fin >> hash)
+    {
+        std::map<std::string,std::string> entry = read_cache_entry(hash);
+        if (entry.empty() || !cached_run_finished(entry))
+        {
+            continue;
+        }
+        XYZFrames cached = read_first_frame(entry["job_dir"] + "/" + entry["coordinates"]);
+        if (cached.n_atoms != target.n_atoms)
+        {
+            continue;
+        }
+        double sum = 0.0;
+        for (size_t a = 0; a < target.n_atoms; a++)
+        {
+            double dx = target.x[a] - cached.x[a], dy = target.y[a] - cached.y[a], dz = target.z[a] - cached.z[a];
+            sum += dx*dx + dy*dy + dz*dz;
+        }
+        double rmsd = sqrt(sum / std::max<size_t>(target.n_atoms, 1));
+        std::string scrdir = entry["job_dir"] + "/" + entry["scrdir"];
+        if (scrdir.back() != '/')
+        {
+            scrdir += "/";
+        }
+        std::string guess = "";
+        if (fs::exists(scrdir + "c0"))
+        {
+            guess = scrdir + "c0";
+        }
+        else if (fs::exists(scrdir + "ca0") && fs::exists(scrdir + "cb0"))
+        {
+            guess = scrdir + "ca0 " + scrdir + "cb0";
+        }
+        if (!guess.empty() && rmsd <= best_rmsd)
+        {
+            best_rmsd = rmsd;
+            best_guess = guess;
+        }
+    }
+    return best_guess;
+}
+
+std::mutex NEAR_INDEX_LOCK;
+
+void RegisterCachedResult(const CacheKey &key, std::string job_dir, std::string output, std::map<std::string,std::string> keywords)
+{
+    // Registered when the job is prepared; a later lookup only trusts it once the output shows a clean finish.
+    if (!key.valid)
+    {
+        return;
+    }
+    std::error_code ec;
+    fs::create_directories(RESULT_CACHE_DIR, ec);
+    std::string absolute = fs::absolute(job_dir).string();
+    while (absolute.size() > 1 && (absolute.back() == '/' || (absolute.back() == '.' && absolute[absolute.size()-2] == '/')))
+    {
+        absolute.pop_back();
+    }
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "job_dir " << absolute << std::endl;
+    buffer << "output " << output << std::endl;
+    buffer << "scrdir " << keywords["scrdir"] << std::endl;
+    buffer << "coordinates " << fs::path(keywords["coordinates"]).filename().string() << std::endl;
+    buffer << "chemistry " << key.chemistry << std::endl;
+    std::string entry_file = RESULT_CACHE_DIR + key.exact + ".entry";
+    std::string temporary = entry_file + "." + std::to_string(getpid()) + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    write_to_file(temporary, buffer.str());
+    fs::rename(temporary, entry_file, ec);
+
+    // A rerun rewrites its entry above, but is listed among its near neighbours only once.
+    std::lock_guard<std::mutex> guard(NEAR_INDEX_LOCK);
+    std::string near_file = RESULT_CACHE_DIR + key.chemistry + ".near";
+    std::ifstream fin(near_file);
+    std::string hash;
+    while (fin >> hash)
+    {
+        if (hash == key.exact)
+        {
+            return;
+        }
+    }
+    fin.close();
+    append_to_file(near_file, key.exact + "\n");
+}
@@ -0,0 +1,89 @@
+#include "staging.h"
+
+std::string StagedScriptBody(const StagingPlan &plan, std::string run_lines)
+{
+    std::stringstream inputs, tc_inputs, outputs;
+    inputs.str("");
+    tc_inputs.str("");
+    outputs.str("");
+    for (std::string file : plan.inputs) inputs << " " << file;
+    for (std::string file : plan.tc_inputs) tc_inputs << " " << file;
+    for (std::string file : plan.outputs) outputs << " " << file;
+
+    // The script itself contains )" sequences, hence the SH raw-string delimiter.
+    std::string buffer=R"SH(
+# Stage in: only the inputs this job needs, into a directory of its own.
+RETURN_DIR="$PWD"
+STAGE="${TMPDIR:-/tmp}/autoquantum.${SLURM_JOB_ID:-$$}"
+COPY_THREADS="${SLURM_CPUS_ON_NODE:-)SH" + std::to_string(DEFAULT_STAGE_COPY_THREADS) + R"SH(}"
+export RETURN_DIR STAGE
+mkdir -p "$STAGE"
+for f in)SH" + inputs.str() + R"SH(; do
+    [ -e "$f" ] && cp -pR "$f" "$STAGE/"
+done
+for input in)SH" + tc_inputs.str() + R"SH(; do
+    [ -f "$input" ] || continue
+    cp -p "$input" "$STAGE/"
+    for ref in $(awk 'tolower($1) ~ /^(coordinates|prmtop|qmindices|guess)$/ { for (i = 2; i <= NF; i++) print $i }' "$input"); do
+        case "$ref" in
+            /*) ;;
+            *) if [ -f "$ref" ]; then mkdir -p "$STAGE/$(dirname "$ref")"; cp -p "$ref" "$STAGE/$ref"; fi ;;
+        esac
+    done
+done
+
+# Stage out: declared outputs only, copied as they are (they are read back later) in parallel.
+stage_out()
+{
+    cd "$STAGE" || return
+    for f in)SH" + outputs.str() + R"SH(; do
+        [ -e "$f" ] || continue
+        find "$f" -type f -print0
+    done | xargs -0 -r -P "$COPY_THREADS" -I{} sh -c '
+        mkdir -p "$RETURN_DIR/$(dirname "$1")" && cp -p "$1" "$RETURN_DIR/$1"' _ {}
+}
+cleanup()
+{
+    trap - EXIT
+    kill $MIRROR_PID 2>/dev/null
+    if stage_out; then
+        cd "$RETURN_DIR"
+        rm -rf "$STAGE"
+    else
+        cd "$RETURN_DIR"
+        echo "AutoQuantum: stage-out failed, the scratch copy is kept in $STAGE" >&2
+    fi
+)SH" + plan.after_stage_out + R"SH(}
+trap cleanup EXIT
+trap 'kill $RUN_PID 2>/dev/null; wait $RUN_PID 2>/dev/null; exit 143' TERM INT USR1 XCPU
+
+# Copy TeraChem outputs back while the job runs, so --status and --watch can follow it.
+# The pending sleep is killed with the loop, so nothing outlives the job script.
+(
+    trap 'kill $SLEEP_PID 2>/dev/null; exit 0' TERM
+    while :; do
+        sleep )SH" + std::to_string(DEFAULT_STAGE_MIRROR_SECONDS) + R"SH( &
+        SLEEP_PID=$!
+        wait $SLEEP_PID
+        for f in "$STAGE"/tc_*.out "$STAGE"/*/tc_*.out; do
+            [ -f "$f" ] || continue
+            name="${f#"$STAGE"/}"
+            [ "$f" -nt "$RETURN_DIR/$name" ] || continue
+            part="$(dirname "$RETURN_DIR/$name")/.${f##*/}.part"
+            cp -p "$f" "$part" && mv -f "$part" "$RETURN_DIR/$name"
+        done
+    done
+) &
+MIRROR_PID=$!
+
+# Run in the background so scheduler signals are handled immediately.
+cd "$STAGE"
+(
+)SH" + run_lines + R"SH() &
+RUN_PID=$!
+wait $RUN_PID
+exit $?
+
+)SH";
+    return buffer;
+}
@@ -1,4 +1,14 @@
 #include "tcinterface.h"
+#include "process.h"
+#include "modules.h"
+#include "staging.h"
+#include "resultcache.h"
+#include "resources.h"
+#include "monitor.h"
+#include "restart.h"
+#include "amber.h"
+#include "adaptive.h"
+#include "trace.h"
 
 //identify known terachem flags/keywords
 std::map<std::string, std::string> TC_ANY_DEFAULTS = {{"coordinates"       , "input.xyz" },
@@ -144,18 +154,19 @@ void get_calc_type(std::map<std::string,std::vector<std::string>> &flags)
 }
 
 // Identify maximum keyword length, then pad for writing to file.
-unsigned int MAX_KEY_LEN = 19; // current maximum from all defaults in file.
+unsigned int MAX_KEY_LEN = 19 + 4; // current maximum from all defaults in file, plus padding.
 void get_max_keyword_length(std::map<std::string,std::vector<std::string>> flags)
 {
+    unsigned int longest = 19; // current maximum from all defaults in file.
     for(std::map<std::string, std::vector<std::string>>::iterator iter = flags.begin(); iter != flags.end(); iter++)
     {
         std::string k =  iter->first;
-        if (k.size() > MAX_KEY_LEN)
+        if (k.size() > longest)
         {
-            MAX_KEY_LEN = k.size();
+            longest = k.size();
         }
     }
-    MAX_KEY_LEN+=4; // Add 4 characters of padding to the end just to make the input file nice and tidy.
+    MAX_KEY_LEN = longest + 4; // Add 4 characters of padding to the end just to make the input file nice and tidy.
 }
 
 // Write TeraChem Input
@@ -220,21 +231,21 @@ void generate_full_keyword_set(std::map<std::string,std::vector<std::string>> &f
 
 void move_to_jobdir(std::map<std::string,std::string> keywords, std::string jobdir)
 {
-    std::stringstream buffer;
-    buffer.str("");
-    if (keywords.count("qmindices")>0)
-    {
-        buffer << "cp " << keywords["qmindices"] << " " << jobdir << "/" <<std::endl;
-    }
-    if (keywords.count("prmtop") > 0)
+    TraceScope trace("copy_inputs");
+    for (std::string key : {"qmindices", "prmtop", "coordinates"})
     {
-        buffer << "cp " << keywords["prmtop"] << " " << jobdir << "/" <<std::endl;
-    }
-    if (keywords.count("coordinates") > 0)
-    {
-        buffer << "cp " << keywords["coordinates"] << " " << jobdir << "/" <<std::endl;
+        if (keywords.count(key) == 0)
+        {
+            continue;
+        }
+        fs::path source = keywords[key];
+        std::error_code ec;
+        fs::copy_file(source, fs::path(jobdir) / source.filename(), fs::copy_options::overwrite_existing, ec);
+        if (ec)
+        {
+            normal_log("Unable to copy " + source.string() + " to " + jobdir + ": " + ec.message());
+        }
     }
-    silent_shell(buffer.str());
 }
 
 std::string tc_input_keyword_line(std::map<std::string,std::string> &keywords, std::string key)
@@ -243,7 +254,7 @@ std::string tc_input_keyword_line(std::map<std::string,std::string> &keywords, s
     buffer.str("");
     if (keywords.count(key) > 0)
     {
-        buffer << std::left << std::setw(MAX_KEY_LEN) << std::setfill(' ') << key;
+        buffer << std::left << std::setw(std::max<size_t>(MAX_KEY_LEN, key.size() + 1)) << std::setfill(' ') << key;
         buffer << std::left << keywords[key] << std::endl;
         keywords.erase(keywords.find(key));
     }        
@@ -347,35 +358,39 @@ std::string RemainingKeywordSection(std::map<std::string,std::string> &keywords)
     std::stringstream buffer;
     buffer.str("");
     buffer << "# Uncategorized Keywords " << std::endl;
-    for (std::map<std::string,std::string>::iterator iter=keywords.begin(); iter != keywords.end(); iter++)
+    while (!keywords.empty())
     {
-        buffer << tc_input_keyword_line(keywords,iter->first);
+        buffer << tc_input_keyword_line(keywords,keywords.begin()->first);
     }
     buffer << std::endl;
     return buffer.str();
 }
 
-void Write_TC_Input(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords)
+void Prepare_TC_Keywords(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords)
 {
+    TraceScope trace("generate_keywords");
     // identify calculation type
     get_calc_type(flags);
     // identify maximum keyword length
     get_max_keyword_length(flags);
     // parse all the keywords from defaults and command line into a single set.
     generate_full_keyword_set(flags,keywords);
+    // build qmindices from a --qm_region selection on the Amber topology.
+    SelectQMRegion(flags,keywords);
+    // size the job's resource requests and gpus/gpumem from the molecule.
+    JOB_RESOURCES = TuneJobKeywords(flags,keywords);
+}
 
-    // Prepare working directory
-    std::string job_dir = MakeIterativeDirectoryName("AutoQuantum", 4);
-    move_to_jobdir(keywords,job_dir);
-    fs::current_path(job_dir);
-    normal_log("Copied relevant input files to " + job_dir);
-
-    std::ofstream ofile(TC_FILENAME,std::ios::out);
+bool Write_TC_Input_File(std::map<std::string,std::string> keywords, std::string filename)
+{
+    TraceScope trace("write_input");
+    // keywords is taken by value, since each section consumes the keys it writes.
+    std::ofstream ofile(filename,std::ios::out);
     
     // Check that file successfully opened for writing.
     if (! ofile.is_open())
     {
-        error_log("Unable to open " + TC_FILENAME + " for writing.  Check permissions", 1);
+        return false;
     }
     
     // Include comment line for input file that identifies it was generated with AutoQuantum.
@@ -396,29 +411,172 @@ void Write_TC_Input(std::map<std::string,std::vector<std::string>> &flags, std::
     
     // Close the TeraChem input file.
     ofile.close();
+    return true;
 }
 
-void SubmitSlurmJob(std::map<std::string,std::string> keywords)
+bool Read_TC_Input_File(std::map<std::string,std::string> &keywords, std::string filename)
+{
+    // Recover the keyword set from a generated input; '$' blocks are left to the caller.
+    std::ifstream fin(filename);
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    std::string line;
+    bool in_block = false;
+    while (std::getline(fin, line))
+    {
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        if (line[first] == '$')
+        {
+            in_block = (line.substr(first, 4) != "$end");
+            continue;
+        }
+        if (in_block)
+        {
+            continue;
+        }
+        size_t key_end = line.find_first_of(" \t", first);
+        std::string key = line.substr(first, key_end - first);
+        std::string value = "";
+        if (key_end != std::string::npos && line.find_first_not_of(" \t", key_end) != std::string::npos)
+        {
+            value = line.substr(line.find_first_not_of(" \t", key_end));
+            value.erase(value.find_last_not_of(" \t\r") + 1);
+        }
+        keywords[key] = value;
+    }
+    fin.close();
+    return true;
+}
+
+std::string Read_TC_Input_Blocks(std::string filename)
+{
+    // '$' blocks (constraints) are not keywords, so they are carried over to the rewritten input as text.
+    std::ifstream fin(filename);
+    std::string line, blocks = "";
+    bool in_block = false;
+    while (std::getline(fin, line))
+    {
+        size_t first = line.find_first_not_of(" \t");
+        bool marker = (first != std::string::npos && line[first] == '$');
+        if (marker || in_block)
+        {
+            blocks += line + "\n";
+        }
+        if (marker)
+        {
+            in_block = (line.substr(first, 4) != "$end");
+        }
+    }
+    return blocks;
+}
+
+std::string MMFrozenBlock()
+{
+    // Atoms beyond --mm_cutoff of the QM region, as picked by SelectQMRegion.
+    return MM_FROZEN_ATOMS.empty() ? "" : "$constraint_freeze\nxyz " + format_index_ranges(MM_FROZEN_ATOMS) + "\n$end\n";
+}
+
+bool Write_TC_Input(std::map<std::string,std::vector<std::string>> &flags, std::map<std::string,std::string> &keywords)
+{
+    Prepare_TC_Keywords(flags,keywords);
+
+    // Skip calculations that have already been run, or borrow orbitals from a close one.
+    std::string frozen_block = MMFrozenBlock();
+    CacheKey cache_key = ResultCacheKey(keywords, frozen_block);
+    std::string prior_dir = LookupCachedResult(cache_key);
+    if (!prior_dir.empty())
+    {
+        normal_log("An identical calculation has already finished in " + prior_dir + "; it will not be run again.");
+        return false;
+    }
+    std::string cached_guess = LookupCachedGuess(cache_key, keywords["coordinates"]);
+    if (!cached_guess.empty() && keywords.count("guess") == 0)
+    {
+        keywords["guess"] = cached_guess;
+        normal_log("Using orbitals from a cached calculation as the initial guess: " + cached_guess);
+    }
+
+    // Prepare working directory
+    std::string job_dir = MakeIterativeDirectoryName("AutoQuantum", 4);
+    move_to_jobdir(keywords,job_dir);
+    fs::current_path(job_dir);
+    SetLogJobDirectory(".");
+    normal_log("Copied relevant input files to " + job_dir);
+
+    // Refer to the copies in the job directory rather than the originals.
+    for (std::string key : {"coordinates", "prmtop", "qmindices"})
+    {
+        if (keywords.count(key) > 0)
+        {
+            keywords[key] = fs::path(keywords[key]).filename().string();
+        }
+    }
+
+    if (! Write_TC_Input_File(keywords,TC_FILENAME))
+    {
+        error_log("Unable to open " + TC_FILENAME + " for writing.  Check permissions", 1);
+    }
+    if (!frozen_block.empty())
+    {
+        append_to_file(TC_FILENAME, frozen_block);
+    }
+    if (!DRYRUN)
+    {
+        RegisterCachedResult(cache_key, ".", TC_OUTFILE, keywords);
+        RecordPendingTiming(JobFeaturesFromKeywords(keywords), TC_OUTFILE);
+    }
+    return true;
+}
+
+std::string SlurmJobHeader(std::string job_name, std::string outfile, std::string errfile)
 {
     std::string buffer=R"(#!/bin/bash
-#SBATCH -t 120:00:00
+#SBATCH -t )" + SlurmWalltime(JOB_RESOURCES.walltime_minutes) + R"(
 #SBATCH -q )" + (std::string)DEFAULT_SLURM_GPU_JOB_QUEUE + R"(
 #SBATCH -p )" + (std::string)DEFAULT_SLURM_GPU_JOB_PARTITION + R"(
 #SBATCH -N 1
-#SBATCH -n 3
-#SBATCH -o slurm_)" + TC_OUTFILE + R"(
-#SBATCH -e slurm_)" + TC_ERRFILE + R"(
-#SBATCH --job-name AutoQuantum_TC_)" + CALC_TYPE + R"(
-#SBATCH --gres=gpu:1
-#SBATCH --mem=20GB
-
-module load )" + (std::string)DEFAULT_TERACHEM_MODULE + R"(
-cp ./* /tmp/
-cd /tmp/
-terachem -i )" + TC_FILENAME + R"( 1> )" + TC_OUTFILE + R"( 2> )" + TC_ERRFILE + R"(
-cp -r ./* $SLURM_SUBMIT_DIR/
-
+#SBATCH -n )" + std::to_string(JOB_RESOURCES.cpus) + R"(
+#SBATCH -o )" + outfile + R"(
+#SBATCH -e )" + errfile + R"(
+#SBATCH --job-name )" + job_name + R"(
+#SBATCH --gres=)" + (JOB_RESOURCES.gres.empty() ? "gpu:" + std::to_string(JOB_RESOURCES.gpus) : JOB_RESOURCES.gres) + R"(
+#SBATCH --mem=)" + std::to_string(JOB_RESOURCES.mem_gb) + R"(GB
+#SBATCH --signal=B:USR1@)" + std::to_string(DEFAULT_SLURM_SIGNAL_LEAD_SECONDS) + R"(
 )";
+    return buffer;
+}
+
+std::string SubmitBatchScript(std::string script, std::string working_dir)
+{
+    // Returns sbatch's response, e.g. "Submitted batch job 12345".
+    TraceScope trace("submit");
+    ProcessOptions options;
+    options.capture = true;
+    options.merge_stderr = true;
+    options.working_dir = working_dir;
+    Process process = RunProcess({"sbatch", script}, options);
+    if (process.exit_code != 0)
+    {
+        normal_log("sbatch " + script + " failed: " + process.output);
+    }
+    else if (!ParseSbatchJobId(process.output).empty())
+    {
+        // Keep the job ID for --status and --watch.
+        RecordSubmittedJob(ParseSbatchJobId(process.output), working_dir.empty() ? fs::current_path().string() : working_dir);
+    }
+    debug_log(process.output);
+    return process.output;
+}
+
+void SubmitSlurmScript(std::string job_name, std::string outfile, std::string errfile, std::string body)
+{
+    std::string buffer=SlurmJobHeader(job_name, outfile, errfile) + body;
     std::ofstream ofile("AutoQuantum_TC_Job.sh",std::ios::out);
     if (! ofile.is_open())
     {
@@ -426,23 +584,60 @@ cp -r ./* $SLURM_SUBMIT_DIR/
     }
     ofile << buffer;
     ofile.close();
-    silent_shell("sbatch AutoQuantum_TC_Job.sh");
+    SubmitBatchScript("AutoQuantum_TC_Job.sh", "");
 }
 
-void RunTeraChem()
+void SubmitSlurmJob(std::map<std::string,std::string> keywords)
 {
-    // Initialize buffer.
-    std::stringstream buffer;
-    buffer.str("");
+    StagingPlan plan;
+    plan.tc_inputs = {TC_FILENAME};
+    plan.outputs = {TC_OUTFILE, TC_ERRFILE};
+    if (keywords.count("scrdir") > 0)
+    {
+        plan.outputs.push_back(fs::path(keywords["scrdir"]).string());
+    }
+    if (AUTO_RESTART && IsRestartableCalculation(keywords["run"]))
+    {
+        // A run cut off by walltime or preemption is resubmitted from its last geometry.
+        plan.after_stage_out = "    " + RestartCheckCommand();
+    }
+    if (TRACE)
+    {
+        // Add TeraChem's SCF and gradient timings to the trace once the output is back.
+        plan.after_stage_out += "    " + AutoQuantumExecutable() + " --trace_report .\n";
+    }
+    std::string body = "\n" + ModuleScriptLines(DEFAULT_TERACHEM_MODULE) + StagedScriptBody(plan, "terachem -i " + TC_FILENAME + " 1> " + TC_OUTFILE + " 2> " + TC_ERRFILE + "\n");
+    SubmitSlurmScript("AutoQuantum_TC_" + CALC_TYPE, "slurm_" + TC_OUTFILE, "slurm_" + TC_ERRFILE, body);
+}
 
-    // See if a TeraChem module has already been loaded, then add to buffer if not.
-    std::string module_list = GetSysResponse("module list");
-    if (module_list.find("Terachem") == std::string::npos)
+std::string TeraChemExecutable()
+{
+    // AUTOQUANTUM_TERACHEM lets a stub program stand in for terachem, e.g. in tests.
+    const char *executable = getenv("AUTOQUANTUM_TERACHEM");
+    return (executable != nullptr && !is_empty(executable)) ? executable : "terachem";
+}
+
+std::map<std::string,std::string> TeraChemEnvironment()
+{
+    // Use terachem (or its stand-in) from the PATH if present, otherwise the cached module environment.
+    if (FindInPath(TeraChemExecutable()).empty())
     {
-        buffer << "module load " << DEFAULT_TERACHEM_MODULE << "; ";
+        return ModuleProcessEnvironment(ResolveModuleEnvironment(DEFAULT_TERACHEM_MODULE));
     }
-    buffer << "terachem -i " << TC_FILENAME << " 1> " << TC_OUTFILE << " 2> " << TC_ERRFILE;
+    return {};
+}
 
-    debug_log(buffer.str());
-    silent_shell(buffer.str());    
-}
\ No newline at end of file
+void RunTeraChem()
+{
+    TraceScope trace("run_terachem");
+    ProcessOptions options;
+    options.stdout_file = TC_OUTFILE;
+    options.stderr_file = TC_ERRFILE;
+    options.environment = TeraChemEnvironment();
+    debug_log("terachem -i " + TC_FILENAME + " 1> " + TC_OUTFILE + " 2> " + TC_ERRFILE);
+    Process process = RunProcess({TeraChemExecutable(), "-i", TC_FILENAME}, options);
+    if (process.exit_code < 0)
+    {
+        normal_log("Unable to start terachem; check that " + (std::string)DEFAULT_TERACHEM_MODULE + " is available.");
+    }
+}
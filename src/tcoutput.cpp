@@ -0,0 +1,377 @@
+#include "tcoutput.h"
+
+std::string PARSE_TARGET = "";
+
+void check_parse_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("parse") > 0)
+    {
+        if (flags["parse"].empty())
+        {
+            PrintUsage();
+            error_log("The --parse flag requires a TeraChem output file.", 1);
+        }
+        PARSE_TARGET = flags["parse"][0];
+        flags.erase("parse");
+    }
+}
+
+void RunParseMode()
+{
+    TCOutputResults results = ParseTCOutput(PARSE_TARGET);
+    write_to_file(PARSE_TARGET + ".json", TCResultsToJSON(results));
+    normal_log("Parsed " + PARSE_TARGET + " (" + std::to_string(results.offset) + " bytes), results written to " + PARSE_TARGET + ".json");
+}
+
+// Parsing
+bool starts_with_integer(const std::string &line)
+{
+    size_t i = line.find_first_not_of(" \t");
+    return (i != std::string::npos && isdigit((unsigned char)line[i]));
+}
+
+void parse_tc_output_line(TCOutputResults &results, const std::string &line)
+{
+    // Gradient block: "Gradient units are Hartree/Bohr", a dashed rule, a dE/dX header, rows, then a closing rule.
+    if (results.gradient_state > 0)
+    {
+        if (line.find("dE/dX") != std::string::npos)
+        {
+            results.gradient_state = 2;
+            return;
+        }
+        if (line.find("----") != std::string::npos)
+        {
+            if (results.gradient_state == 2)
+            {
+                results.gradient = results.gradient_buffer;
+                results.gradient_buffer.clear();
+                results.gradient_state = 0;
+            }
+            return;
+        }
+        if (results.gradient_state == 2)
+        {
+            const char *p = line.c_str();
+            char *end = nullptr;
+            for (int k = 0; k < 3; k++)
+            {
+                double value = strtod(p, &end);
+                if (end == p)
+                {
+                    break;
+                }
+                results.gradient_buffer.push_back(value);
+                p = end;
+            }
+            return;
+        }
+    }
+    if (line.find("Gradient units are Hartree/Bohr") != std::string::npos)
+    {
+        results.gradient_state = 1;
+        results.gradient_buffer.clear();
+        return;
+    }
+
+    // SCF iterations are the integer-led rows between the start banner and FINAL ENERGY.
+    if (line.find("Start SCF Iterations") != std::string::npos)
+    {
+        results.in_scf = true;
+        results.scf_iter_count = 0;
+        return;
+    }
+    size_t pos = line.find("FINAL ENERGY:");
+    if (pos != std::string::npos)
+    {
+        results.final_energy = strtod(line.c_str() + pos + 13, nullptr);
+        results.has_energy = true;
+        results.scf_energies.push_back(results.final_energy);
+        results.scf_iterations.push_back(results.scf_iter_count);
+        results.in_scf = false;
+        results.scf_iter_count = 0;
+        return;
+    }
+    if (results.in_scf)
+    {
+        if (starts_with_integer(line))
+        {
+            results.scf_iter_count++;
+        }
+        return;
+    }
+
+    if (line.find("Optimization Cycle") != std::string::npos)
+    {
+        results.opt_steps++;
+        return;
+    }
+    pos = line.find("Total processing time:");
+    if (pos != std::string::npos)
+    {
+        results.total_time = strtod(line.c_str() + pos + 22, nullptr);
+        return;
+    }
+    if (line.find("Job finished") != std::string::npos)
+    {
+        results.finished = true;
+        return;
+    }
+    if (line.find("ERROR") != std::string::npos || line.find("error:") != std::string::npos || line.find("DIE called") != std::string::npos || line.find("CUDA error") != std::string::npos)
+    {
+        if (results.errors.size() < TC_OUTPUT_MAX_ERRORS)
+        {
+            size_t first = line.find_first_not_of(" \t");
+            results.errors.push_back(line.substr(first));
+        }
+    }
+}
+
+uint64_t output_signature(std::ifstream &fin, uint64_t length)
+{
+    // Hash the already-parsed head of the file; a different head means the output was replaced and must be parsed from scratch.
+    std::string head(std::min<uint64_t>(length, 4096), '\0');
+    fin.seekg(0);
+    fin.read(&head[0], head.size());
+    head.resize(fin.gcount());
+    fin.clear();
+    return std::hash<std::string>{}(head);
+}
+
+bool parse_tc_output_from(TCOutputResults &results, std::string filename)
+{
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    if (!fin.is_open())
+    {
+        return false;
+    }
+    std::error_code ec;
+    uint64_t file_size = fs::file_size(filename, ec);
+    if (ec)
+    {
+        return false;
+    }
+    if (file_size < results.offset || output_signature(fin, results.offset) != results.signature)
+    {
+        results = TCOutputResults();
+    }
+    debug_log("Parsing " + filename + " from byte " + std::to_string(results.offset));
+
+    // Read fixed-size chunks from the checkpoint, handling only complete lines.
+    std::vector<char> chunk(TC_OUTPUT_CHUNK_SIZE);
+    std::string partial = "";
+    fin.seekg(results.offset);
+    while (fin)
+    {
+        fin.read(chunk.data(), chunk.size());
+        size_t n_read = fin.gcount();
+        if (n_read == 0)
+        {
+            break;
+        }
+        const char *begin = chunk.data();
+        const char *stop = chunk.data() + n_read;
+        const char *newline;
+        while ((newline = (const char*)memchr(begin, '\n', stop - begin)) != nullptr)
+        {
+            partial.append(begin, newline - begin);
+            parse_tc_output_line(results, partial);
+            results.offset += partial.size() + 1;
+            partial.clear();
+            begin = newline + 1;
+        }
+        partial.append(begin, stop - begin);
+    }
+    fin.clear();
+    results.signature = output_signature(fin, results.offset);
+    fin.close();
+    return true;
+}
+
+TCOutputResults ParseTCOutput(std::string filename)
+{
+    // A binary results record next to the output doubles as the byte-offset checkpoint.
+    TCOutputResults results;
+    std::string checkpoint = filename + ".aqres";
+    ReadTCResultsBinary(results, checkpoint);
+    if (!parse_tc_output_from(results, filename))
+    {
+        error_log("Unable to open TeraChem output " + filename, 1);
+    }
+    WriteTCResultsBinary(results, checkpoint);
+    return results;
+}
+
+bool PeekTCOutput(TCOutputResults &results, std::string filename)
+{
+    // For outputs that belong to other runs: an existing checkpoint is used but never written,
+    // and an unreadable output or checkpoint is reported rather than fatal.
+    results = TCOutputResults();
+    try
+    {
+        ReadTCResultsBinary(results, filename + ".aqres");
+        return parse_tc_output_from(results, filename);
+    }
+    catch (const std::exception &e)
+    {
+        debug_log("Unable to parse " + filename + ": " + e.what());
+        results = TCOutputResults();
+        return false;
+    }
+}
+
+// Results records
+std::string TCResultsToJSON(const TCOutputResults &results)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::setprecision(12);
+    buffer << "{" << std::endl;
+    buffer << "  \"bytes_parsed\": " << results.offset << "," << std::endl;
+    buffer << "  \"finished\": " << (results.finished ? "true" : "false") << "," << std::endl;
+    if (results.has_energy)
+    {
+        buffer << "  \"final_energy\": " << results.final_energy << "," << std::endl;
+    }
+    else
+    {
+        buffer << "  \"final_energy\": null," << std::endl;
+    }
+    buffer << "  \"scf_cycles\": " << results.scf_iterations.size() << "," << std::endl;
+    buffer << "  \"scf_iterations\": [";
+    for (size_t i = 0; i < results.scf_iterations.size(); i++)
+    {
+        buffer << (i ? ", " : "") << results.scf_iterations[i];
+    }
+    buffer << "]," << std::endl;
+    buffer << "  \"opt_steps\": " << results.opt_steps << "," << std::endl;
+    buffer << "  \"total_time\": " << results.total_time << "," << std::endl;
+    buffer << "  \"gradient\": [";
+    for (size_t i = 0; i < results.gradient.size(); i++)
+    {
+        buffer << (i ? ", " : "") << results.gradient[i];
+    }
+    buffer << "]," << std::endl;
+    buffer << "  \"errors\": [";
+    for (size_t i = 0; i < results.errors.size(); i++)
+    {
+        buffer << (i ? ", " : "") << "\"" << json_escape(results.errors[i]) << "\"";
+    }
+    buffer << "]" << std::endl;
+    buffer << "}" << std::endl;
+    return buffer.str();
+}
+
+// Binary record: "AQTC" magic, a version word, then each field in declaration order.
+// Vectors are written as a uint64_t count followed by the raw elements.
+const char TC_RESULTS_MAGIC[4] = {'A','Q','T','C'};
+const uint32_t TC_RESULTS_VERSION = 1;
+
+template <typename T> void write_pod(std::ofstream &out, const T &value)
+{
+    out.write((const char*)&value, sizeof(T));
+}
+template <typename T> void write_pod_vector(std::ofstream &out, const std::vector<T> &values)
+{
+    write_pod(out, (uint64_t)values.size());
+    out.write((const char*)values.data(), values.size() * sizeof(T));
+}
+template <typename T> bool read_pod(std::ifstream &in, T &value)
+{
+    return (bool)in.read((char*)&value, sizeof(T));
+}
+template <typename T> bool read_pod_vector(std::ifstream &in, std::vector<T> &values)
+{
+    uint64_t n = 0;
+    if (!read_pod(in, n) || n > (1ull << 32))
+    {
+        return false;
+    }
+    values.resize(n);
+    return (bool)in.read((char*)values.data(), n * sizeof(T));
+}
+
+bool WriteTCResultsBinary(const TCOutputResults &results, std::string filename)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        return false;
+    }
+    out.write(TC_RESULTS_MAGIC, 4);
+    write_pod(out, TC_RESULTS_VERSION);
+    write_pod(out, results.offset);
+    write_pod(out, results.signature);
+    write_pod(out, (uint8_t)results.has_energy);
+    write_pod(out, results.final_energy);
+    write_pod_vector(out, results.scf_energies);
+    write_pod_vector(out, results.scf_iterations);
+    write_pod(out, (int32_t)results.opt_steps);
+    write_pod_vector(out, results.gradient);
+    write_pod(out, results.total_time);
+    write_pod(out, (uint8_t)results.finished);
+    write_pod(out, (uint64_t)results.errors.size());
+    for (const std::string &error : results.errors)
+    {
+        write_pod(out, (uint64_t)error.size());
+        out.write(error.data(), error.size());
+    }
+    write_pod(out, (uint8_t)results.in_scf);
+    write_pod(out, (int32_t)results.scf_iter_count);
+    write_pod(out, (int32_t)results.gradient_state);
+    write_pod_vector(out, results.gradient_buffer);
+    out.close();
+    return true;
+}
+
+bool ReadTCResultsBinary(TCOutputResults &results, std::string filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.is_open())
+    {
+        return false;
+    }
+    char magic[4];
+    uint32_t version = 0;
+    if (!in.read(magic, 4) || memcmp(magic, TC_RESULTS_MAGIC, 4) != 0 || !read_pod(in, version) || version != TC_RESULTS_VERSION)
+    {
+        return false;
+    }
+    TCOutputResults loaded;
+    uint8_t flag = 0;
+    int32_t value = 0;
+    uint64_t n_errors = 0;
+    bool ok = read_pod(in, loaded.offset) && read_pod(in, loaded.signature);
+    ok = ok && read_pod(in, flag);
+    loaded.has_energy = flag;
+    ok = ok && read_pod(in, loaded.final_energy) && read_pod_vector(in, loaded.scf_energies) && read_pod_vector(in, loaded.scf_iterations);
+    ok = ok && read_pod(in, value);
+    loaded.opt_steps = value;
+    ok = ok && read_pod_vector(in, loaded.gradient) && read_pod(in, loaded.total_time) && read_pod(in, flag);
+    loaded.finished = flag;
+    ok = ok && read_pod(in, n_errors) && n_errors <= TC_OUTPUT_MAX_ERRORS;
+    for (uint64_t i = 0; ok && i < n_errors; i++)
+    {
+        uint64_t len = 0;
+        ok = read_pod(in, len) && len < (1 << 20);
+        if (ok)
+        {
+            std::string error(len, '\0');
+            ok = (bool)in.read(&error[0], len);
+            loaded.errors.push_back(error);
+        }
+    }
+    ok = ok && read_pod(in, flag);
+    loaded.in_scf = flag;
+    ok = ok && read_pod(in, value);
+    loaded.scf_iter_count = value;
+    ok = ok && read_pod(in, value);
+    loaded.gradient_state = value;
+    ok = ok && read_pod_vector(in, loaded.gradient_buffer);
+    in.close();
+    if (ok)
+    {
+        results = loaded;
+    }
+    return ok;
+}
@@ -0,0 +1,871 @@
+#include "thermo.h"
+
+std::vector<std::string> THERMO_DIRS = {};
+std::vector<double> THERMO_TEMPERATURES = {298.15};
+std::vector<double> THERMO_PRESSURES = {1.0};
+double QRRHO_CUTOFF = 100.0;
+int SYMMETRY_NUMBER = 1;
+
+std::vector<double> parse_number_list(const std::vector<std::string> &values)
+{
+    // "298.15,310 350" -> {298.15, 310, 350}
+    std::vector<double> numbers = {};
+    for (std::string value : values)
+    {
+        for (std::string part : split_string(value, ","))
+        {
+            if (!part.empty())
+            {
+                numbers.push_back(std::stod(part));
+            }
+        }
+    }
+    return numbers;
+}
+
+void check_thermo_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("thermo") > 0)
+    {
+        THERMO_DIRS = flags["thermo"].empty() ? std::vector<std::string>{"."} : flags["thermo"];
+        flags.erase("thermo");
+    }
+    if (flags.count("temperatures") > 0)
+    {
+        if (!flags["temperatures"].empty())
+        {
+            THERMO_TEMPERATURES = parse_number_list(flags["temperatures"]);
+        }
+        flags.erase("temperatures");
+    }
+    if (flags.count("pressures") > 0)
+    {
+        if (!flags["pressures"].empty())
+        {
+            THERMO_PRESSURES = parse_number_list(flags["pressures"]);
+        }
+        flags.erase("pressures");
+    }
+    if (flags.count("qrrho_cutoff") > 0)
+    {
+        if (!flags["qrrho_cutoff"].empty())
+        {
+            QRRHO_CUTOFF = std::max(0.0, std::stod(flags["qrrho_cutoff"][0]));
+        }
+        flags.erase("qrrho_cutoff");
+    }
+    if (flags.count("symmetry_number") > 0)
+    {
+        if (!flags["symmetry_number"].empty())
+        {
+            SYMMETRY_NUMBER = std::max(1, std::stoi(flags["symmetry_number"][0]));
+        }
+        flags.erase("symmetry_number");
+    }
+}
+
+// Physical constants (CODATA 2018), SI unless noted.
+const double PLANCK = 6.62607015e-34;
+const double BOLTZMANN = 1.380649e-23;
+const double AVOGADRO = 6.02214076e23;
+const double SPEED_OF_LIGHT_CM = 2.99792458e10;     // cm/s
+const double AMU = 1.66053906660e-27;
+const double BOHR = 0.529177210903e-10;
+const double ANGSTROM_TO_BOHR = 1.0 / 0.529177210903;
+const double GAS_CONSTANT = BOLTZMANN * AVOGADRO;   // J/(mol K)
+const double HARTREE_PER_J_MOL = 1.0 / 2625499.639;
+const double ATM = 101325.0;
+const double AU_TO_WAVENUMBER = 5140.4871;          // sqrt(Hartree/(Bohr^2 amu)) in cm^-1
+
+double element_mass(int z)
+{
+    // Most abundant isotope, amu.
+    static const double masses[] = {0.0, 1.00782503, 4.00260325, 7.01600344, 9.01218307, 11.00930536, 12.0, 14.00307400, 15.99491462, 18.99840316, 19.99244018,
+                                    22.98976928, 23.98504170, 26.98153853, 27.97692653, 30.97376199, 31.97207117, 34.96885268, 39.96238312,
+                                    38.96370649, 39.96259086, 44.95590828, 47.94794198, 50.94395704, 51.94050623, 54.93804391, 55.93493633, 58.93319429,
+                                    57.93534241, 62.92959772, 63.92914201, 68.92557360, 73.92117776, 74.92159457, 79.91652180, 78.91833760, 83.91149773,
+                                    84.91178974, 87.90561226, 88.90584030, 89.90469876, 92.90637300, 97.90540482, 97.90721240, 101.90434930, 102.90549800,
+                                    105.90348040, 106.90509160, 113.90336509, 114.90387878, 119.90220163, 120.90381200, 129.90622275, 126.90447190, 131.90415509};
+    return (z > 0 && z < (int)(sizeof(masses) / sizeof(double))) ? masses[z] : 0.0;
+}
+
+// Linear algebra
+void SymmetricEigen(std::vector<double> &a, size_t n, std::vector<double> &d)
+{
+    // Eigenvalues of a symmetric n x n row-major matrix, ascending: Householder reduction to
+    // tridiagonal form, then implicit QL. The matrix is overwritten.
+    d.assign(n, 0.0);
+    std::vector<double> e(n, 0.0);
+    for (long i = (long)n - 1; i > 0; i--)
+    {
+        long l = i - 1;
+        double h = 0.0, scale = 0.0;
+        if (l > 0)
+        {
+            for (long k = 0; k <= l; k++)
+            {
+                scale += fabs(a[i*n + k]);
+            }
+            if (scale == 0.0)
+            {
+                e[i] = a[i*n + l];
+            }
+            else
+            {
+                for (long k = 0; k <= l; k++)
+                {
+                    a[i*n + k] /= scale;
+                    h += a[i*n + k] * a[i*n + k];
+                }
+                double f = a[i*n + l];
+                double g = (f >= 0.0) ? -sqrt(h) : sqrt(h);
+                e[i] = scale * g;
+                h -= f * g;
+                a[i*n + l] = f - g;
+                f = 0.0;
+                for (long j = 0; j <= l; j++)
+                {
+                    g = 0.0;
+                    for (long k = 0; k <= j; k++)
+                    {
+                        g += a[j*n + k] * a[i*n + k];
+                    }
+                    for (long k = j + 1; k <= l; k++)
+                    {
+                        g += a[k*n + j] * a[i*n + k];
+                    }
+                    e[j] = g / h;
+                    f += e[j] * a[i*n + j];
+                }
+                double hh = f / (h + h);
+                for (long j = 0; j <= l; j++)
+                {
+                    f = a[i*n + j];
+                    e[j] = g = e[j] - hh * f;
+                    for (long k = 0; k <= j; k++)
+                    {
+                        a[j*n + k] -= (f * e[k] + g * a[i*n + k]);
+                    }
+                }
+            }
+        }
+        else
+        {
+            e[i] = a[i*n + l];
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        d[i] = a[i*n + i];
+    }
+    for (size_t i = 1; i < n; i++)
+    {
+        e[i-1] = e[i];
+    }
+    if (n > 0)
+    {
+        e[n-1] = 0.0;
+    }
+    for (long l = 0; l < (long)n; l++)
+    {
+        int iterations = 0;
+        long m;
+        do
+        {
+            for (m = l; m < (long)n - 1; m++)
+            {
+                double dd = fabs(d[m]) + fabs(d[m+1]);
+                if (fabs(e[m]) <= 1e-15 * dd)
+                {
+                    break;
+                }
+            }
+            if (m != l)
+            {
+                if (iterations++ == 60)
+                {
+                    debug_log("SymmetricEigen: no convergence after 60 QL iterations.");
+                    break;
+                }
+                double g = (d[l+1] - d[l]) / (2.0 * e[l]);
+                double r = hypot(g, 1.0);
+                g = d[m] - d[l] + e[l] / (g + copysign(r, g));
+                double s = 1.0, c = 1.0, p = 0.0;
+                long i;
+                for (i = m - 1; i >= l; i--)
+                {
+                    double f = s * e[i];
+                    double b = c * e[i];
+                    e[i+1] = (r = hypot(f, g));
+                    if (r == 0.0)
+                    {
+                        d[i+1] -= p;
+                        e[m] = 0.0;
+                        break;
+                    }
+                    s = f / r;
+                    c = g / r;
+                    g = d[i+1] - p;
+                    r = (d[i] - g) * s + 2.0 * c * b;
+                    d[i+1] = g + (p = s * r);
+                    g = c * r - b;
+                }
+                if (r == 0.0 && i >= l)
+                {
+                    continue;
+                }
+                d[l] -= p;
+                e[l] = g;
+                e[m] = 0.0;
+            }
+        } while (m != l);
+    }
+    std::sort(d.begin(), d.end());
+}
+
+// Hessian sources
+bool ReadHessianFile(std::string filename, size_t n, std::vector<double> &hessian)
+{
+    // AutoQuantum_Hessian.txt: the dimension, then n rows of n values in Hartree/Bohr^2.
+    std::ifstream fin(filename);
+    size_t dimension = 0;
+    if (!fin.is_open() || !(fin >> dimension) || dimension != n)
+    {
+        return false;
+    }
+    hessian.assign(n * n, 0.0);
+    for (size_t i = 0; i < n * n; i++)
+    {
+        if (!(fin >> hessian[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void WriteHessianFile(std::string filename, const std::vector<double> &hessian, size_t n)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << n << std::endl << std::scientific << std::setprecision(12);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            buffer << (j ? " " : "") << hessian[i*n + j];
+        }
+        buffer << std::endl;
+    }
+    write_to_file(filename, buffer.str());
+}
+
+bool parse_integer_token(const std::string &token, long &value)
+{
+    char *end = nullptr;
+    value = strtol(token.c_str(), &end, 10);
+    return !token.empty() && *end == '\0';
+}
+
+std::vector<std::string> whitespace_tokens(const std::string &line)
+{
+    std::vector<std::string> tokens = {};
+    std::stringstream buffer(line);
+    std::string token;
+    while (buffer >> token)
+    {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+bool ParseHessianBlock(std::string output, size_t n, std::vector<double> &hessian)
+{
+    // Printed matrices come in column blocks: a row of consecutive column numbers, then
+    // "row value value ..." lines. Only the last complete Hessian in the output is kept;
+    // a printed triangle is completed by symmetry.
+    std::ifstream fin(output);
+    if (!fin.is_open() || n == 0)
+    {
+        return false;
+    }
+    std::string line;
+    bool found = false, in_block = false;
+    std::vector<double> block;
+    std::vector<char> filled;
+    std::vector<long> columns = {};
+    size_t n_filled = 0;
+    auto finish_block = [&]()
+    {
+        if (!in_block || n_filled == 0)
+        {
+            return;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                if (!filled[i*n + j] && filled[j*n + i])
+                {
+                    block[i*n + j] = block[j*n + i];
+                    filled[i*n + j] = 1;
+                }
+            }
+        }
+        if (std::find(filled.begin(), filled.end(), 0) == filled.end())
+        {
+            hessian = block;
+            found = true;
+        }
+        in_block = false;
+    };
+    while (std::getline(fin, line))
+    {
+        std::string lower = line;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.find("hessian") != std::string::npos)
+        {
+            finish_block();
+            in_block = true;
+            block.assign(n * n, 0.0);
+            filled.assign(n * n, 0);
+            columns.clear();
+            n_filled = 0;
+            continue;
+        }
+        if (!in_block)
+        {
+            continue;
+        }
+        std::vector<std::string> tokens = whitespace_tokens(line);
+        if (tokens.empty())
+        {
+            continue;
+        }
+        std::vector<long> integers = {};
+        long value = 0;
+        for (const std::string &token : tokens)
+        {
+            if (!parse_integer_token(token, value))
+            {
+                break;
+            }
+            integers.push_back(value);
+        }
+        bool consecutive = (integers.size() == tokens.size());
+        for (size_t k = 1; consecutive && k < integers.size(); k++)
+        {
+            consecutive = (integers[k] == integers[k-1] + 1);
+        }
+        if (consecutive)
+        {
+            columns = integers;
+            continue;
+        }
+        long row = 0;
+        bool is_row = !columns.empty() && parse_integer_token(tokens[0], row) && row >= 1 && (size_t)row <= n && tokens.size() - 1 <= columns.size();
+        for (size_t k = 1; is_row && k < tokens.size(); k++)
+        {
+            char *end = nullptr;
+            double entry = strtod(tokens[k].c_str(), &end);
+            long column = columns[k-1];
+            is_row = (*end == '\0') && column >= 1 && (size_t)column <= n;
+            if (is_row)
+            {
+                block[(row-1)*n + column - 1] = entry;
+                n_filled += !filled[(row-1)*n + column - 1];
+                filled[(row-1)*n + column - 1] = 1;
+            }
+        }
+        if (!is_row && n_filled > 0)
+        {
+            finish_block();
+        }
+    }
+    finish_block();
+    return found;
+}
+
+std::vector<double> ParseFrequencyTable(std::string output)
+{
+    // The last table whose header names a frequency column; "123.4i" is an imaginary mode.
+    std::ifstream fin(output);
+    std::vector<double> frequencies = {}, table = {};
+    std::string line;
+    long column = -1;
+    while (std::getline(fin, line))
+    {
+        std::vector<std::string> tokens = whitespace_tokens(line);
+        std::string lower = line;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.find("frequenc") != std::string::npos && !tokens.empty() && !isdigit((unsigned char)tokens[0][0]))
+        {
+            if (!table.empty())
+            {
+                frequencies = table;
+            }
+            table.clear();
+            column = -1;
+            for (size_t t = 0; t < tokens.size(); t++)
+            {
+                std::string name = tokens[t];
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                if (column < 0 && name.find("frequenc") != std::string::npos)
+                {
+                    column = t;
+                }
+            }
+            continue;
+        }
+        long mode = 0;
+        if (column >= 0 && !tokens.empty() && parse_integer_token(tokens[0], mode) && (size_t)column < tokens.size())
+        {
+            std::string field = tokens[column];
+            bool imaginary = (!field.empty() && field.back() == 'i');
+            double frequency = strtod(field.c_str(), nullptr);
+            table.push_back(imaginary ? -fabs(frequency) : frequency);
+        }
+        else if (!table.empty())
+        {
+            frequencies = table;
+            table.clear();
+            column = -1;
+        }
+    }
+    return table.empty() ? frequencies : table;
+}
+
+// Harmonic analysis
+void inertia_moments(const XYZFrames &geometry, const std::vector<double> &masses, std::vector<double> &centered, double moments[3])
+{
+    // Coordinates in Bohr relative to the center of mass, and the principal moments in amu Bohr^2.
+    size_t n = geometry.n_atoms;
+    double total = 0.0, com[3] = {0.0, 0.0, 0.0};
+    for (size_t a = 0; a < n; a++)
+    {
+        total += masses[a];
+        com[0] += masses[a] * geometry.x[a];
+        com[1] += masses[a] * geometry.y[a];
+        com[2] += masses[a] * geometry.z[a];
+    }
+    centered.assign(3 * n, 0.0);
+    for (size_t a = 0; a < n; a++)
+    {
+        centered[3*a] = (geometry.x[a] - com[0] / total) * ANGSTROM_TO_BOHR;
+        centered[3*a+1] = (geometry.y[a] - com[1] / total) * ANGSTROM_TO_BOHR;
+        centered[3*a+2] = (geometry.z[a] - com[2] / total) * ANGSTROM_TO_BOHR;
+    }
+    std::vector<double> tensor(9, 0.0);
+    for (size_t a = 0; a < n; a++)
+    {
+        const double *r = &centered[3*a];
+        double r2 = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                tensor[3*i + j] += masses[a] * ((i == j ? r2 : 0.0) - r[i] * r[j]);
+            }
+        }
+    }
+    std::vector<double> principal;
+    SymmetricEigen(tensor, 3, principal);
+    for (int k = 0; k < 3; k++)
+    {
+        moments[k] = std::max(0.0, principal[k]);
+    }
+}
+
+bool HarmonicAnalysis(VibrationalAnalysis &analysis, const XYZFrames &geometry, const std::vector<double> &hessian)
+{
+    size_t n_atoms = geometry.n_atoms;
+    size_t n = 3 * n_atoms;
+    if (hessian.size() != n * n || analysis.masses.size() != n_atoms)
+    {
+        return false;
+    }
+    std::vector<double> centered;
+    inertia_moments(geometry, analysis.masses, centered, analysis.moments);
+    analysis.linear = (n_atoms == 2) || (n_atoms > 2 && analysis.moments[0] < 1e-4 * analysis.moments[2]);
+
+    // Mass-weighted, symmetrized Hessian.
+    std::vector<double> root_mass(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        root_mass[i] = sqrt(analysis.masses[i / 3]);
+    }
+    std::vector<double> h(n * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            h[i*n + j] = 0.5 * (hessian[i*n + j] + hessian[j*n + i]) / (root_mass[i] * root_mass[j]);
+        }
+    }
+
+    // Orthonormal translation and rotation vectors in mass-weighted coordinates (five for linear molecules).
+    std::vector<std::vector<double>> tr = {};
+    for (int k = 0; k < 6; k++)
+    {
+        std::vector<double> v(n, 0.0);
+        for (size_t a = 0; a < n_atoms; a++)
+        {
+            const double *r = &centered[3*a];
+            if (k < 3)
+            {
+                v[3*a + k] = root_mass[3*a];
+            }
+            else
+            {
+                int axis = k - 3, u = (axis + 1) % 3, w = (axis + 2) % 3;
+                v[3*a + u] = -root_mass[3*a] * r[w];
+                v[3*a + w] = root_mass[3*a] * r[u];
+            }
+        }
+        for (const std::vector<double> &q : tr)
+        {
+            double overlap = 0.0;
+            for (size_t i = 0; i < n; i++) overlap += q[i] * v[i];
+            for (size_t i = 0; i < n; i++) v[i] -= overlap * q[i];
+        }
+        double norm = 0.0;
+        for (size_t i = 0; i < n; i++) norm += v[i] * v[i];
+        if (norm > 1e-8)
+        {
+            norm = sqrt(norm);
+            for (size_t i = 0; i < n; i++) v[i] /= norm;
+            tr.push_back(v);
+        }
+    }
+
+    // Project them out as a low-rank update, P H P = H - V W^T - W V^T + V (V^T W) V^T with W = H V.
+    size_t r = tr.size();
+    std::vector<double> w(n * r, 0.0), c(r * r, 0.0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = 0; k < r; k++)
+        {
+            double sum = 0.0;
+            for (size_t j = 0; j < n; j++)
+            {
+                sum += h[i*n + j] * tr[k][j];
+            }
+            w[i*r + k] = sum;
+        }
+    }
+    for (size_t k = 0; k < r; k++)
+    {
+        for (size_t l = 0; l < r; l++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                c[k*r + l] += tr[k][i] * w[i*r + l];
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            double update = 0.0;
+            for (size_t k = 0; k < r; k++)
+            {
+                update += tr[k][i] * w[j*r + k] + w[i*r + k] * tr[k][j];
+                for (size_t l = 0; l < r; l++)
+                {
+                    update -= tr[k][i] * c[k*r + l] * tr[l][j];
+                }
+            }
+            h[i*n + j] -= update;
+        }
+    }
+
+    // The r eigenvalues closest to zero belong to the projected-out motions.
+    std::vector<double> eigenvalues;
+    SymmetricEigen(h, n, eigenvalues);
+    std::sort(eigenvalues.begin(), eigenvalues.end(), [](double a, double b) { return fabs(a) < fabs(b); });
+    eigenvalues.erase(eigenvalues.begin(), eigenvalues.begin() + std::min(r, eigenvalues.size()));
+    std::sort(eigenvalues.begin(), eigenvalues.end());
+    analysis.frequencies.clear();
+    analysis.n_imaginary = 0;
+    for (double lambda : eigenvalues)
+    {
+        double frequency = AU_TO_WAVENUMBER * sqrt(fabs(lambda));
+        analysis.frequencies.push_back(lambda < 0.0 ? -frequency : frequency);
+        analysis.n_imaginary += (lambda < 0.0);
+    }
+    return true;
+}
+
+// Thermochemistry
+std::vector<ThermoPoint> Thermochemistry(const VibrationalAnalysis &analysis, const std::vector<double> &temperatures, const std::vector<double> &pressures)
+{
+    // Rigid rotor / harmonic oscillator, with Grimme's quasi-RRHO entropy for modes below QRRHO_CUTOFF.
+    // Per-mode constants are computed once; each temperature is then a pass over contiguous arrays.
+    std::vector<double> theta = {}, weight = {}, rotor_inertia = {};
+    const double average_inertia = 1e-44;           // kg m^2
+    for (double frequency : analysis.frequencies)
+    {
+        if (frequency <= 0.0)
+        {
+            continue;
+        }
+        theta.push_back(PLANCK * SPEED_OF_LIGHT_CM * frequency / BOLTZMANN);
+        weight.push_back(QRRHO_CUTOFF > 0.0 ? 1.0 / (1.0 + pow(QRRHO_CUTOFF / frequency, 4)) : 1.0);
+        double mu = PLANCK / (8.0 * M_PI * M_PI * SPEED_OF_LIGHT_CM * frequency);
+        rotor_inertia.push_back(mu * average_inertia / (mu + average_inertia));
+    }
+    size_t n_modes = theta.size();
+    double zpe = 0.0;
+    for (size_t m = 0; m < n_modes; m++)
+    {
+        zpe += 0.5 * theta[m];
+    }
+    zpe *= GAS_CONSTANT * HARTREE_PER_J_MOL;
+
+    double total_mass = 0.0;
+    for (double mass : analysis.masses)
+    {
+        total_mass += mass;
+    }
+    total_mass *= AMU;
+    double inertia_si[3];
+    for (int k = 0; k < 3; k++)
+    {
+        inertia_si[k] = analysis.moments[k] * AMU * BOHR * BOHR;
+    }
+    bool atom = (analysis.n_atoms == 1);
+
+    std::vector<ThermoPoint> points = {};
+    std::vector<double> x(n_modes), s_mode(n_modes);
+    for (double temperature : temperatures)
+    {
+        double kt = BOLTZMANN * temperature;
+        double e_vib = 0.0, s_vib = 0.0;
+        for (size_t m = 0; m < n_modes; m++)
+        {
+            x[m] = theta[m] / temperature;
+        }
+        for (size_t m = 0; m < n_modes; m++)
+        {
+            double boltzmann = exp(-x[m]);
+            double s_ho = x[m] * boltzmann / (1.0 - boltzmann) - log1p(-boltzmann);
+            double s_rotor = 0.5 + log(sqrt(8.0 * M_PI * M_PI * M_PI * rotor_inertia[m] * kt / (PLANCK * PLANCK)));
+            s_mode[m] = weight[m] * s_ho + (1.0 - weight[m]) * s_rotor;
+            e_vib += theta[m] * (0.5 + boltzmann / (1.0 - boltzmann));
+        }
+        for (size_t m = 0; m < n_modes; m++)
+        {
+            s_vib += s_mode[m];
+        }
+        double e_rot = 0.0, s_rot = 0.0;
+        if (!atom && analysis.linear)
+        {
+            double theta_rot = PLANCK * PLANCK / (8.0 * M_PI * M_PI * inertia_si[2] * BOLTZMANN);
+            e_rot = temperature;
+            s_rot = log(temperature / (SYMMETRY_NUMBER * theta_rot)) + 1.0;
+        }
+        else if (!atom)
+        {
+            double product = 1.0;
+            for (int k = 0; k < 3; k++)
+            {
+                product *= PLANCK * PLANCK / (8.0 * M_PI * M_PI * inertia_si[k] * BOLTZMANN);
+            }
+            e_rot = 1.5 * temperature;
+            s_rot = log(sqrt(M_PI) / SYMMETRY_NUMBER * pow(temperature, 1.5) / sqrt(product)) + 1.5;
+        }
+        double s_elec = log((double)std::max(1, analysis.multiplicity));
+        for (double pressure : pressures)
+        {
+            double s_trans = log(pow(2.0 * M_PI * total_mass * kt / (PLANCK * PLANCK), 1.5) * kt / (pressure * ATM)) + 2.5;
+            ThermoPoint point;
+            point.temperature = temperature;
+            point.pressure = pressure;
+            point.zpe = zpe;
+            point.enthalpy_correction = GAS_CONSTANT * (1.5 * temperature + e_rot + e_vib + temperature) * HARTREE_PER_J_MOL;
+            point.entropy = GAS_CONSTANT * (s_trans + s_rot + s_vib + s_elec) * HARTREE_PER_J_MOL;
+            point.gibbs_correction = point.enthalpy_correction - temperature * point.entropy;
+            points.push_back(point);
+        }
+    }
+    return points;
+}
+
+// Thermochemistry Mode
+struct ThermoJob
+{
+    std::string job_dir = "";
+    std::string output = "";
+    bool ok = false;
+    std::string message = "";
+    VibrationalAnalysis analysis;
+    std::vector<ThermoPoint> points = {};
+};
+
+void analyze_thermo_job(ThermoJob &job)
+{
+    ExecutorTask task;
+    std::map<std::string,std::string> keywords = {};
+    if (!ExecutorTaskFromJobDir(task, job.job_dir) || !Read_TC_Input_File(keywords, (fs::path(job.job_dir) / task.input).string()))
+    {
+        job.message = "no TeraChem input";
+        return;
+    }
+    job.output = (fs::path(job.job_dir) / task.output).string();
+    std::string coordinates = (fs::path(job.job_dir) / keywords["coordinates"]).string();
+    XYZFrames geometry;
+    if (fs::path(coordinates).extension() == ".xyz" && fs::exists(coordinates))
+    {
+        geometry = ReadLastFrame(coordinates);
+    }
+    if (geometry.n_atoms == 0 || keywords.count("prmtop") > 0)
+    {
+        job.message = "needs an XYZ geometry without MM atoms";
+        return;
+    }
+    VibrationalAnalysis &analysis = job.analysis;
+    analysis.n_atoms = geometry.n_atoms;
+    for (const std::string &element : geometry.elements)
+    {
+        analysis.masses.push_back(element_mass(element_atomic_number(element)));
+        if (analysis.masses.back() <= 0.0)
+        {
+            job.message = "unknown element " + element;
+            return;
+        }
+    }
+    analysis.multiplicity = (keywords.count("spinmult") > 0) ? std::max(1, atoi(keywords["spinmult"].c_str())) : 1;
+    if (fs::exists(job.output))
+    {
+        TCOutputResults results = ParseTCOutput(job.output);
+        analysis.has_energy = results.has_energy;
+        analysis.electronic_energy = results.final_energy;
+    }
+
+    std::vector<double> hessian;
+    size_t n = 3 * geometry.n_atoms;
+    if (ReadHessianFile((fs::path(job.job_dir) / HESSIAN_FILE).string(), n, hessian) || ParseHessianBlock(job.output, n, hessian))
+    {
+        HarmonicAnalysis(analysis, geometry, hessian);
+    }
+    else
+    {
+        // Printed frequencies; drop the near-zero translations and rotations if they are listed.
+        std::vector<double> table = ParseFrequencyTable(job.output);
+        if (table.empty())
+        {
+            job.message = "no Hessian or frequencies found";
+            return;
+        }
+        std::vector<double> centered;
+        inertia_moments(geometry, analysis.masses, centered, analysis.moments);
+        analysis.linear = (geometry.n_atoms == 2) || (geometry.n_atoms > 2 && analysis.moments[0] < 1e-4 * analysis.moments[2]);
+        size_t n_vib = (geometry.n_atoms == 1) ? 0 : n - (analysis.linear ? 5 : 6);
+        std::sort(table.begin(), table.end(), [](double a, double b) { return fabs(a) < fabs(b); });
+        if (table.size() > n_vib)
+        {
+            table.erase(table.begin(), table.begin() + (table.size() - n_vib));
+        }
+        std::sort(table.begin(), table.end());
+        analysis.frequencies = table;
+        analysis.n_imaginary = std::count_if(table.begin(), table.end(), [](double f) { return f < 0.0; });
+    }
+    job.points = Thermochemistry(analysis, THERMO_TEMPERATURES, THERMO_PRESSURES);
+    job.ok = true;
+}
+
+std::string thermo_json(const ThermoJob &job)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::setprecision(10);
+    buffer << "{" << std::endl;
+    buffer << "  \"linear\": " << (job.analysis.linear ? "true" : "false") << "," << std::endl;
+    buffer << "  \"imaginary_modes\": " << job.analysis.n_imaginary << "," << std::endl;
+    buffer << "  \"electronic_energy\": ";
+    if (job.analysis.has_energy) buffer << job.analysis.electronic_energy; else buffer << "null";
+    buffer << "," << std::endl << "  \"frequencies_cm-1\": [";
+    for (size_t i = 0; i < job.analysis.frequencies.size(); i++)
+    {
+        buffer << (i ? ", " : "") << job.analysis.frequencies[i];
+    }
+    buffer << "]," << std::endl << "  \"thermochemistry\": [";
+    for (size_t i = 0; i < job.points.size(); i++)
+    {
+        const ThermoPoint &p = job.points[i];
+        buffer << (i ? "," : "") << std::endl << "    {\"temperature\": " << p.temperature << ", \"pressure_atm\": " << p.pressure << ", \"zpe\": " << p.zpe
+               << ", \"enthalpy_correction\": " << p.enthalpy_correction << ", \"entropy\": " << p.entropy << ", \"gibbs_correction\": " << p.gibbs_correction << "}";
+    }
+    buffer << std::endl << "  ]" << std::endl << "}" << std::endl;
+    return buffer.str();
+}
+
+std::vector<std::string> thermo_job_dirs(std::string dir)
+{
+    // A job directory stands for itself; any other directory (a campaign) for the job directories inside it.
+    ExecutorTask task;
+    if (ExecutorTaskFromJobDir(task, dir))
+    {
+        return {dir};
+    }
+    std::vector<std::string> job_dirs = {};
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (fs::is_directory(it->path()) && ExecutorTaskFromJobDir(task, it->path().string()))
+        {
+            job_dirs.push_back(it->path().string());
+        }
+    }
+    std::sort(job_dirs.begin(), job_dirs.end());
+    return job_dirs;
+}
+
+void RunThermoMode()
+{
+    for (std::string dir : THERMO_DIRS)
+    {
+        std::vector<std::string> job_dirs = thermo_job_dirs(dir);
+        std::vector<ThermoJob> jobs(job_dirs.size());
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            jobs[i].job_dir = job_dirs[i];
+        }
+        parallel_for(jobs.size(), default_thread_count(), [&](size_t i)
+        {
+            analyze_thermo_job(jobs[i]);
+            if (jobs[i].ok)
+            {
+                write_to_file(jobs[i].output + ".thermo.json", thermo_json(jobs[i]));
+            }
+        });
+
+        // One row per job, temperature and pressure; energies in Hartree, entropy in cal/(mol K).
+        std::stringstream table;
+        table.str("");
+        table << "job_dir\ttemperature_K\tpressure_atm\telectronic_energy\tzpe\tenthalpy_correction\tentropy_cal_mol_K\tgibbs_correction\tgibbs_energy\timaginary_modes" << std::endl;
+        table << std::setprecision(10);
+        size_t n_ok = 0;
+        for (const ThermoJob &job : jobs)
+        {
+            if (!job.ok)
+            {
+                normal_log("No thermochemistry for " + job.job_dir + ": " + job.message);
+                continue;
+            }
+            n_ok++;
+            for (const ThermoPoint &p : job.points)
+            {
+                table << job.job_dir << "\t" << p.temperature << "\t" << p.pressure << "\t";
+                if (job.analysis.has_energy) table << job.analysis.electronic_energy; else table << "nan";
+                table << "\t" << p.zpe << "\t" << p.enthalpy_correction << "\t" << p.entropy / HARTREE_PER_J_MOL / 4.184 << "\t" << p.gibbs_correction << "\t";
+                if (job.analysis.has_energy) table << job.analysis.electronic_energy + p.gibbs_correction; else table << "nan";
+                table << "\t" << job.analysis.n_imaginary << std::endl;
+            }
+        }
+        std::string summary = (fs::path(dir) / THERMO_SUMMARY_FILE).string();
+        write_to_file(summary, table.str());
+        normal_log("Thermochemistry for " + std::to_string(n_ok) + " of " + std::to_string(jobs.size()) + " job(s) in " + dir + " written to " + summary);
+    }
+}
@@ -0,0 +1,396 @@
+#include "trace.h"
+#include "tcinterface.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool TRACE = false;
+std::string TRACE_REPORT_DIR = "";
+
+std::mutex TRACE_LOCK;
+std::vector<TraceEvent> TRACE_EVENTS = {};
+
+void check_trace_flags(std::map<std::string,std::vector<std::string>> &flags)
+{
+    const char *environment = getenv("AUTOQUANTUM_TRACE");
+    if (flags.count("trace") > 0 || (environment != nullptr && !is_empty(environment) && std::string(environment) != "0"))
+    {
+        TRACE = true;
+        flags.erase("trace");
+    }
+    if (flags.count("trace_report") > 0)
+    {
+        // The report only rewrites an existing trace; this process's own phases are not added to it.
+        TRACE_REPORT_DIR = flags["trace_report"].empty() ? "." : flags["trace_report"][0];
+        TRACE = false;
+        flags.erase("trace_report");
+    }
+    if (TRACE)
+    {
+        // Written at exit, wherever AutoQuantum finishes, including through error_log().
+        AddCleanupHook([]() { WriteTraceFiles("."); });
+    }
+}
+
+int64_t trace_clock_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int trace_thread_index()
+{
+    static std::atomic<int> next(1);
+    thread_local int index = next++;
+    return index;
+}
+
+void RecordTraceEvent(const char *name, int64_t start_us, int64_t end_us)
+{
+    TraceEvent event;
+    event.name = name;
+    event.category = "autoquantum";
+    event.start_us = start_us;
+    event.duration_us = end_us - start_us;
+    event.pid = getpid();
+    event.tid = trace_thread_index();
+    std::lock_guard<std::mutex> guard(TRACE_LOCK);
+    TRACE_EVENTS.push_back(event);
+}
+
+// Reading back
+std::string trace_field(const std::string &line, std::string key)
+{
+    // Fields of the event lines written by WriteTraceFiles(): strings, integers, and "args" last.
+    size_t pos = line.find("\"" + key + "\": ");
+    if (pos == std::string::npos)
+    {
+        return "";
+    }
+    pos += key.size() + 4;
+    if (line[pos] == '"')
+    {
+        std::string value = "";
+        for (size_t i = pos + 1; i < line.size() && line[i] != '"'; i++)
+        {
+            if (line[i] == '\\' && i + 1 < line.size())
+            {
+                i++;
+            }
+            value += line[i];
+        }
+        return value;
+    }
+    if (line[pos] == '{')
+    {
+        size_t end = line.rfind('}');
+        return (end != std::string::npos && end > pos + 1) ? line.substr(pos + 1, end - 1 - (pos + 1)) : "";
+    }
+    return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+std::vector<TraceEvent> ReadTraceEvents(std::string filename)
+{
+    std::vector<TraceEvent> events = {};
+    std::ifstream fin(filename);
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (trace_field(line, "ph") != "X")
+        {
+            continue;
+        }
+        TraceEvent event;
+        event.name = trace_field(line, "name");
+        event.category = trace_field(line, "cat");
+        event.start_us = std::stoll(trace_field(line, "ts"));
+        event.duration_us = std::stoll(trace_field(line, "dur"));
+        event.pid = std::stoi(trace_field(line, "pid"));
+        event.tid = std::stoi(trace_field(line, "tid"));
+        event.args = trace_field(line, "args");
+        events.push_back(event);
+    }
+    return events;
+}
+
+// TeraChem's own timings
+bool last_number_in_line(const std::string &line, double &value)
+{
+    size_t end = line.find_last_not_of(" \t\r");
+    if (end == std::string::npos)
+    {
+        return false;
+    }
+    size_t start = line.find_last_of(" \t", end);
+    std::string token = line.substr(start == std::string::npos ? 0 : start + 1, end - (start == std::string::npos ? 0 : start + 1) + 1);
+    char *stop = nullptr;
+    value = strtod(token.c_str(), &stop);
+    return (stop != token.c_str() && *stop == '\0');
+}
+
+TraceEvent terachem_event(std::string name, int64_t start_us, double seconds, std::string args)
+{
+    TraceEvent event;
+    event.name = name;
+    event.category = "terachem";
+    event.start_us = start_us;
+    event.duration_us = (int64_t)(seconds * 1e6);
+    event.pid = 0;
+    event.tid = 1;
+    event.args = args;
+    return event;
+}
+
+std::vector<TraceEvent> TeraChemTraceEvents(std::string tc_output, int64_t start_us)
+{
+    // The output has durations but no clock: SCF iterations (the Time(s) column) and
+    // reported gradient times are laid end to end from the start of the run. Without
+    // a known start, the run is taken to end when the output was last written.
+    std::vector<TraceEvent> events = {};
+    std::ifstream fin(tc_output);
+    if (!fin.is_open())
+    {
+        return events;
+    }
+    std::vector<TraceEvent> steps = {};
+    std::vector<double> iteration_times = {};
+    double total_time = -1.0;
+    bool in_scf = false;
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (line.find("Start SCF Iterations") != std::string::npos)
+        {
+            in_scf = true;
+            iteration_times.clear();
+            continue;
+        }
+        size_t pos = line.find("FINAL ENERGY:");
+        if (pos != std::string::npos)
+        {
+            double scf_time = 0.0;
+            for (double t : iteration_times)
+            {
+                scf_time += t;
+            }
+            std::stringstream args;
+            args.str("");
+            args << std::setprecision(12) << "\"iterations\": " << iteration_times.size() << ", \"energy\": " << strtod(line.c_str() + pos + 13, nullptr);
+            steps.push_back(terachem_event("SCF", 0, scf_time, args.str()));
+            for (size_t k = 0; k < iteration_times.size(); k++)
+            {
+                steps.push_back(terachem_event("SCF iteration", 0, iteration_times[k], "\"iteration\": " + std::to_string(k + 1)));
+            }
+            in_scf = false;
+            continue;
+        }
+        double value = 0.0;
+        if (in_scf)
+        {
+            size_t first = line.find_first_not_of(" \t");
+            if (first != std::string::npos && isdigit((unsigned char)line[first]) && last_number_in_line(line, value))
+            {
+                iteration_times.push_back(value);
+            }
+            continue;
+        }
+        std::string lower = line;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        pos = lower.find("time");
+        if (lower.find("gradient") != std::string::npos && pos != std::string::npos)
+        {
+            pos = lower.find_first_of("0123456789", pos);
+            if (pos != std::string::npos)
+            {
+                steps.push_back(terachem_event("gradient", 0, strtod(line.c_str() + pos, nullptr), ""));
+            }
+            continue;
+        }
+        pos = line.find("Total processing time:");
+        if (pos != std::string::npos)
+        {
+            total_time = strtod(line.c_str() + pos + 22, nullptr);
+        }
+    }
+    fin.close();
+
+    double steps_time = 0.0;
+    for (TraceEvent &step : steps)
+    {
+        if (step.name != "SCF iteration")
+        {
+            steps_time += step.duration_us * 1e-6;
+        }
+    }
+    double run_time = std::max(total_time, steps_time);
+    if (start_us == 0)
+    {
+        struct stat info;
+        int64_t written_us = (stat(tc_output.c_str(), &info) == 0) ? (int64_t)info.st_mtime * 1000000 : trace_clock_us();
+        start_us = written_us - (int64_t)(run_time * 1e6);
+    }
+    events.push_back(terachem_event("TeraChem", start_us, run_time, "\"output\": \"" + json_escape(tc_output) + "\""));
+    int64_t cursor = start_us, cycle_cursor = start_us;
+    for (TraceEvent &step : steps)
+    {
+        if (step.name == "SCF iteration")
+        {
+            // Iterations fall inside the SCF placed just before them, which has already moved the cursor on.
+            step.start_us = cycle_cursor;
+            cycle_cursor += step.duration_us;
+        }
+        else
+        {
+            step.start_us = cursor;
+            cycle_cursor = cursor;
+            cursor += step.duration_us;
+        }
+        events.push_back(step);
+    }
+    return events;
+}
+
+// Output
+std::string trace_event_json(const TraceEvent &event)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "{\"name\": \"" << json_escape(event.name) << "\", \"cat\": \"" << event.category << "\", \"ph\": \"X\", \"ts\": " << event.start_us << ", \"dur\": " << event.duration_us
+           << ", \"pid\": " << event.pid << ", \"tid\": " << event.tid << ", \"args\": {" << event.args << "}}";
+    return buffer.str();
+}
+
+std::string TraceSummaryJSON(const std::vector<TraceEvent> &events)
+{
+    // AutoQuantum phases by name in order of first appearance, and TeraChem's totals.
+    std::vector<std::string> order = {};
+    std::map<std::string,std::vector<int64_t>> phases = {};
+    int64_t first = 0, last = 0;
+    std::map<std::string,std::pair<size_t,double>> terachem = {};
+    size_t scf_iterations = 0;
+    for (const TraceEvent &event : events)
+    {
+        if (event.category == "terachem")
+        {
+            terachem[event.name].first++;
+            terachem[event.name].second += event.duration_us * 1e-6;
+            if (event.name == "SCF")
+            {
+                scf_iterations += std::stoul("0" + trace_field("{\"args\": {" + event.args + "}}", "iterations"));
+            }
+            continue;
+        }
+        if (phases.count(event.name) == 0)
+        {
+            order.push_back(event.name);
+        }
+        phases[event.name].push_back(event.duration_us);
+        first = (first == 0) ? event.start_us : std::min(first, event.start_us);
+        last = std::max(last, event.start_us + event.duration_us);
+    }
+
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << std::fixed << std::setprecision(3) << "{" << std::endl;
+    buffer << "  \"autoquantum_wall_ms\": " << (last - first) * 1e-3 << "," << std::endl;
+    buffer << "  \"phases\": [";
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        std::vector<int64_t> &durations = phases[order[i]];
+        int64_t total = 0;
+        for (int64_t d : durations)
+        {
+            total += d;
+        }
+        buffer << (i > 0 ? "," : "") << std::endl << "    {\"name\": \"" << json_escape(order[i]) << "\", \"count\": " << durations.size() << ", \"total_ms\": " << total * 1e-3
+               << ", \"max_ms\": " << *std::max_element(durations.begin(), durations.end()) * 1e-3 << "}";
+    }
+    buffer << std::endl << "  ]," << std::endl;
+    buffer << "  \"terachem\": {\"total_seconds\": " << terachem["TeraChem"].second << ", \"scf_cycles\": " << terachem["SCF"].first << ", \"scf_iterations\": " << scf_iterations
+           << ", \"scf_seconds\": " << terachem["SCF"].second << ", \"mean_scf_iteration_seconds\": " << (scf_iterations > 0 ? terachem["SCF"].second / scf_iterations : 0.0)
+           << ", \"gradients\": " << terachem["gradient"].first << ", \"gradient_seconds\": " << terachem["gradient"].second << "}" << std::endl;
+    buffer << "}" << std::endl;
+    return buffer.str();
+}
+
+std::string find_trace_tc_output(std::string dir)
+{
+    if (!TC_OUTFILE.empty() && fs::exists(fs::path(dir) / TC_OUTFILE))
+    {
+        return (fs::path(dir) / TC_OUTFILE).string();
+    }
+    std::error_code ec;
+    for (auto &entry : fs::directory_iterator(dir, ec))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("tc_", 0) == 0 && name.size() > 7 && name.substr(name.size() - 4) == ".out" && name.find(".restart") == std::string::npos)
+        {
+            return entry.path().string();
+        }
+    }
+    return "";
+}
+
+void WriteTraceFiles(std::string dir)
+{
+    // Earlier processes' events are kept; TeraChem's are worked out again from the current output.
+    std::vector<TraceEvent> events = {};
+    for (TraceEvent &event : ReadTraceEvents((fs::path(dir) / TRACE_FILE).string()))
+    {
+        if (event.category != "terachem")
+        {
+            events.push_back(event);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(TRACE_LOCK);
+        events.insert(events.end(), TRACE_EVENTS.begin(), TRACE_EVENTS.end());
+        TRACE_EVENTS.clear();
+    }
+    int64_t run_start = 0;
+    for (TraceEvent &event : events)
+    {
+        if (event.name == "run_terachem")
+        {
+            run_start = std::max(run_start, event.start_us);
+        }
+    }
+    std::string tc_output = find_trace_tc_output(dir);
+    if (!tc_output.empty())
+    {
+        std::vector<TraceEvent> terachem = TeraChemTraceEvents(tc_output, run_start);
+        events.insert(events.end(), terachem.begin(), terachem.end());
+    }
+
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    std::map<int,bool> processes = {};
+    for (TraceEvent &event : events)
+    {
+        processes[event.pid] = true;
+    }
+    for (auto &process : processes)
+    {
+        std::string name = (process.first == 0) ? "TeraChem" : "autoquantum " + std::to_string(process.first);
+        buffer << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << process.first << ", \"args\": {\"name\": \"" << name << "\"}}," << std::endl;
+    }
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        buffer << trace_event_json(events[i]) << (i + 1 < events.size() ? "," : "") << std::endl;
+    }
+    buffer << "]}" << std::endl;
+    write_to_file((fs::path(dir) / TRACE_FILE).string(), buffer.str());
+    write_to_file((fs::path(dir) / TRACE_SUMMARY_FILE).string(), TraceSummaryJSON(events));
+}
+
+void RunTraceReportMode()
+{
+    if (!fs::is_directory(TRACE_REPORT_DIR))
+    {
+        error_log("No such job directory: " + TRACE_REPORT_DIR, 1);
+    }
+    WriteTraceFiles(TRACE_REPORT_DIR);
+    normal_log("Timings written to " + (fs::path(TRACE_REPORT_DIR) / TRACE_SUMMARY_FILE).string() + " and " + (fs::path(TRACE_REPORT_DIR) / TRACE_FILE).string());
+}
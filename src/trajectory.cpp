@@ -0,0 +1,294 @@
+#include "trajectory.h"
+
+std::string EXTRACT_TRAJECTORY = "";
+long EXTRACT_FRAME = -1;
+
+void check_extract_frame_mode(std::map<std::string,std::vector<std::string>> &flags)
+{
+    if (flags.count("extract_frame") > 0)
+    {
+        std::vector<std::string> values = flags["extract_frame"];
+        if (values.empty())
+        {
+            PrintUsage();
+            error_log("The --extract_frame flag requires a trajectory file and optionally a frame number (negative counts from the end).", 1);
+        }
+        EXTRACT_TRAJECTORY = values[0];
+        if (values.size() > 1)
+        {
+            EXTRACT_FRAME = std::stol(values[1]);
+        }
+        flags.erase("extract_frame");
+    }
+}
+
+void RunExtractFrameMode()
+{
+    XYZTrajectory trajectory;
+    if (!OpenTrajectory(trajectory, EXTRACT_TRAJECTORY))
+    {
+        error_log("Unable to open trajectory " + EXTRACT_TRAJECTORY, 1);
+    }
+    long n_frames = TrajectoryFrameCount(trajectory);
+    long frame = (EXTRACT_FRAME < 0) ? n_frames + EXTRACT_FRAME : EXTRACT_FRAME;
+    if (frame < 0 || frame >= n_frames)
+    {
+        CloseTrajectory(trajectory);
+        error_log("Frame " + std::to_string(EXTRACT_FRAME) + " is outside of the " + std::to_string(n_frames) + " frames in " + EXTRACT_TRAJECTORY, 1);
+    }
+    XYZFrames frames;
+    bool read = ReadTrajectoryFrames(frames, trajectory, {(size_t)frame}, 1);
+    CloseTrajectory(trajectory);
+    if (!read)
+    {
+        error_log("Unable to read frame " + std::to_string(frame) + " of " + EXTRACT_TRAJECTORY, 1);
+    }
+
+    std::string outfile = fs::path(EXTRACT_TRAJECTORY).stem().string() + ".frame" + std::to_string(frame) + ".xyz";
+    write_to_file(outfile, FrameToXYZ(frames, 0));
+    normal_log("Wrote frame " + std::to_string(frame) + " of " + std::to_string(n_frames) + " to " + outfile);
+}
+
+// Frame index sidecar: "AQIX" magic, indexed_bytes, frame count, then the offsets.
+const char TRAJECTORY_INDEX_MAGIC[4] = {'A','Q','I','X'};
+
+bool read_trajectory_index(XYZTrajectory &trajectory)
+{
+    std::ifstream in(trajectory.filename + ".aqidx", std::ios::in | std::ios::binary);
+    if (!in.is_open())
+    {
+        return false;
+    }
+    char magic[4];
+    uint64_t indexed_bytes = 0;
+    uint64_t n_frames = 0;
+    if (!in.read(magic, 4) || memcmp(magic, TRAJECTORY_INDEX_MAGIC, 4) != 0)
+    {
+        return false;
+    }
+    if (!in.read((char*)&indexed_bytes, sizeof(uint64_t)) || !in.read((char*)&n_frames, sizeof(uint64_t)))
+    {
+        return false;
+    }
+    // A trajectory that shrank was rewritten, so the index no longer applies.
+    if (indexed_bytes > trajectory.mapped.size || n_frames > indexed_bytes)
+    {
+        return false;
+    }
+    std::vector<uint64_t> offsets(n_frames);
+    if (!in.read((char*)offsets.data(), n_frames * sizeof(uint64_t)))
+    {
+        return false;
+    }
+    // Spot-check the first and last frames rather than touching every page of the file.
+    for (uint64_t offset : {offsets.empty() ? 0 : offsets.front(), offsets.empty() ? 0 : offsets.back()})
+    {
+        if (!offsets.empty() && (offset >= indexed_bytes || !(isdigit((unsigned char)trajectory.mapped.data[offset]) || isspace((unsigned char)trajectory.mapped.data[offset]))))
+        {
+            return false;
+        }
+    }
+    trajectory.offsets = offsets;
+    trajectory.indexed_bytes = indexed_bytes;
+    return true;
+}
+
+void write_trajectory_index(const XYZTrajectory &trajectory)
+{
+    std::ofstream out(trajectory.filename + ".aqidx", std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        debug_log("Unable to write frame index for " + trajectory.filename);
+        return;
+    }
+    uint64_t n_frames = trajectory.offsets.size();
+    out.write(TRAJECTORY_INDEX_MAGIC, 4);
+    out.write((const char*)&trajectory.indexed_bytes, sizeof(uint64_t));
+    out.write((const char*)&n_frames, sizeof(uint64_t));
+    out.write((const char*)trajectory.offsets.data(), n_frames * sizeof(uint64_t));
+    out.close();
+}
+
+void index_trajectory_frames(XYZTrajectory &trajectory)
+{
+    // Walk frame headers only: read the atom count, then skip count+1 lines with memchr.
+    const char *data = trajectory.mapped.data;
+    const char *stop = data + trajectory.mapped.size;
+    const char *p = data + trajectory.indexed_bytes;
+    while (p < stop)
+    {
+        const char *line_end = (const char*)memchr(p, '\n', stop - p);
+        if (line_end == nullptr)
+        {
+            break;
+        }
+        char *num_end = nullptr;
+        long n_atoms = strtol(p, &num_end, 10);
+        if (num_end == p || num_end > line_end || n_atoms <= 0)
+        {
+            // Tolerate blank separator lines between frames.
+            if (is_empty(std::string(p, line_end - p).c_str()))
+            {
+                p = line_end + 1;
+                trajectory.indexed_bytes = p - data;
+                continue;
+            }
+            break;
+        }
+        const char *q = line_end + 1;
+        long lines_needed = n_atoms + 1;
+        while (lines_needed > 0 && q < stop)
+        {
+            const char *next = (const char*)memchr(q, '\n', stop - q);
+            if (next == nullptr)
+            {
+                break;
+            }
+            q = next + 1;
+            lines_needed--;
+        }
+        if (lines_needed > 0)
+        {
+            // Frame still being written.
+            break;
+        }
+        trajectory.offsets.push_back(p - data);
+        p = q;
+        trajectory.indexed_bytes = p - data;
+    }
+}
+
+bool OpenTrajectory(XYZTrajectory &trajectory, std::string filename)
+{
+    trajectory = XYZTrajectory();
+    trajectory.filename = filename;
+    if (!map_file(trajectory.mapped, filename))
+    {
+        return false;
+    }
+    bool have_index = read_trajectory_index(trajectory);
+    uint64_t previous_bytes = trajectory.indexed_bytes;
+    if (!have_index)
+    {
+        trajectory.offsets.clear();
+        trajectory.indexed_bytes = 0;
+    }
+    index_trajectory_frames(trajectory);
+    if ((!have_index || trajectory.indexed_bytes != previous_bytes) && trajectory.mapped.size >= TRAJECTORY_INDEX_MIN_BYTES)
+    {
+        write_trajectory_index(trajectory);
+    }
+    debug_log("Indexed " + std::to_string(trajectory.offsets.size()) + " frames in " + filename);
+    return true;
+}
+
+void CloseTrajectory(XYZTrajectory &trajectory)
+{
+    unmap_file(trajectory.mapped);
+    trajectory.offsets.clear();
+}
+
+size_t TrajectoryFrameCount(const XYZTrajectory &trajectory)
+{
+    return trajectory.offsets.size();
+}
+
+const char* decode_xyz_frame(const char *p, const char *stop, size_t n_atoms, std::string &comment, std::string *elements, double *x, double *y, double *z)
+{
+    // Skip the atom count line, keep the comment, then decode one atom per line.
+    p = (const char*)memchr(p, '\n', stop - p) + 1;
+    const char *line_end = (const char*)memchr(p, '\n', stop - p);
+    comment.assign(p, line_end - p);
+    p = line_end + 1;
+    for (size_t k = 0; k < n_atoms; k++)
+    {
+        line_end = (const char*)memchr(p, '\n', stop - p);
+        while (p < line_end && isspace((unsigned char)*p)) p++;
+        const char *name_end = p;
+        while (name_end < line_end && !isspace((unsigned char)*name_end)) name_end++;
+        if (elements != nullptr)
+        {
+            elements[k].assign(p, name_end - p);
+        }
+        char *num_end = nullptr;
+        x[k] = strtod(name_end, &num_end);
+        y[k] = strtod(num_end, &num_end);
+        z[k] = strtod(num_end, &num_end);
+        p = line_end + 1;
+    }
+    return p;
+}
+
+bool ReadTrajectoryFrames(XYZFrames &result, const XYZTrajectory &trajectory, std::vector<size_t> frames, unsigned int n_threads)
+{
+    // Fails if a frame is out of range or has a different atom count from the first one.
+    result = XYZFrames();
+    if (frames.empty())
+    {
+        return true;
+    }
+    for (size_t frame : frames)
+    {
+        if (frame >= trajectory.offsets.size())
+        {
+            return false;
+        }
+    }
+    const char *data = trajectory.mapped.data;
+    const char *stop = data + trajectory.indexed_bytes;
+    result.n_atoms = strtoul(data + trajectory.offsets[frames[0]], nullptr, 10);
+    result.elements.resize(result.n_atoms);
+    result.comments.resize(frames.size());
+    result.frame_ids = frames;
+    result.x.resize(frames.size() * result.n_atoms);
+    result.y.resize(frames.size() * result.n_atoms);
+    result.z.resize(frames.size() * result.n_atoms);
+
+    // Frames decode independently once their offsets are known; only the first one fills in element names.
+    std::atomic<bool> ok(true);
+    parallel_for(frames.size(), n_threads, [&](size_t f)
+    {
+        const char *p = data + trajectory.offsets[frames[f]];
+        size_t n_atoms = strtoul(p, nullptr, 10);
+        if (n_atoms != result.n_atoms)
+        {
+            ok = false;
+            return;
+        }
+        size_t base = f * result.n_atoms;
+        decode_xyz_frame(p, stop, n_atoms, result.comments[f], (f == 0) ? result.elements.data() : nullptr, &result.x[base], &result.y[base], &result.z[base]);
+    });
+    if (!ok)
+    {
+        result = XYZFrames();
+    }
+    return ok;
+}
+
+XYZFrames ReadLastFrame(std::string filename)
+{
+    XYZTrajectory trajectory;
+    XYZFrames frames;
+    if (OpenTrajectory(trajectory, filename) && TrajectoryFrameCount(trajectory) > 0)
+    {
+        ReadTrajectoryFrames(frames, trajectory, {TrajectoryFrameCount(trajectory) - 1}, 1);
+    }
+    CloseTrajectory(trajectory);
+    return frames;
+}
+
+std::string FrameToXYZ(const XYZFrames &frames, size_t k)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    buffer << frames.n_atoms << std::endl;
+    buffer << frames.comments[k] << std::endl;
+    buffer << std::fixed << std::setprecision(10);
+    for (size_t a = 0; a < frames.n_atoms; a++)
+    {
+        size_t i = k * frames.n_atoms + a;
+        buffer << std::left << std::setw(4) << frames.elements[a] << std::right;
+        buffer << std::setw(20) << frames.x[i] << std::setw(20) << frames.y[i] << std::setw(20) << frames.z[i] << std::endl;
+    }
+    return buffer.str();
+}
@@ -1,28 +1,21 @@
 
 #include "utilities.h"
+#include "process.h"
+#include "modules.h"
+#include "archive.h"
+#include "trace.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-// LOGGING FUNCTIONS - Normal, Error, Debug-flagged.
-void error_log(std::string message, int exit_code)
-{
-    std::cerr << message << std::endl;
-    exit(exit_code);
-}
-void normal_log(std::string message)
-{
-    std::cout << message << std::endl;
-}
-void debug_log(std::string message)
-{
-    if (DEBUG)
-    {
-        std::cout << "DEBUG: " << message << std::endl;
-    }
-}
+// LOGGING FUNCTIONS - Normal, Error, Debug-flagged (buffered, see logger.cpp).
 void splash_screen()
 {
-    std::cout << "###########################" << std::endl;
-    std::cout << "# AutoQuantum w/ TeraChem #" << std::endl;
-    std::cout << "###########################" << std::endl;
+    normal_log("###########################");
+    normal_log("# AutoQuantum w/ TeraChem #");
+    normal_log("###########################");
 }
 std::string GetTimeAndDate()
 {
@@ -64,15 +57,13 @@ molecule, you can use a simple command:
 }
 
 // System Commands
+// Only shell syntax (e.g. 'module' functions) needs these; plain programs should go through RunProcess().
 void silent_shell(const char* cmd)
 {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::shared_ptr<FILE> pipe(popen(cmd, "r"), pclose);
-    if (!pipe) throw std::runtime_error("popen() failed!");
-    while (!feof(pipe.get())) {
-        if (fgets(buffer.data(), 128, pipe.get()) != nullptr)
-            result += buffer.data();
+    Process process = RunProcess({"/bin/sh", "-c", cmd});
+    if (process.exit_code < 0)
+    {
+        throw std::runtime_error("Unable to start /bin/sh");
     }
 }
 void silent_shell(std::string cmd)
@@ -81,46 +72,74 @@ void silent_shell(std::string cmd)
 }
 std::string GetSysResponse(const char* cmd)
 {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::shared_ptr<FILE> pipe(popen(cmd, "r"), pclose);
-    if (!pipe) throw std::runtime_error("popen() failed!");
-    while (!feof(pipe.get())) {
-        if (fgets(buffer.data(), 128, pipe.get()) != nullptr)
-            result += buffer.data();
+    ProcessOptions options;
+    options.capture = true;
+    Process process = RunProcess({"/bin/sh", "-c", cmd}, options);
+    if (process.exit_code < 0)
+    {
+        throw std::runtime_error("Unable to start /bin/sh");
     }
-    return result;
+    return process.output;
 }
 std::string GetSysResponse(std::string cmd)
 {
     return GetSysResponse(cmd.c_str());
 }
+bool UseSlurmSubmission()
+{
+    // Jobs on warrior go through SLURM, anything else runs TeraChem directly.
+    // AUTOQUANTUM_SCHEDULER=slurm|local overrides the hostname, e.g. against a simulated cluster.
+    const char *scheduler = getenv("AUTOQUANTUM_SCHEDULER");
+    if (scheduler != nullptr && !is_empty(scheduler))
+    {
+        return (std::string(scheduler) == "slurm");
+    }
+    char name[256] = {0};
+    gethostname(name, sizeof(name) - 1);
+    std::string hostname(name);
+    return (hostname.find("warrior") != std::string::npos);
+}
+std::string autoquantum_cache_directory()
+{
+    std::string base = "";
+    if (getenv("XDG_CACHE_HOME") != nullptr)
+    {
+        base = getenv("XDG_CACHE_HOME");
+    }
+    else if (getenv("HOME") != nullptr)
+    {
+        base = std::string(getenv("HOME")) + "/.cache";
+    }
+    else
+    {
+        base = "/tmp";
+    }
+    return base + "/autoquantum/";
+}
+std::string AutoQuantumExecutable()
+{
+    // Full path of the running binary, for batch scripts that call back into AutoQuantum.
+    return fs::read_symlink("/proc/self/exe").string();
+}
 bool CheckProgAvailable(const char* program)
 {
-        std::string result;
-        std::stringstream cmd;
-        cmd.str("");
-        cmd << "which " << program;
-        debug_log(cmd.str());
-        result=GetSysResponse(cmd.str().c_str());
+        std::string result = FindInPath(program);
+        debug_log("which " + std::string(program) + ": " + result);
         if (result.empty())
         {
-            std::cout << "Missing program: " << program << std::endl;
+            normal_log("Missing program: " + std::string(program));
             return false;
         }
         return true;
 }
 bool CheckProgAvailable(const char* program, const char* module)
 {
-        std::string result;
-        std::stringstream cmd;
-        cmd.str("");
-        cmd << "module load " << module << "; which " << program;
-        debug_log(cmd.str());
-        result=GetSysResponse(cmd.str().c_str());
+        std::map<std::string,std::string> environment = ModuleProcessEnvironment(ResolveModuleEnvironment(module));
+        std::string result = FindInPath(program, environment.count("PATH") ? environment["PATH"] : "");
+        debug_log("module load " + std::string(module) + "; which " + std::string(program) + ": " + result);
         if (result.empty())
         {
-            std::cout << "Missing program: " << program << std::endl;
+            normal_log("Missing program: " + std::string(program));
             return false;
         }
         return true;
@@ -155,19 +174,52 @@ void append_to_file(std::string inputfilename, std::string buffer)
 }
 std::string LastLineOfFile(std::string filename)
 {
-    std::ifstream fin;
-    fin.open(filename);
-    std::string line;
-    std::vector<std::string> lines_in_order;
-    while (std::getline(fin, line))
-    {   
-        if ( !is_empty(line.c_str()) )
+    // Read backwards from the end in blocks until a non-empty line is complete.
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    if (!fin.is_open())
+    {
+        return "";
+    }
+    fin.seekg(0, std::ios::end);
+    std::streamoff position = fin.tellg();
+    const std::streamoff block_size = 4096;
+    std::string tail = "";
+    while (position > 0)
+    {
+        std::streamoff n = std::min(block_size, position);
+        position -= n;
+        std::string block(n, '\0');
+        fin.seekg(position);
+        fin.read(&block[0], n);
+        tail = block + tail;
+
+        // Look for a non-empty line that has a newline (or the start of the file) in front of it.
+        size_t end = tail.size();
+        while (end > 0)
         {
-            lines_in_order.push_back(line);
+            size_t start = tail.rfind('\n', end - 1);
+            if (start == std::string::npos && position > 0)
+            {
+                break;
+            }
+            start = (start == std::string::npos) ? 0 : start + 1;
+            std::string line = tail.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!is_empty(line.c_str()))
+            {
+                return line;
+            }
+            if (start == 0)
+            {
+                break;
+            }
+            end = start - 1;
         }
     }
-    fin.close();
-    return lines_in_order[lines_in_order.size()-1];
+    return "";
 }
 int count_lines_in_file(std::string filename)
 {
@@ -182,10 +234,16 @@ int count_lines_in_file(std::string filename)
 }
 void compress_and_delete(std::string directory)
 {
-    std::stringstream buffer;
-    buffer.str("");
-    buffer << "tar -czvf " << directory << ".tar.gz "<< directory << "/ && rm -r " << directory << "/";
-    silent_shell(buffer.str().c_str());
+    // Only remove the directory once the archive has been read back and checked.
+    std::string archive = directory + ".tar.gz";
+    if (ArchiveDirectory(directory, archive, default_thread_count()) && VerifyArchive(archive, default_thread_count()))
+    {
+        fs::remove_all(directory);
+    }
+    else
+    {
+        normal_log("Unable to archive " + directory + ", leaving it in place.");
+    }
 }
 std::vector<std::string> sort_files_by_timestamp(std::string directory,std::string pattern)
 {
@@ -201,31 +259,145 @@ std::vector<std::string> sort_files_by_timestamp(std::string directory,std::stri
 
     for (auto p : sort_by_name)
     {
-        std::cout << p << std::endl;
+        normal_log(p.string());
         file_list.push_back(p);
     }
     
     return file_list;
 }
+bool map_file(MappedFile &mapped, std::string filename)
+{
+    mapped.fd = open(filename.c_str(), O_RDONLY);
+    if (mapped.fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(mapped.fd, &info) != 0)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    mapped.size = info.st_size;
+    if (mapped.size == 0)
+    {
+        return true;
+    }
+    void *addr = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, mapped.fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        unmap_file(mapped);
+        return false;
+    }
+    madvise(addr, mapped.size, MADV_SEQUENTIAL);
+    mapped.data = (const char*)addr;
+    return true;
+}
+void unmap_file(MappedFile &mapped)
+{
+    if (mapped.data != nullptr)
+    {
+        munmap((void*)mapped.data, mapped.size);
+    }
+    if (mapped.fd >= 0)
+    {
+        close(mapped.fd);
+    }
+    mapped = MappedFile();
+}
+std::string iterative_directory_name(std::string dir_base, int num_zeros, unsigned long long number)
+{
+    std::stringstream name;
+    name.str("");
+    name << dir_base << "." << std::setw(num_zeros) << std::setfill('0') << number << "/";
+    return name.str();
+}
+unsigned long long first_free_directory_number(std::string dir_base, int num_zeros)
+{
+    // No counter file yet: double until a gap turns up, then bisect, so older trees cost O(log n) stats.
+    unsigned long long low = 0, high = 1;
+    while (fs::is_directory(iterative_directory_name(dir_base, num_zeros, high)))
+    {
+        low = high;
+        high *= 2;
+    }
+    while (high - low > 1)
+    {
+        unsigned long long middle = low + (high - low) / 2;
+        if (fs::is_directory(iterative_directory_name(dir_base, num_zeros, middle)))
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return high;
+}
 std::string MakeIterativeDirectoryName(std::string dir_base, int num_zeros)
 {
-    std::stringstream new_dir_name;
-    int num_dirs_found = 0;
-    do 
+    TraceScope trace("allocate_job_directory");
+    // The counter file is only a hint; mkdir() is what claims a number, so concurrent callers never share one.
+    std::string counter_file = "." + dir_base + ".next";
+    unsigned long long number = 0;
+    std::ifstream fin(counter_file);
+    if (!(fin >> number) || number < 1)
     {
-        num_dirs_found++;
-        new_dir_name.str("");
-        new_dir_name << dir_base << "."<< std::setw(num_zeros) << std::setfill('0') << num_dirs_found << "/";
-    } while (fs::is_directory(new_dir_name.str()));
-    if (fs::create_directory(new_dir_name.str()))
+        number = first_free_directory_number(dir_base, num_zeros);
+    }
+    fin.close();
+
+    std::string new_dir_name = iterative_directory_name(dir_base, num_zeros, number);
+    while (mkdir(new_dir_name.c_str(), 0777) != 0)
     {
-        return new_dir_name.str();
+        if (errno != EEXIST)
+        {
+            error_log("Unable to create iterative directory " + new_dir_name + ": " + strerror(errno), 1);
+        }
+        number++;
+        new_dir_name = iterative_directory_name(dir_base, num_zeros, number);
     }
-    else
+
+    // Publish the next number with an atomic rename; a stale hint only costs a few extra mkdir() calls.
+    std::string temporary = counter_file + "." + std::to_string(getpid()) + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    write_to_file(temporary, std::to_string(number + 1) + "\n");
+    if (rename(temporary.c_str(), counter_file.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+    }
+    return new_dir_name;
+}
+
+// Threading
+unsigned int default_thread_count()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+void parallel_for(size_t n_items, unsigned int n_threads, std::function<void(size_t)> task)
+{
+    // Workers pull the next index from a shared counter, so uneven tasks still balance.
+    if (n_threads < 1) n_threads = 1;
+    if (n_threads > n_items) n_threads = n_items;
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < n_items; i = next++)
+        {
+            task(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < n_threads; t++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &th : pool)
     {
-        error_log("Unable to create iterative directory.",1);
+        th.join();
     }
-    return "./";
 }
 
 // String Utilities
@@ -241,35 +413,57 @@ int is_empty(const char *s)
 }
 std::string string_between(std::string incoming, std::string first_delim, std::string second_delim)
 {
-    unsigned first = incoming.find(first_delim);
+    size_t first = incoming.find(first_delim);
     if (first == std::string::npos)
     {
         return incoming;
     }
     incoming = incoming.substr(first+1,incoming.size() - first -1);
 
-    unsigned last = incoming.find(second_delim);
+    size_t last = incoming.find(second_delim);
     if (last == std::string::npos)
     {
         return incoming.substr(0, incoming.size());
     }
     return incoming.substr(0, last);
 }
+std::string json_escape(std::string text)
+{
+    std::stringstream buffer;
+    buffer.str("");
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            buffer << '\\' << c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            buffer << ' ';
+        }
+        else
+        {
+            buffer << c;
+        }
+    }
+    return buffer.str();
+}
 std::vector<std::string> split_string(std::string incoming, std::string delim)
 {
     std::vector<std::string> chunks = {};
-    unsigned int pos = incoming.find(delim);
-    do
+    size_t start = 0;
+    size_t pos = incoming.find(delim);
+    while (pos != std::string::npos)
     {
-        std::string piece = incoming.substr(0,pos);
+        std::string piece = incoming.substr(start,pos-start);
         if (!is_empty(piece.c_str()))
         {
             chunks.push_back(piece);
-        }       
-        incoming = incoming.substr(pos+1,incoming.size()-pos-1);
-        pos = incoming.find(delim);
-    } while (pos != std::string::npos);
-    chunks.push_back(incoming.substr(0,incoming.find_first_of(delim)));
+        }
+        start = pos + std::max<size_t>(delim.size(), 1);
+        pos = incoming.find(delim, start);
+    }
+    chunks.push_back(incoming.substr(start));
     return chunks;
 }
 
@@ -351,4 +545,25 @@ void check_debug_mode(std::map<std::string,std::vector<std::string>> &flags)
         flags.erase("DRYRUN");
     }
 
-}
\ No newline at end of file
+}
+
+// Chemistry
+int element_atomic_number(std::string element)
+{
+    static const std::vector<std::string> symbols = {"H", "He", "Li", "Be", "B", "C", "N", "O", "F", "Ne", "Na", "Mg", "Al", "Si", "P", "S", "Cl", "Ar",
+                                                     "K", "Ca", "Sc", "Ti", "V", "Cr", "Mn", "Fe", "Co", "Ni", "Cu", "Zn", "Ga", "Ge", "As", "Se", "Br", "Kr",
+                                                     "Rb", "Sr", "Y", "Zr", "Nb", "Mo", "Tc", "Ru", "Rh", "Pd", "Ag", "Cd", "In", "Sn", "Sb", "Te", "I", "Xe"};
+    if (!element.empty())
+    {
+        element[0] = toupper(element[0]);
+        std::transform(element.begin() + 1, element.end(), element.begin() + 1, ::tolower);
+    }
+    for (size_t z = 0; z < symbols.size(); z++)
+    {
+        if (symbols[z] == element)
+        {
+            return z + 1;
+        }
+    }
+    return 0;
+}